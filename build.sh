@@ -44,9 +44,24 @@ sed -i "/^<<SOURCES>>$/{
 }" ../CMakeLists.txt
 rm -f "$SOURCES_TMP"
 
+# Inject the tests and the sources they link with
+for list in TESTS TEST_SOURCES; do
+    LIST_TMP=$(mktemp)
+    declare -n entries=$list
+    for s in "${entries[@]}"; do
+        echo "        $s" >> "$LIST_TMP"
+    done
+    sed -i "/^<<$list>>$/{
+    r $LIST_TMP
+    d
+}" ../CMakeLists.txt
+    rm -f "$LIST_TMP"
+done
+
 # Configure with CMake
 echo "Configuring with CMake..."
-cmake -DCMAKE_BUILD_TYPE=$BUILD_TYPE ..
+cmake -DCMAKE_BUILD_TYPE=$BUILD_TYPE -DMMRY_BUILD_TESTS=${MMRY_BUILD_TESTS:-OFF} \
+      -DMMRY_COUNT_ALLOCATIONS=${MMRY_COUNT_ALLOCATIONS:-OFF} ..
 
 # Build the project
 echo "Compiling..."
@@ -5,20 +5,75 @@
 APP_NAME="mmry"
 
 SOURCES=(
+    "src/allocation_counter.cpp"
+    "src/blob_store.cpp"
+    "src/bookmark_store.cpp"
+    "src/clip_rows.cpp"
     "src/config.cpp"
+    "src/content_store.cpp"
+    "src/event_loop.cpp"
+    "src/eviction_policy.cpp"
     "src/help.cpp"
+    "src/history_archive.cpp"
+    "src/ingest_pipeline.cpp"
     "src/key_translation.cpp"
+    "src/lz_codec.cpp"
     "src/main.cpp"
+    "src/pinned_store.cpp"
+    "src/primary_history.cpp"
+    "src/record_store.cpp"
+    "src/selection_owner.cpp"
+    "src/selection_reader.cpp"
+    "src/selection_requests.cpp"
+    "src/shm_renderer.cpp"
     "src/ui_linux.cpp"
     "src/ui_win32.cpp"
     "src/utils.cpp"
+    "src/xcb_backend.cpp"
 )
 
 HEADERS=(
+    "src/allocation_counter.h"
+    "src/blob_store.h"
+    "src/bookmark_store.h"
+    "src/clip_rows.h"
     "src/config.h"
+    "src/content_store.h"
+    "src/event_loop.h"
+    "src/eviction_policy.h"
     "src/help.h"
+    "src/history_archive.h"
+    "src/ingest_pipeline.h"
     "src/key_translation.h"
+    "src/lz_codec.h"
     "src/main.h"
+    "src/pinned_store.h"
+    "src/primary_history.h"
+    "src/record_store.h"
+    "src/selection_owner.h"
+    "src/selection_reader.h"
+    "src/selection_requests.h"
+    "src/shm_renderer.h"
+    "src/spsc_queue.h"
     "src/ui.h"
     "src/utils.h"
+    "src/xcb_backend.h"
+)
+
+# Tests, built and run by test.sh. Each file under tests/ is its own
+# executable, linked with the sources below.
+TESTS=(
+    "tests/clip_rows_test.cpp"
+    "tests/content_store_test.cpp"
+)
+
+TEST_SOURCES=(
+    "src/allocation_counter.cpp"
+    "src/clip_rows.cpp"
+    "src/config.cpp"
+    "src/content_store.cpp"
+    "src/history_archive.cpp"
+    "src/lz_codec.cpp"
+    "src/record_store.cpp"
+    "src/utils.cpp"
 )
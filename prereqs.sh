@@ -1,3 +1,5 @@
 #!/bin/bash
 
 sudo apt-get install libxfixes-dev
+# Optional, for the asynchronous selection reads
+sudo apt-get install libxcb1-dev
@@ -0,0 +1,41 @@
+#include "allocation_counter.h"
+
+#ifdef MMRY_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local unsigned long long t_allocations = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    t_allocations++;
+    if (void* memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+unsigned long long threadAllocations()
+{
+    return t_allocations;
+}
+#else
+unsigned long long threadAllocations()
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,10 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+// How many heap allocations the calling thread has made. Built with
+// MMRY_COUNT_ALLOCATIONS, operator new is replaced to count them, so the
+// frame report and the tests can show what drawing a frame allocates;
+// otherwise this is always 0.
+unsigned long long threadAllocations();
+
+#endif // ALLOCATION_COUNTER_H
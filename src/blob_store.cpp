@@ -0,0 +1,155 @@
+#include "blob_store.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdio>
+
+std::string blobPlaceholder(const std::string& mimeType, size_t size, const std::string& key)
+{
+    char buffer[160];
+    int length;
+    if (size >= 1024 * 1024)
+    {
+        length = std::snprintf(buffer, sizeof(buffer), "[%s %.1f MiB %.8s]", mimeType.c_str(), size / (1024.0 * 1024.0), key.c_str());
+    }
+    else
+    {
+        length = std::snprintf(buffer, sizeof(buffer), "[%s %.1f KiB %.8s]", mimeType.c_str(), size / 1024.0, key.c_str());
+    }
+    return std::string(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BlobMapping::~BlobMapping()
+{
+    release();
+}
+
+BlobMapping::BlobMapping(BlobMapping&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+BlobMapping& BlobMapping::operator=(BlobMapping&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+void BlobMapping::release()
+{
+    if (m_data)
+    {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
+
+bool BlobStore::open(const std::string& directory)
+{
+    m_directory = directory;
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST)
+    {
+        m_directory.clear();
+        return false;
+    }
+    return true;
+}
+
+std::string BlobStore::pathFor(const std::string& key) const
+{
+    return m_directory + "/" + key;
+}
+
+std::string BlobStore::put(const std::string& data)
+{
+    if (m_directory.empty() || data.empty())
+    {
+        return std::string();
+    }
+
+    char name[48];
+    std::snprintf(name, sizeof(name), "%016llx-%zx",
+                  static_cast<unsigned long long>(fnv1a64(data.data(), data.size())), data.size());
+    std::string key(name);
+    std::string path = pathFor(key);
+
+    struct stat existing;
+    if (stat(path.c_str(), &existing) == 0 && static_cast<size_t>(existing.st_size) == data.size())
+    {
+        return key;
+    }
+
+    // Written beside the final name and renamed, so a blob is never seen half written
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        return std::string();
+    }
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    close(fd);
+
+    if (written != data.size() || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        return std::string();
+    }
+    return key;
+}
+
+BlobMapping BlobStore::map(const std::string& key) const
+{
+    BlobMapping mapping;
+    if (m_directory.empty() || key.empty() || key.find('/') != std::string::npos)
+    {
+        return mapping;
+    }
+
+    int fd = ::open(pathFor(key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return mapping;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            mapping.m_data = data;
+            mapping.m_size = static_cast<size_t>(info.st_size);
+        }
+    }
+    close(fd);
+    return mapping;
+}
+
+#endif
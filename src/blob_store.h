@@ -0,0 +1,60 @@
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <cstddef>
+#include <string>
+
+// The text a binary clip shows in the history and is filtered by, e.g.
+// "[image/png 48.2 KiB 1a2b3c4d]"
+std::string blobPlaceholder(const std::string& mimeType, size_t size, const std::string& key);
+
+#ifdef __linux__
+
+// Read-only view of a stored blob. Copying out of the history serves the
+// bytes straight from the mapping instead of reading them into a string.
+class BlobMapping
+{
+public:
+    BlobMapping() = default;
+    ~BlobMapping();
+    BlobMapping(BlobMapping&& other) noexcept;
+    BlobMapping& operator=(BlobMapping&& other) noexcept;
+    BlobMapping(const BlobMapping&) = delete;
+    BlobMapping& operator=(const BlobMapping&) = delete;
+
+    bool valid() const { return m_data != nullptr; }
+    const char* data() const { return static_cast<const char*>(m_data); }
+    size_t size() const { return m_size; }
+
+private:
+    friend class BlobStore;
+    void release();
+
+    void* m_data { nullptr };
+    size_t m_size { 0 };
+};
+
+// Content-addressed files under one directory (configDir/blobs). A blob is
+// named after its FNV-1a hash and size, so storing the same bytes twice
+// writes once. Files are private to the user (0600 in a 0700 directory)
+// and not encrypted, even with encrypted on, since they are served from
+// the mapping as they are.
+class BlobStore
+{
+public:
+    bool open(const std::string& directory);
+
+    // Writes data unless an equal blob exists; empty on failure
+    std::string put(const std::string& data);
+
+    BlobMapping map(const std::string& key) const;
+
+private:
+    std::string pathFor(const std::string& key) const;
+
+    std::string m_directory;
+};
+
+#endif
+
+#endif
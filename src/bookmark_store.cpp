@@ -0,0 +1,198 @@
+#include "bookmark_store.h"
+#include "config.h"
+#include "content_store.h"
+#include "record_store.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+namespace
+{
+    std::string toLower(const std::string& text)
+    {
+        std::string lower(text.size(), '\0');
+        std::transform(text.begin(), text.end(), lower.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        return lower;
+    }
+
+    BookmarkStore::Entry makeEntry(std::string content, std::string record)
+    {
+        BookmarkStore::Entry entry;
+        entry.lowercase = toLower(content);
+        entry.hash = fnv1a64(content.data(), content.size());
+        entry.content = std::move(content);
+        entry.record = std::move(record);
+        return entry;
+    }
+}
+
+const char* const BookmarkStore::GROUPS_COLLECTION = "bookmark_groups";
+
+std::string BookmarkStore::collectionFor(const std::string& group)
+{
+    return "bookmarks/" + group;
+}
+
+void BookmarkStore::open(RecordStore& records, ContentStore& contents, const ConfigManager& config)
+{
+    m_records = &records;
+    m_contents = &contents;
+    m_config = &config;
+    m_groups.clear();
+    m_importFailed = false;
+}
+
+std::vector<std::string> BookmarkStore::loadGroups()
+{
+    return m_records->read(GROUPS_COLLECTION);
+}
+
+bool BookmarkStore::saveGroups(const std::vector<std::string>& groups)
+{
+    return m_records->put(GROUPS_COLLECTION, groups);
+}
+
+std::vector<BookmarkStore::Entry>& BookmarkStore::load(const std::string& group)
+{
+    auto found = m_groups.find(group);
+    if (found != m_groups.end())
+    {
+        return found->second;
+    }
+
+    std::vector<Entry>& entries = m_groups[group];
+    // Imported records as stored, by entry index
+    std::vector<std::pair<size_t, std::string>> imported;
+    for (std::string& record : m_records->read(collectionFor(group)))
+    {
+        size_t pos = record.find('|');
+        if (pos == std::string::npos || pos == 0)
+        {
+            continue;
+        }
+
+        std::string content;
+        std::string key = ContentStore::referenceKey(record);
+        if (!key.empty())
+        {
+            if (!m_contents->lookup(key, content))
+            {
+                continue;
+            }
+            entries.push_back(makeEntry(std::move(content), std::move(record)));
+            continue;
+        }
+
+        // Imported with the text inline; stored by reference from now on
+        content = record.substr(pos + 1);
+        try
+        {
+            content = decrypt(content, *m_config);
+        }
+        catch (...)
+        {
+            // Kept as stored, like the file readers before
+        }
+        key = m_contents->intern(content);
+        imported.emplace_back(entries.size(), record);
+        record = record.substr(0, pos + 1) + ContentStore::REFERENCE_TAG + key;
+        entries.push_back(makeEntry(std::move(content), std::move(record)));
+    }
+    if (!imported.empty() && !save(group, entries))
+    {
+        // The database still holds the records as imported; so do the
+        // entries, so a later save writes them back the same way
+        for (auto& stored : imported)
+        {
+            entries[stored.first].record = std::move(stored.second);
+        }
+        m_importFailed = true;
+    }
+    return entries;
+}
+
+bool BookmarkStore::save(const std::string& group, const std::vector<Entry>& entries)
+{
+    RecordStore::Records records;
+    records.reserve(entries.size());
+    for (const Entry& entry : entries)
+    {
+        records.push_back(entry.record);
+    }
+    return m_contents->put(collectionFor(group), std::move(records));
+}
+
+bool BookmarkStore::contains(const std::string& group, const std::string& content)
+{
+    uint64_t hash = fnv1a64(content.data(), content.size());
+    for (const Entry& entry : load(group))
+    {
+        if (entry.hash == hash && entry.content == content)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BookmarkStore::add(const std::string& group, const std::string& content)
+{
+    std::vector<Entry>& entries = load(group);
+
+    auto timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+    std::string record = std::to_string(timestamp) + "|" + ContentStore::REFERENCE_TAG + m_contents->intern(content);
+    entries.push_back(makeEntry(content, std::move(record)));
+    if (!save(group, entries))
+    {
+        entries.pop_back();
+        return false;
+    }
+    return true;
+}
+
+bool BookmarkStore::erase(const std::string& group, size_t index)
+{
+    std::vector<Entry>& entries = load(group);
+    if (index >= entries.size())
+    {
+        return false;
+    }
+
+    Entry entry = std::move(entries[index]);
+    entries.erase(entries.begin() + index);
+    if (!save(group, entries))
+    {
+        entries.insert(entries.begin() + index, std::move(entry));
+        return false;
+    }
+    return true;
+}
+
+bool BookmarkStore::dropGroup(const std::string& group, const std::vector<std::string>& remainingGroups)
+{
+    RecordStore::Transaction transaction;
+    transaction.put(GROUPS_COLLECTION, remainingGroups);
+    transaction.remove(collectionFor(group));
+    if (!m_contents->commit(std::move(transaction)))
+    {
+        return false;
+    }
+    m_groups.erase(group);
+    return true;
+}
+
+void BookmarkStore::filter(const std::string& group, const std::string& lowerNeedle, std::vector<size_t>& matches)
+{
+    matches.clear();
+    const std::vector<Entry>& entries = load(group);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].lowercase.find(lowerNeedle) != std::string::npos)
+        {
+            matches.push_back(i);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef BOOKMARK_STORE_H
+#define BOOKMARK_STORE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class ConfigManager;
+class ContentStore;
+class RecordStore;
+
+// The bookmark groups and their clips, kept in the record store: the group
+// names in one collection, each group's clips in "bookmarks/<group>". A
+// group is decrypted once, the first time it is asked for; counts, rows and
+// filtering are then served from memory. The records only refer to texts
+// in the content store, so a change commits a few short lines however long
+// the clips are.
+class BookmarkStore
+{
+public:
+    struct Entry
+    {
+        std::string content;
+        std::string lowercase;
+        uint64_t hash { 0 };
+        // The line as stored: "timestamp|@ref|key"
+        std::string record;
+    };
+
+    // Collection names, also used when importing the old files
+    static const char* const GROUPS_COLLECTION;
+    static std::string collectionFor(const std::string& group);
+
+    void open(RecordStore& records, ContentStore& contents, const ConfigManager& config);
+
+    std::vector<std::string> loadGroups();
+    bool saveGroups(const std::vector<std::string>& groups);
+
+    size_t count(const std::string& group) { return load(group).size(); }
+    const std::vector<Entry>& entries(const std::string& group) { return load(group); }
+    bool contains(const std::string& group, const std::string& content);
+
+    // These return false, and leave the group as it was, if the change
+    // could not be saved
+    bool add(const std::string& group, const std::string& content);
+    bool erase(const std::string& group, size_t index);
+    // Removes the group's clips together with its name, in one commit
+    bool dropGroup(const std::string& group, const std::vector<std::string>& remainingGroups);
+
+    // Indices of the clips containing lowerNeedle, which must be lowercase
+    void filter(const std::string& group, const std::string& lowerNeedle, std::vector<size_t>& matches);
+
+    // True once a group imported with its texts inline, from the old
+    // files, could not be rewritten by reference. Its records are then
+    // left as imported, and imported again the next time it is loaded.
+    bool importFailed() const { return m_importFailed; }
+
+private:
+    std::vector<Entry>& load(const std::string& group);
+    bool save(const std::string& group, const std::vector<Entry>& entries);
+
+    RecordStore* m_records { nullptr };
+    ContentStore* m_contents { nullptr };
+    const ConfigManager* m_config { nullptr };
+    std::map<std::string, std::vector<Entry>> m_groups;
+    bool m_importFailed { false };
+};
+
+#endif
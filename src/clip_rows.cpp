@@ -0,0 +1,67 @@
+#include "clip_rows.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void ClipRows::reserve(size_t rowCount)
+{
+    if (m_lines.size() < rowCount)
+    {
+        m_lines.resize(rowCount);
+        m_trimmed.resize(rowCount);
+    }
+}
+
+void ClipRows::format(size_t row, const std::string& content, uint64_t hash, bool isPath, bool selected,
+                      const std::tm* verboseTime, int width, const FontMetrics& metrics)
+{
+    std::string& line = m_lines[row];
+    line.assign(selected ? "> " : "  ");
+
+    size_t lineCount = 1 + std::count(content.begin(), content.end(), '\n');
+    char buffer[64];
+
+    if (verboseTime)
+    {
+        size_t length = std::strftime(buffer, sizeof(buffer), "%H:%M:%S", verboseTime);
+        line.append(buffer, length);
+        length = std::snprintf(buffer, sizeof(buffer), " | %zu lines | ", lineCount);
+        line.append(buffer, length);
+
+        appendText(row, content, hash, isPath, width - metrics.textWidth(line), metrics);
+    }
+    else
+    {
+        size_t suffixLength = 0;
+        if (lineCount > 1)
+        {
+            suffixLength = std::snprintf(buffer, sizeof(buffer), " (%zu lines)", lineCount);
+        }
+
+        int contentWidth = width - metrics.textWidth(line) - metrics.textWidth(buffer, suffixLength);
+        appendText(row, content, hash, isPath, contentWidth, metrics);
+        line.append(buffer, suffixLength);
+    }
+}
+
+void ClipRows::appendText(size_t row, const std::string& content, uint64_t hash, bool isPath, int maxWidth,
+                          const FontMetrics& metrics)
+{
+    Trimmed& trimmed = m_trimmed[row];
+    if (trimmed.hash != hash || trimmed.size != content.size() || trimmed.width != maxWidth)
+    {
+        // Flattened in the row's own buffer, which keeps its capacity
+        trimmed.text.assign(content);
+        std::replace_if(trimmed.text.begin(), trimmed.text.end(), [](char c) { return c == '\n' || c == '\r'; }, ' ');
+        if (metrics.textWidth(trimmed.text) > maxWidth)
+        {
+            // The classification stored at capture time saves a regex pass
+            trimmed.text = smartTrimToWidth(trimmed.text, maxWidth, metrics, isPath);
+        }
+        trimmed.hash = hash;
+        trimmed.size = content.size();
+        trimmed.width = maxWidth;
+    }
+    m_lines[row].append(trimmed.text);
+}
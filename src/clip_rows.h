@@ -0,0 +1,46 @@
+#ifndef CLIP_ROWS_H
+#define CLIP_ROWS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "ui.h"
+
+// The clip list's visible rows, formatted into storage kept from frame to
+// frame. Each row also keeps its clip text flattened to one line and trimmed
+// to the width it was drawn at, so redrawing a row whose clip and width are
+// unchanged makes no heap allocation. Only a clip scrolling into the row or
+// a resize trims again.
+class ClipRows
+{
+public:
+    // Makes room for rowCount rows; the storage only ever grows
+    void reserve(size_t rowCount);
+
+    // Formats row as the selection marker, with verboseTime the time and
+    // line count, then the clip text trimmed so the row fits width pixels.
+    // hash identifies the content, as ClipboardItem::hash does.
+    void format(size_t row, const std::string& content, uint64_t hash, bool isPath, bool selected,
+                const std::tm* verboseTime, int width, const FontMetrics& metrics);
+
+    ItemView<std::string> rows(size_t rowCount) const { return ItemView<std::string>(m_lines.data(), rowCount); }
+
+private:
+    struct Trimmed
+    {
+        uint64_t hash { 0 };
+        size_t size { 0 };
+        int width { -1 };
+        std::string text;
+    };
+
+    void appendText(size_t row, const std::string& content, uint64_t hash, bool isPath, int maxWidth,
+                    const FontMetrics& metrics);
+
+    std::vector<std::string> m_lines;
+    std::vector<Trimmed> m_trimmed;
+};
+
+#endif // CLIP_ROWS_H
@@ -1,4 +1,5 @@
 #include "config.h"
+#include "utils.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -7,6 +8,7 @@
 #include <dirent.h>
 #include <cstring>
 #include <cerrno>
+#include <stdexcept>
 
 #ifdef __linux__
 #include <unistd.h>
@@ -24,9 +26,13 @@
 // Eventually, these will be used instead of the hard coded keys in the code below
 // For now - search for: !@!
 // to get all the places keys are hard coded
-static const std::vector<std::string> booleanKeys = {"verbose", "debugging", "encrypted", "autostart"};
-static const std::vector<std::string> numberKeys  = {"max_clips"};
-static const std::vector<std::string> stringKeys = {"encryption_key", "theme"};
+static const std::vector<std::string> booleanKeys = {"verbose", "debugging", "encrypted", "autostart", "shm_renderer", "primary_history", "compress_dictionary", "archive_history"};
+static const std::vector<std::string> numberKeys  = {"max_clips", "max_clip_size", "clipboard_debounce_ms", "primary_min_length", "compress_min_size",
+                                                  "max_memory_bytes", "spill_min_size"};
+// Number keys that may be 0, meaning no limit
+static const std::vector<std::string> unlimitedKeys = {"max_clip_size", "max_memory_bytes"};
+static const std::vector<std::string> stringKeys = {"encryption_key", "theme", "near_duplicates", "archive_partition", "archive_retention",
+                                                  "eviction_policy"};
 
 unsigned long ConfigManager::hexToRgb(const std::string& hex)
 {
@@ -344,18 +350,7 @@ void ConfigManager::setupConfigDir()
     }
     
     bookmarksDir = configDir + pathSep + "bookmarks";
-    if (stat(bookmarksDir.c_str(), &st) == -1)
-    {
-        if (createDirectory(bookmarksDir))
-        {
-            std::cout << "Created bookmarks directory: " << bookmarksDir << "\n";
-        }
-        else
-        {
-            std::cerr << "Failed to create bookmarks directory: " << bookmarksDir << "\n";
-        }
-    }
-    
+    databaseFile = configDir + pathSep + "mmry.db";
     dataFile = configDir + pathSep + "clips.txt";
     pinnedFile = configDir + pathSep + "pinned.txt";
     
@@ -376,37 +371,6 @@ void ConfigManager::ensureRequiredFiles()
     {
         createDefaultThemeFile();
     }
-    
-    std::string bookmarksFile { bookmarksDir + "/bookmarks.txt" };
-    if (stat(bookmarksFile.c_str(), &st) == -1)
-    {
-        std::ofstream outFile(bookmarksFile);
-        if (outFile.is_open())
-        {
-            outFile << "default|0\n";
-            outFile.close();
-            std::cout << "Created bookmarks file: " << bookmarksFile << "\n";
-        }
-    }
-    
-    if (stat(dataFile.c_str(), &st) == -1)
-    {
-        std::ofstream outFile(dataFile);
-        if (outFile.is_open())
-        {
-            outFile.close();
-            std::cout << "Created clips file: " << dataFile << "\n";
-        }
-    }
-    if (stat(pinnedFile.c_str(), &st) == -1)
-    {
-        std::ofstream outFile(pinnedFile);
-        if (outFile.is_open())
-        {
-            outFile.close();
-            std::cout << "Created pinned clips file: " << pinnedFile << "\n";
-        }
-    }
 }
 
 // !@!
@@ -442,6 +406,28 @@ void ConfigManager::loadConfig()
                     maxClips = std::stoull(value);
                 }
             }
+            else if (line.find("\"max_clip_size\"") != std::string::npos)
+            {
+                size_t colon { line.find(':') };
+                if (colon != std::string::npos)
+                {
+                    std::string value { line.substr(colon + 1) };
+                    value.erase(0, value.find_first_not_of(" \t"));
+                    value.erase(value.find_last_not_of(" \t,") + 1);
+                    maxClipSize = std::stoull(value);
+                }
+            }
+            else if (line.find("\"clipboard_debounce_ms\"") != std::string::npos)
+            {
+                size_t colon { line.find(':') };
+                if (colon != std::string::npos)
+                {
+                    std::string value { line.substr(colon + 1) };
+                    value.erase(0, value.find_first_not_of(" \t"));
+                    value.erase(value.find_last_not_of(" \t,") + 1);
+                    clipboardDebounceMs = std::stoull(value);
+                }
+            }
             else if (line.find("\"encrypted\"") != std::string::npos)
             {
                 encrypted = line.find("true") != std::string::npos;
@@ -450,6 +436,102 @@ void ConfigManager::loadConfig()
             {
                 autoStart = line.find("true") != std::string::npos;
             }
+            else if (line.find("\"shm_renderer\"") != std::string::npos)
+            {
+                shmRenderer = line.find("true") != std::string::npos;
+            }
+            else if (line.find("\"primary_history\"") != std::string::npos)
+            {
+                primaryHistory = line.find("true") != std::string::npos;
+            }
+            else if (line.find("\"primary_min_length\"") != std::string::npos)
+            {
+                size_t colon { line.find(':') };
+                if (colon != std::string::npos)
+                {
+                    std::string value { line.substr(colon + 1) };
+                    value.erase(0, value.find_first_not_of(" \t"));
+                    value.erase(value.find_last_not_of(" \t,") + 1);
+                    primaryMinLength = std::stoull(value);
+                }
+            }
+            else if (line.find("\"compress_min_size\"") != std::string::npos)
+            {
+                size_t colon { line.find(':') };
+                if (colon != std::string::npos)
+                {
+                    std::string value { line.substr(colon + 1) };
+                    value.erase(0, value.find_first_not_of(" \t"));
+                    value.erase(value.find_last_not_of(" \t,") + 1);
+                    compressMinSize = std::stoull(value);
+                }
+            }
+            else if (line.find("\"max_memory_bytes\"") != std::string::npos)
+            {
+                size_t colon { line.find(':') };
+                if (colon != std::string::npos)
+                {
+                    std::string value { line.substr(colon + 1) };
+                    value.erase(0, value.find_first_not_of(" \t"));
+                    value.erase(value.find_last_not_of(" \t,") + 1);
+                    maxMemoryBytes = std::stoull(value);
+                }
+            }
+            else if (line.find("\"spill_min_size\"") != std::string::npos)
+            {
+                size_t colon { line.find(':') };
+                if (colon != std::string::npos)
+                {
+                    std::string value { line.substr(colon + 1) };
+                    value.erase(0, value.find_first_not_of(" \t"));
+                    value.erase(value.find_last_not_of(" \t,") + 1);
+                    spillMinSize = std::stoull(value);
+                }
+            }
+            else if (line.find("\"compress_dictionary\"") != std::string::npos)
+            {
+                compressDictionary = line.find("true") != std::string::npos;
+            }
+            else if (line.find("\"archive_history\"") != std::string::npos)
+            {
+                archiveHistory = line.find("true") != std::string::npos;
+            }
+            else if (line.find("\"near_duplicates\"") != std::string::npos)
+            {
+                size_t start { line.find('"', line.find(':')) };
+                size_t end { line.find('"', start + 1) };
+                if (start != std::string::npos && end != std::string::npos)
+                {
+                    nearDuplicates = line.substr(start + 1, end - start - 1);
+                }
+            }
+            else if (line.find("\"eviction_policy\"") != std::string::npos)
+            {
+                size_t start { line.find('"', line.find(':')) };
+                size_t end { line.find('"', start + 1) };
+                if (start != std::string::npos && end != std::string::npos)
+                {
+                    evictionPolicy = line.substr(start + 1, end - start - 1);
+                }
+            }
+            else if (line.find("\"archive_partition\"") != std::string::npos)
+            {
+                size_t start { line.find('"', line.find(':')) };
+                size_t end { line.find('"', start + 1) };
+                if (start != std::string::npos && end != std::string::npos)
+                {
+                    archivePartition = line.substr(start + 1, end - start - 1);
+                }
+            }
+            else if (line.find("\"archive_retention\"") != std::string::npos)
+            {
+                size_t start { line.find('"', line.find(':')) };
+                size_t end { line.find('"', start + 1) };
+                if (start != std::string::npos && end != std::string::npos)
+                {
+                    archiveRetention = line.substr(start + 1, end - start - 1);
+                }
+            }
             else if (line.find("\"encryption_key\"") != std::string::npos)
             {
                 size_t start { line.find('"', line.find(':')) };
@@ -508,9 +590,23 @@ void ConfigManager::saveConfig()
     configValues["verbose"] = verboseMode ? "true" : "false";
     configValues["debugging"] = m_debugging ? "true" : "false";
     configValues["max_clips"] = std::to_string(maxClips);
+    configValues["max_clip_size"] = std::to_string(maxClipSize);
+    configValues["clipboard_debounce_ms"] = std::to_string(clipboardDebounceMs);
     configValues["encrypted"] = encrypted ? "true" : "false";
     configValues["encryption_key"] = encryptionKey;
     configValues["autostart"] = autoStart ? "true" : "false";
+    configValues["shm_renderer"] = shmRenderer ? "true" : "false";
+    configValues["primary_history"] = primaryHistory ? "true" : "false";
+    configValues["primary_min_length"] = std::to_string(primaryMinLength);
+    configValues["near_duplicates"] = nearDuplicates;
+    configValues["compress_min_size"] = std::to_string(compressMinSize);
+    configValues["compress_dictionary"] = compressDictionary ? "true" : "false";
+    configValues["max_memory_bytes"] = std::to_string(maxMemoryBytes);
+    configValues["spill_min_size"] = std::to_string(spillMinSize);
+    configValues["eviction_policy"] = evictionPolicy;
+    configValues["archive_history"] = archiveHistory ? "true" : "false";
+    configValues["archive_partition"] = archivePartition;
+    configValues["archive_retention"] = archiveRetention;
     configValues["theme"] = theme;
     
     std::cout << "DEBUG: About to write max_clips = " << configValues["max_clips"] << "\n";
@@ -558,9 +654,23 @@ void ConfigManager::createDefaultConfig()
     outFile << "    \"debugging\": false,\n";
     outFile << "    \"verbose\": false,\n";
     outFile << "    \"max_clips\": 500,\n";
+    outFile << "    \"max_clip_size\": 8388608,\n";
+    outFile << "    \"clipboard_debounce_ms\": 30,\n";
     outFile << "    \"encrypted\": true,\n";
     outFile << "    \"encryption_key\": \"mmry_default_key_2026\",\n";
     outFile << "    \"autostart\": false,\n";
+    outFile << "    \"shm_renderer\": false,\n";
+    outFile << "    \"primary_history\": false,\n";
+    outFile << "    \"primary_min_length\": 3,\n";
+    outFile << "    \"near_duplicates\": \"off\",\n";
+    outFile << "    \"compress_min_size\": 512,\n";
+    outFile << "    \"compress_dictionary\": false,\n";
+    outFile << "    \"max_memory_bytes\": 0,\n";
+    outFile << "    \"spill_min_size\": 262144,\n";
+    outFile << "    \"eviction_policy\": \"oldest\",\n";
+    outFile << "    \"archive_history\": false,\n";
+    outFile << "    \"archive_partition\": \"day\",\n";
+    outFile << "    \"archive_retention\": \"forever\",\n";
     outFile << "    \"theme\": \"console\"\n";
     outFile << "}\n";
     outFile.close();
@@ -575,9 +685,23 @@ std::string ConfigManager::getConfigValue(const std::string& configKey)
     if (configKey == "verbose") return verboseMode ? "true" : "false";
     if (configKey == "debugging") return m_debugging ? "true" : "false";
     if (configKey == "max_clips") return std::to_string(maxClips);
+    if (configKey == "max_clip_size") return std::to_string(maxClipSize);
+    if (configKey == "clipboard_debounce_ms") return std::to_string(clipboardDebounceMs);
     if (configKey == "encrypted") return encrypted ? "true" : "false";
     if (configKey == "encryption_key") return encryptionKey;
     if (configKey == "autostart") return autoStart ? "true" : "false";
+    if (configKey == "shm_renderer") return shmRenderer ? "true" : "false";
+    if (configKey == "primary_history") return primaryHistory ? "true" : "false";
+    if (configKey == "primary_min_length") return std::to_string(primaryMinLength);
+    if (configKey == "near_duplicates") return nearDuplicates;
+    if (configKey == "compress_min_size") return std::to_string(compressMinSize);
+    if (configKey == "compress_dictionary") return compressDictionary ? "true" : "false";
+    if (configKey == "max_memory_bytes") return std::to_string(maxMemoryBytes);
+    if (configKey == "spill_min_size") return std::to_string(spillMinSize);
+    if (configKey == "eviction_policy") return evictionPolicy;
+    if (configKey == "archive_history") return archiveHistory ? "true" : "false";
+    if (configKey == "archive_partition") return archivePartition;
+    if (configKey == "archive_retention") return archiveRetention;
     if (configKey == "theme") return theme;
     return "";
 }
@@ -586,6 +710,8 @@ std::string ConfigManager::getConfigType(const std::string& configKey)
 {
     if (std::find(booleanKeys.begin(), booleanKeys.end(), configKey) != booleanKeys.end())
         return "boolean (true/false)";
+    if (std::find(unlimitedKeys.begin(), unlimitedKeys.end(), configKey) != unlimitedKeys.end())
+        return "number (0 for no limit)";
     if (std::find(numberKeys.begin(), numberKeys.end(), configKey) != numberKeys.end())
         return "number (positive integer)";
     if (std::find(stringKeys.begin(), stringKeys.end(), configKey) != stringKeys.end())
@@ -610,6 +736,10 @@ bool ConfigManager::updateConfigValue(const std::string& configKey, const std::s
                 else if (configKey == "debugging") m_debugging = newValue == "true";
                 else if (configKey == "encrypted") encrypted = newValue == "true";
                 else if (configKey == "autostart") autoStart = newValue == "true";
+                else if (configKey == "shm_renderer") shmRenderer = newValue == "true";
+                else if (configKey == "primary_history") primaryHistory = newValue == "true";
+                else if (configKey == "compress_dictionary") compressDictionary = newValue == "true";
+                else if (configKey == "archive_history") archiveHistory = newValue == "true";
                 return true;
             }
             return false;
@@ -617,9 +747,15 @@ bool ConfigManager::updateConfigValue(const std::string& configKey, const std::s
         
         try
         {
+            // A string value such as "7d,1y" may start with digits
+            if (std::find(numberKeys.begin(), numberKeys.end(), configKey) == numberKeys.end())
+            {
+                throw std::invalid_argument(configKey);
+            }
             std::stoull(currentValue);
             size_t newNumValue { std::stoull(newValue) };
-            if (newNumValue > 0)
+            if (newNumValue > 0 ||
+                std::find(unlimitedKeys.begin(), unlimitedKeys.end(), configKey) != unlimitedKeys.end())
             {
                 if (configKey == "max_clips")
                 {
@@ -627,6 +763,30 @@ bool ConfigManager::updateConfigValue(const std::string& configKey, const std::s
                     maxClips = newNumValue;
                     std::cout << "DEBUG: maxClips is now " << maxClips << "\n";
                 }
+                else if (configKey == "max_clip_size")
+                {
+                    maxClipSize = newNumValue;
+                }
+                else if (configKey == "clipboard_debounce_ms")
+                {
+                    clipboardDebounceMs = newNumValue;
+                }
+                else if (configKey == "primary_min_length")
+                {
+                    primaryMinLength = newNumValue;
+                }
+                else if (configKey == "compress_min_size")
+                {
+                    compressMinSize = newNumValue;
+                }
+                else if (configKey == "max_memory_bytes")
+                {
+                    maxMemoryBytes = newNumValue;
+                }
+                else if (configKey == "spill_min_size")
+                {
+                    spillMinSize = newNumValue;
+                }
                 return true;
             }
             return false;
@@ -644,6 +804,43 @@ bool ConfigManager::updateConfigValue(const std::string& configKey, const std::s
                 loadTheme();
                 return true;
             }
+            else if (configKey == "near_duplicates")
+            {
+                if (newValue != "off" && newValue != "newest" && newValue != "oldest")
+                {
+                    return false;
+                }
+                nearDuplicates = newValue;
+                return true;
+            }
+            else if (configKey == "eviction_policy")
+            {
+                if (newValue != "oldest" && newValue != "frecent" && newValue != "largest" && newValue != "typed")
+                {
+                    return false;
+                }
+                evictionPolicy = newValue;
+                return true;
+            }
+            else if (configKey == "archive_partition")
+            {
+                if (newValue != "day" && newValue != "week")
+                {
+                    return false;
+                }
+                archivePartition = newValue;
+                return true;
+            }
+            else if (configKey == "archive_retention")
+            {
+                std::vector<RetentionRule> rules;
+                if (!parseRetentionRules(newValue, rules))
+                {
+                    return false;
+                }
+                archiveRetention = newValue;
+                return true;
+            }
             return true;
         }
     }
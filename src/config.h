@@ -10,15 +10,48 @@ class ConfigManager
 public:
     std::string configDir;
     std::string bookmarksDir;
+    // History, pins and bookmarks all live in this one file
+    std::string databaseFile;
+    // Where the stores were kept before the database; read once to import
     std::string dataFile;
     std::string pinnedFile;
 
     size_t maxClips { 500 };
+    // Clips past max_clips go to the on-disk archive instead of being dropped
+    bool archiveHistory { false };
+    // Archive segments cover one "day" or "week" each
+    std::string archivePartition { "day" };
+    // How long archived clips are kept, e.g. "7d,1y>20"; see parseRetentionRules
+    std::string archiveRetention { "forever" };
+    // Bytes of one clip kept in full, 0 for no limit; larger clips are
+    // stored truncated
+    size_t maxClipSize { 8 * 1024 * 1024 };
+    // Clipboard owner changes closer together than this are one copy
+    size_t clipboardDebounceMs { 30 };
     bool encrypted { false };
     std::string encryptionKey;
     std::string theme { "console" };
     std::string originalTheme;
     bool autoStart { false };
+    bool shmRenderer { false };
+    // Also keep mouse selections, in their own ring
+    bool primaryHistory { false };
+    size_t primaryMinLength { 3 };
+    // Copies differing only in whitespace: "off" stores each, "newest"
+    // replaces the older entry's text, "oldest" keeps it and only moves it up
+    std::string nearDuplicates { "off" };
+    // Stored clip texts from this size on are compressed
+    size_t compressMinSize { 512 };
+    // Also compress short texts against a dictionary trained from the history
+    bool compressDictionary { false };
+    // Bytes the history's texts may take in memory, 0 for no limit. Clips
+    // from spill_min_size on then keep only a preview resident, their text
+    // in the blob store, and the oldest clips go when that is not enough.
+    size_t maxMemoryBytes { 0 };
+    size_t spillMinSize { 262144 };
+    // Which clip goes first past max_clips or max_memory_bytes: "oldest",
+    // "frecent", "largest" or "typed"; see EvictionPolicy
+    std::string evictionPolicy { "oldest" };
     bool verboseMode { false };
     bool m_debugging { true };
 
@@ -0,0 +1,449 @@
+#include "content_store.h"
+#include "config.h"
+#include "lz_codec.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    const std::string BUCKET_PREFIX = "content/";
+    const std::string COMPRESSED_FLAG = "/z";
+    const std::string DICTIONARY_FLAG = "/d";
+    const std::string ENCRYPTED_FLAG = "/e";
+
+    // Shorter texts gain nothing even from a dictionary
+    const size_t DICTIONARY_MIN_SIZE = 32;
+    const size_t DICTIONARY_MAX_SIZE = 16 * 1024;
+    const size_t DICTIONARY_MIN_SAMPLES = 64;
+
+    bool isBucket(const std::string& collection)
+    {
+        return collection.compare(0, BUCKET_PREFIX.size(), BUCKET_PREFIX) == 0;
+    }
+
+    // "key|text", the key followed by any of "/z" or "/d", then "/e"
+    std::string bucketKey(const std::string& record)
+    {
+        return record.substr(0, record.find_first_of("/|"));
+    }
+
+    bool hasFlag(const std::string& flags, const std::string& flag)
+    {
+        return flags.find(flag) != std::string::npos;
+    }
+}
+
+const std::string ContentStore::REFERENCE_TAG = "@ref|";
+const char* const ContentStore::DICTIONARY_COLLECTION = "content_dictionary";
+
+std::string ContentStore::keyFor(uint64_t hash, size_t size)
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "%016llx-%zx", static_cast<unsigned long long>(hash), size);
+    return name;
+}
+
+std::string ContentStore::referenceKey(const std::string& record)
+{
+    size_t pos = record.find('|');
+    if (pos == std::string::npos || record.compare(pos + 1, REFERENCE_TAG.size(), REFERENCE_TAG) != 0)
+    {
+        return std::string();
+    }
+    return record.substr(pos + 1 + REFERENCE_TAG.size());
+}
+
+std::string ContentStore::bucketFor(const std::string& key)
+{
+    return BUCKET_PREFIX + key.substr(0, 1);
+}
+
+void ContentStore::open(RecordStore& records, const ConfigManager& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_records = &records;
+    m_compressMinSize = config.compressMinSize;
+    m_compressDictionary = config.compressDictionary;
+    m_encrypted = config.encrypted;
+    m_key = config.encryptionKey;
+    m_references.clear();
+    m_pending.clear();
+    RecordStore::Records dictionary = records.read(DICTIONARY_COLLECTION);
+    m_dictionary = dictionary.empty() ? std::string() : std::move(dictionary.front());
+
+    std::vector<std::string> collections = records.collections();
+    for (const std::string& collection : collections)
+    {
+        if (isBucket(collection))
+        {
+            records.forEach(collection, [this](const std::string& record)
+            {
+                m_references.emplace(bucketKey(record), 0);
+            });
+        }
+    }
+    for (const std::string& collection : collections)
+    {
+        if (isBucket(collection) || collection == DICTIONARY_COLLECTION)
+        {
+            continue;
+        }
+        records.forEach(collection, [this](const std::string& record)
+        {
+            auto found = m_references.find(referenceKey(record));
+            if (found != m_references.end())
+            {
+                found->second++;
+            }
+        });
+    }
+}
+
+std::string ContentStore::intern(uint64_t hash, const std::string& content)
+{
+    std::string key = keyFor(hash, content.size());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.count(key) == 0)
+    {
+        // A stored text is only held, so the collector leaves it alone
+        m_pending.emplace(key, m_references.count(key) ? std::string() : encode(content));
+    }
+    return key;
+}
+
+std::string ContentStore::intern(const std::string& content)
+{
+    return intern(fnv1a64(content.data(), content.size()), content);
+}
+
+bool ContentStore::lookup(const std::string& key, std::string& content) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto pending = m_pending.find(key);
+    if (pending != m_pending.end() && !pending->second.empty())
+    {
+        return decode(pending->second, content);
+    }
+    if (!m_references.count(key))
+    {
+        return false;
+    }
+
+    std::string stored;
+    bool found = false;
+    m_records->forEach(bucketFor(key), [&](const std::string& record)
+    {
+        if (!found && record.size() > key.size() && record.compare(0, key.size(), key) == 0 &&
+            (record[key.size()] == '|' || record[key.size()] == '/'))
+        {
+            stored = record.substr(key.size());
+            found = true;
+        }
+    });
+    return found && decode(stored, content);
+}
+
+std::string ContentStore::encode(const std::string& content) const
+{
+    std::string flags;
+    std::string data = content;
+    bool useDictionary = m_compressDictionary && !m_dictionary.empty() &&
+                         content.size() >= DICTIONARY_MIN_SIZE;
+    if (useDictionary || content.size() >= m_compressMinSize)
+    {
+        std::string packed = lzCompress(content, useDictionary ? m_dictionary : std::string());
+        if (packed.size() < content.size())
+        {
+            flags = useDictionary ? DICTIONARY_FLAG : COMPRESSED_FLAG;
+            data = std::move(packed);
+        }
+    }
+    if (m_encrypted && !m_key.empty())
+    {
+        flags += ENCRYPTED_FLAG;
+        data = encryptWithKey(data, m_key);
+    }
+    return flags + "|" + data;
+}
+
+bool ContentStore::decode(const std::string& stored, std::string& content) const
+{
+    size_t bar = stored.find('|');
+    if (bar == std::string::npos)
+    {
+        return false;
+    }
+    std::string flags = stored.substr(0, bar);
+
+    std::string data = stored.substr(bar + 1);
+    if (hasFlag(flags, ENCRYPTED_FLAG))
+    {
+        // Encrypted under a key no longer known
+        if (m_key.empty())
+        {
+            return false;
+        }
+        data = decryptWithKey(data, m_key);
+    }
+    bool withDictionary = hasFlag(flags, DICTIONARY_FLAG);
+    if (!withDictionary && !hasFlag(flags, COMPRESSED_FLAG))
+    {
+        content = std::move(data);
+        return true;
+    }
+    return lzDecompress(data, content, withDictionary ? m_dictionary : std::string());
+}
+
+std::string ContentStore::reencrypt(const std::string& stored, const std::string& key) const
+{
+    size_t bar = stored.find('|');
+    if (bar == std::string::npos || !hasFlag(stored.substr(0, bar), ENCRYPTED_FLAG) || m_key.empty())
+    {
+        return stored;
+    }
+    std::string data = decryptWithKey(stored.substr(bar + 1), m_key);
+    if (key.empty())
+    {
+        // No key to keep it under; stored as it is from now on
+        std::string flags = stored.substr(0, bar);
+        flags.erase(flags.find(ENCRYPTED_FLAG), ENCRYPTED_FLAG.size());
+        return flags + "|" + data;
+    }
+    return stored.substr(0, bar + 1) + encryptWithKey(data, key);
+}
+
+void ContentStore::setCompression(size_t minSize, bool dictionary)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_compressMinSize = minSize;
+    m_compressDictionary = dictionary;
+}
+
+bool ContentStore::setEncryption(bool encrypted, const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (key == m_key || !m_records)
+    {
+        m_encrypted = encrypted;
+        m_key = key;
+        return true;
+    }
+
+    // Every bucket is rewritten in one transaction, so a failure leaves
+    // the texts under the old key
+    RecordStore::Transaction transaction;
+    for (const std::string& collection : m_records->collections())
+    {
+        if (!isBucket(collection))
+        {
+            continue;
+        }
+        RecordStore::Records records;
+        m_records->forEach(collection, [&](const std::string& record)
+        {
+            std::string textKey = bucketKey(record);
+            records.push_back(textKey + reencrypt(record.substr(textKey.size()), key));
+        });
+        transaction.put(collection, std::move(records));
+    }
+    if (!m_records->commit(std::move(transaction)))
+    {
+        return false;
+    }
+    for (auto& pending : m_pending)
+    {
+        if (!pending.second.empty())
+        {
+            pending.second = reencrypt(pending.second, key);
+        }
+    }
+    m_encrypted = encrypted;
+    m_key = key;
+    return true;
+}
+
+bool ContentStore::commit(RecordStore::Transaction transaction)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_records)
+    {
+        return false;
+    }
+
+    // What the replaced records referred to counts down, the new ones up
+    std::unordered_map<std::string, long> delta;
+    std::unordered_set<std::string> referenced;
+    transaction.forEach([&](const std::string& collection, const RecordStore::Records* records)
+    {
+        if (isBucket(collection))
+        {
+            return;
+        }
+        m_records->forEach(collection, [&](const std::string& record)
+        {
+            std::string key = referenceKey(record);
+            if (!key.empty())
+            {
+                delta[key]--;
+            }
+        });
+        if (records)
+        {
+            for (const std::string& record : *records)
+            {
+                std::string key = referenceKey(record);
+                if (!key.empty())
+                {
+                    delta[key]++;
+                    referenced.insert(key);
+                }
+            }
+        }
+    });
+
+    std::map<std::string, RecordStore::Records> buckets;
+    for (const std::string& key : referenced)
+    {
+        auto pending = m_pending.find(key);
+        if (pending == m_pending.end() || pending->second.empty())
+        {
+            continue;
+        }
+        std::string bucket = bucketFor(key);
+        auto existing = buckets.find(bucket);
+        if (existing == buckets.end())
+        {
+            existing = buckets.emplace(bucket, m_records->read(bucket)).first;
+        }
+        existing->second.push_back(key + pending->second);
+    }
+    for (auto& bucket : buckets)
+    {
+        transaction.put(bucket.first, std::move(bucket.second));
+    }
+
+    if (!m_records->commit(std::move(transaction)))
+    {
+        return false;
+    }
+
+    for (const std::string& key : referenced)
+    {
+        auto pending = m_pending.find(key);
+        if (pending != m_pending.end())
+        {
+            if (!pending->second.empty())
+            {
+                m_references.emplace(key, 0);
+            }
+            m_pending.erase(pending);
+        }
+    }
+    for (const auto& change : delta)
+    {
+        auto found = m_references.find(change.first);
+        if (found != m_references.end())
+        {
+            found->second += change.second;
+        }
+    }
+    return true;
+}
+
+bool ContentStore::put(const std::string& collection, RecordStore::Records records)
+{
+    RecordStore::Transaction transaction;
+    transaction.put(collection, std::move(records));
+    return commit(std::move(transaction));
+}
+
+size_t ContentStore::collectGarbage()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_records)
+    {
+        return 0;
+    }
+
+    std::unordered_set<std::string> garbage;
+    std::map<std::string, RecordStore::Records> buckets;
+    for (const auto& entry : m_references)
+    {
+        if (entry.second <= 0 && m_pending.count(entry.first) == 0)
+        {
+            garbage.insert(entry.first);
+            buckets.emplace(bucketFor(entry.first), RecordStore::Records());
+        }
+    }
+    if (garbage.empty())
+    {
+        return 0;
+    }
+
+    RecordStore::Transaction transaction;
+    for (auto& bucket : buckets)
+    {
+        m_records->forEach(bucket.first, [&](const std::string& record)
+        {
+            if (garbage.count(bucketKey(record)) == 0)
+            {
+                bucket.second.push_back(record);
+            }
+        });
+        if (bucket.second.empty())
+        {
+            transaction.remove(bucket.first);
+        }
+        else
+        {
+            transaction.put(bucket.first, std::move(bucket.second));
+        }
+    }
+    if (!m_records->commit(std::move(transaction)))
+    {
+        return 0;
+    }
+
+    for (const std::string& key : garbage)
+    {
+        m_references.erase(key);
+    }
+    return garbage.size();
+}
+
+bool ContentStore::hasDictionary() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_dictionary.empty();
+}
+
+bool ContentStore::trainDictionary(const std::vector<std::string>& samples)
+{
+    if (samples.size() < DICTIONARY_MIN_SAMPLES)
+    {
+        return false;
+    }
+    std::string dictionary = lzTrainDictionary(samples, DICTIONARY_MAX_SIZE);
+    if (dictionary.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_records || !m_dictionary.empty() || !m_records->put(DICTIONARY_COLLECTION, { dictionary }))
+    {
+        return false;
+    }
+    m_dictionary = std::move(dictionary);
+    return true;
+}
+
+size_t ContentStore::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_references.size();
+}
@@ -0,0 +1,97 @@
+#ifndef CONTENT_STORE_H
+#define CONTENT_STORE_H
+
+#include "record_store.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ConfigManager;
+
+// Clip texts, stored once however many lists hold them. History, pins and
+// bookmark groups keep "timestamp|@ref|<key>" records, the key being the
+// text's FNV-1a hash and length as for blobs; the texts live in sixteen
+// "content/<digit>" collections, picked by the key's first digit.
+//
+// A text of compress_min_size bytes or more is stored LZ-compressed when
+// that saves space, the record's key then carrying a "/z" flag. With
+// compress_dictionary set, a dictionary trained once from the history is
+// kept beside the texts and shorter ones compress against it ("/d").
+// A text stored encrypted carries "/e" after those, so turning encryption
+// on or off leaves every stored text readable, and changing the key
+// re-encrypts them.
+//
+// References are counted per key from the committed collections: every
+// commit that refers to texts goes through commit(), which compares the
+// records it replaces with the new ones. A text nothing refers to any more
+// is dropped by collectGarbage(), which the ingest worker runs after saving
+// the history.
+class ContentStore
+{
+public:
+    static const std::string REFERENCE_TAG;
+    static const char* const DICTIONARY_COLLECTION;
+
+    static std::string keyFor(uint64_t hash, size_t size);
+    // The key of a "timestamp|@ref|key" record, empty for any other record
+    static std::string referenceKey(const std::string& record);
+
+    // Takes its settings from the configuration; later changes come in
+    // through the setters, so the ingest worker never reads the config
+    void open(RecordStore& records, const ConfigManager& config);
+
+    void setCompression(size_t minSize, bool dictionary);
+
+    // Whether new texts are encrypted, and with which key. A new key
+    // re-encrypts the stored texts; false if that could not be committed,
+    // the old key then staying in use.
+    bool setEncryption(bool encrypted, const std::string& key);
+
+    // The text's key. A new text is written by the first commit that refers
+    // to it, and a stored one is kept until then even if unreferenced.
+    std::string intern(uint64_t hash, const std::string& content);
+    std::string intern(const std::string& content);
+
+    bool lookup(const std::string& key, std::string& content) const;
+
+    // Commits the transaction with the texts its records refer to that are
+    // not stored yet
+    bool commit(RecordStore::Transaction transaction);
+    bool put(const std::string& collection, RecordStore::Records records);
+
+    // Removes the texts no committed record refers to; the number removed
+    size_t collectGarbage();
+
+    bool hasDictionary() const;
+    // Builds and stores the dictionary, if there are samples enough; it is
+    // never replaced, as stored texts depend on it
+    bool trainDictionary(const std::vector<std::string>& samples);
+
+    size_t size() const;
+
+private:
+    static std::string bucketFor(const std::string& key);
+    // What follows the key in a bucket record, and back
+    std::string encode(const std::string& content) const;
+    bool decode(const std::string& stored, std::string& content) const;
+    // The stored form under the new key, or unchanged if not encrypted
+    std::string reencrypt(const std::string& stored, const std::string& key) const;
+
+    mutable std::mutex m_mutex;
+    RecordStore* m_records { nullptr };
+    size_t m_compressMinSize { 0 };
+    bool m_compressDictionary { false };
+    std::string m_dictionary;
+    bool m_encrypted { false };
+    std::string m_key;
+    // Stored keys and the committed records referring to each
+    std::unordered_map<std::string, long> m_references;
+    // Interned since the last commit referring to them: the encoded text,
+    // empty when it is already stored
+    std::unordered_map<std::string, std::string> m_pending;
+};
+
+#endif
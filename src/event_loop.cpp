@@ -0,0 +1,146 @@
+#include "event_loop.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <initializer_list>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace
+{
+    void drain(int fd)
+    {
+        uint64_t count;
+        while (read(fd, &count, sizeof(count)) == sizeof(count))
+        {
+        }
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    shutdown();
+}
+
+bool EventLoop::init()
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_deadlineFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_epollFd < 0 || m_wakeFd < 0 || m_deadlineFd < 0 ||
+        !add(m_wakeFd, WAKE_TOKEN) || !add(m_deadlineFd, DEADLINE_TOKEN))
+    {
+        shutdown();
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::shutdown()
+{
+    for (int* fd : { &m_deadlineFd, &m_wakeFd, &m_epollFd })
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    m_deadlineArmed = false;
+}
+
+bool EventLoop::add(int fd, uint32_t token)
+{
+    if (fd < 0 || m_epollFd < 0)
+    {
+        return false;
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u32 = token;
+    return epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void EventLoop::remove(int fd)
+{
+    if (fd >= 0 && m_epollFd >= 0)
+    {
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+void EventLoop::wake()
+{
+    uint64_t one = 1;
+    if (m_wakeFd >= 0 && write(m_wakeFd, &one, sizeof(one)) != sizeof(one))
+    {
+        // The counter is already nonzero, so the loop wakes anyway
+    }
+}
+
+void EventLoop::setDeadline(std::chrono::steady_clock::time_point deadline)
+{
+    // The loop sets the same deadline on every pass; only a change costs a syscall
+    if (m_deadlineFd < 0 || (m_deadlineArmed && deadline == m_deadline))
+    {
+        return;
+    }
+
+    // steady_clock is CLOCK_MONOTONIC, so the time point is used as it is
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    if (ns <= 0)
+    {
+        ns = 1;
+    }
+    itimerspec spec {};
+    spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000LL);
+    spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000LL);
+    timerfd_settime(m_deadlineFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    m_deadline = deadline;
+    m_deadlineArmed = true;
+}
+
+void EventLoop::clearDeadline()
+{
+    if (m_deadlineFd < 0 || !m_deadlineArmed)
+    {
+        return;
+    }
+    itimerspec spec {};
+    timerfd_settime(m_deadlineFd, 0, &spec, nullptr);
+    drain(m_deadlineFd);
+    m_deadlineArmed = false;
+}
+
+size_t EventLoop::wait(uint32_t* tokens, size_t max)
+{
+    const int MAX_EVENTS = 8;
+    epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(m_epollFd, events, std::min<int>(MAX_EVENTS, static_cast<int>(max)), -1);
+    m_wakeups++;
+    if (count <= 0)
+    {
+        // EINTR: a signal handler may have changed what the loop should do
+        return 0;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        tokens[i] = events[i].data.u32;
+        if (tokens[i] == WAKE_TOKEN)
+        {
+            drain(m_wakeFd);
+        }
+        else if (tokens[i] == DEADLINE_TOKEN)
+        {
+            drain(m_deadlineFd);
+            m_deadlineArmed = false;
+        }
+    }
+    return static_cast<size_t>(count);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#ifdef __linux__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// The main thread's one place to sleep. The X connection and every worker
+// or timer fd is registered once under a token, and wait() blocks with no
+// timeout: an idle manager is not woken until something actually happened.
+// Deadlines (debounce windows) go through a timerfd rather than a computed
+// poll() timeout, and wake() lets another thread or a signal handler
+// interrupt the wait.
+class EventLoop
+{
+public:
+    // Tokens wait() reports for the loop's own fds
+    static const uint32_t WAKE_TOKEN = 0xffffffffu;
+    static const uint32_t DEADLINE_TOKEN = 0xfffffffeu;
+
+    ~EventLoop();
+
+    bool init();
+    void shutdown();
+
+    // A negative fd (a part that is not running) is skipped
+    bool add(int fd, uint32_t token);
+    void remove(int fd);
+
+    // Safe from any thread and from signal handlers
+    void wake();
+
+    // One-shot; a deadline already passed fires at once
+    void setDeadline(std::chrono::steady_clock::time_point deadline);
+    void clearDeadline();
+
+    // Blocks until at least one fd is ready and stores up to max tokens.
+    // The wake and deadline fds are cleared before their tokens are returned.
+    size_t wait(uint32_t* tokens, size_t max);
+
+    // Number of times wait() returned, for the stats command
+    unsigned long wakeups() const { return m_wakeups; }
+
+private:
+    int m_epollFd { -1 };
+    int m_wakeFd { -1 };
+    int m_deadlineFd { -1 };
+    bool m_deadlineArmed { false };
+    std::chrono::steady_clock::time_point m_deadline;
+    unsigned long m_wakeups { 0 };
+};
+
+#endif
+
+#endif
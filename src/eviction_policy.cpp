@@ -0,0 +1,232 @@
+#include "eviction_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const double HALF_LIFE_SECONDS = 24 * 60 * 60;
+    const long long TYPED_GRACE_SECONDS = 7 * 24 * 60 * 60;
+}
+
+bool EvictionPolicy::parse(const std::string& name, Kind& kind)
+{
+    if (name == "oldest")
+    {
+        kind = Kind::Oldest;
+    }
+    else if (name == "frecent")
+    {
+        kind = Kind::Frecent;
+    }
+    else if (name == "largest")
+    {
+        kind = Kind::Largest;
+    }
+    else if (name == "typed")
+    {
+        kind = Kind::Typed;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+double EvictionPolicy::addUse(double frecency, long long time)
+{
+    double use = static_cast<double>(time) * std::log(2.0) / HALF_LIFE_SECONDS;
+    if (frecency == NO_USES)
+    {
+        return use;
+    }
+    // log(e^a + e^b) without overflowing either
+    double high = std::max(frecency, use);
+    double low = std::min(frecency, use);
+    return high + std::log1p(std::exp(low - high));
+}
+
+double EvictionPolicy::score(const Clip& clip) const
+{
+    switch (m_kind)
+    {
+    case Kind::Frecent:
+        return clip.frecency;
+    case Kind::Typed:
+        return static_cast<double>(clip.lastUsed + (clip.keepLonger ? TYPED_GRACE_SECONDS : 0));
+    case Kind::Oldest:
+    case Kind::Largest:
+        break;
+    }
+    return static_cast<double>(clip.order);
+}
+
+void EvictionPolicy::setKind(Kind kind)
+{
+    if (kind == m_kind)
+    {
+        return;
+    }
+    m_kind = kind;
+    m_byScore.clear();
+    m_bySize.clear();
+    for (const auto& entry : m_clips)
+    {
+        m_byScore.push(score(entry.second), entry.first);
+        if (m_kind == Kind::Largest)
+        {
+            m_bySize.push(-static_cast<double>(entry.second.bytes), entry.first);
+        }
+    }
+}
+
+void EvictionPolicy::add(const Clip& clip)
+{
+    remove(clip.order);
+    m_clips.emplace(clip.order, clip);
+    m_byScore.push(score(clip), clip.order);
+    if (m_kind == Kind::Largest)
+    {
+        m_bySize.push(-static_cast<double>(clip.bytes), clip.order);
+    }
+}
+
+size_t EvictionPolicy::remove(long long order)
+{
+    auto found = m_clips.find(order);
+    if (found == m_clips.end())
+    {
+        return 0;
+    }
+    size_t bytes = found->second.bytes;
+    m_clips.erase(found);
+    m_byScore.erase(order);
+    m_bySize.erase(order);
+    return bytes;
+}
+
+void EvictionPolicy::clear()
+{
+    m_clips.clear();
+    m_byScore.clear();
+    m_bySize.clear();
+}
+
+bool EvictionPolicy::victim(bool overMemory, long long keep, long long& order) const
+{
+    if (overMemory && m_kind == Kind::Largest)
+    {
+        return m_bySize.least(keep, order);
+    }
+    return m_byScore.least(keep, order);
+}
+
+void EvictionPolicy::Heap::push(double score, long long order)
+{
+    m_entries.emplace_back(score, order);
+    m_positions[order] = m_entries.size() - 1;
+    siftUp(m_entries.size() - 1);
+}
+
+void EvictionPolicy::Heap::erase(long long order)
+{
+    auto found = m_positions.find(order);
+    if (found == m_positions.end())
+    {
+        return;
+    }
+    size_t index = found->second;
+    size_t last = m_entries.size() - 1;
+    if (index != last)
+    {
+        swapAt(index, last);
+    }
+    m_entries.pop_back();
+    m_positions.erase(found);
+    if (index < m_entries.size())
+    {
+        // The entry moved into the hole may belong above or below it
+        siftUp(index);
+        siftDown(index);
+    }
+}
+
+void EvictionPolicy::Heap::clear()
+{
+    m_entries.clear();
+    m_positions.clear();
+}
+
+bool EvictionPolicy::Heap::least(long long keep, long long& order) const
+{
+    if (m_entries.empty())
+    {
+        return false;
+    }
+    if (m_entries[0].second != keep)
+    {
+        order = m_entries[0].second;
+        return true;
+    }
+    // The runner-up is one of the root's children
+    if (m_entries.size() == 1)
+    {
+        return false;
+    }
+    size_t child = m_entries.size() > 2 && before(2, 1) ? 2 : 1;
+    order = m_entries[child].second;
+    return true;
+}
+
+bool EvictionPolicy::Heap::before(size_t a, size_t b) const
+{
+    // Equal scores go oldest first
+    return m_entries[a].first != m_entries[b].first ? m_entries[a].first < m_entries[b].first
+                                                    : m_entries[a].second < m_entries[b].second;
+}
+
+void EvictionPolicy::Heap::swapAt(size_t a, size_t b)
+{
+    std::swap(m_entries[a], m_entries[b]);
+    m_positions[m_entries[a].second] = a;
+    m_positions[m_entries[b].second] = b;
+}
+
+void EvictionPolicy::Heap::siftUp(size_t index)
+{
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (!before(index, parent))
+        {
+            break;
+        }
+        swapAt(index, parent);
+        index = parent;
+    }
+}
+
+void EvictionPolicy::Heap::siftDown(size_t index)
+{
+    for (;;)
+    {
+        size_t least = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < m_entries.size() && before(left, least))
+        {
+            least = left;
+        }
+        if (right < m_entries.size() && before(right, least))
+        {
+            least = right;
+        }
+        if (least == index)
+        {
+            break;
+        }
+        swapAt(index, least);
+        index = least;
+    }
+}
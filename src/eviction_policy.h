@@ -0,0 +1,94 @@
+#ifndef EVICTION_POLICY_H
+#define EVICTION_POLICY_H
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Decides which clip leaves the history when it is over max_clips or
+// max_memory_bytes, per eviction_policy:
+//
+//   oldest   the clip at the bottom of the list, as before
+//   frecent  the clip least used, recent uses counting most
+//   largest  the oldest for max_clips, the largest for max_memory_bytes
+//   typed    the oldest, URLs and paths counting a week younger
+//
+// Every clip sits in a heap ordered by its score, kept up to date as clips
+// come and go, so adding, removing and picking a clip are O(log n).
+class EvictionPolicy
+{
+public:
+    enum class Kind
+    {
+        Oldest,
+        Frecent,
+        Largest,
+        Typed
+    };
+
+    struct Clip
+    {
+        // Unique while the clip is in the history, larger nearer the top
+        long long order { 0 };
+        long long lastUsed { 0 };
+        double frecency { 0 };
+        size_t bytes { 0 };
+        // URLs and paths, which the typed policy keeps longer
+        bool keepLonger { false };
+    };
+
+    static constexpr double NO_USES = -std::numeric_limits<double>::infinity();
+
+    static bool parse(const std::string& name, Kind& kind);
+
+    // Scores are log(sum of 2^(use / half-life)) over the uses, in seconds.
+    // Every score decays alike, so their order holds without rescoring.
+    static double addUse(double frecency, long long time);
+
+    // Rebuilds the heaps if the kind changes
+    void setKind(Kind kind);
+    Kind kind() const { return m_kind; }
+
+    void add(const Clip& clip);
+    // The bytes the clip was added with, 0 if it is not here
+    size_t remove(long long order);
+    void clear();
+
+    // The order of the clip to evict next, never keep's; false if there is none
+    bool victim(bool overMemory, long long keep, long long& order) const;
+
+private:
+    // Min-heap of (score, order) with each order's position, so any entry
+    // can be removed in O(log n)
+    class Heap
+    {
+    public:
+        void push(double score, long long order);
+        void erase(long long order);
+        void clear();
+        // The least entry other than keep
+        bool least(long long keep, long long& order) const;
+
+    private:
+        bool before(size_t a, size_t b) const;
+        void swapAt(size_t a, size_t b);
+        void siftUp(size_t index);
+        void siftDown(size_t index);
+
+        std::vector<std::pair<double, long long>> m_entries;
+        std::unordered_map<long long, size_t> m_positions;
+    };
+
+    double score(const Clip& clip) const;
+
+    Kind m_kind { Kind::Oldest };
+    std::unordered_map<long long, Clip> m_clips;
+    Heap m_byScore;
+    // Largest first, for the largest policy under memory pressure
+    Heap m_bySize;
+};
+
+#endif
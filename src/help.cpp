@@ -1,10 +1,11 @@
 #include "help.h"
+#include "ui.h"
 
 #ifdef __linux__
 #include <X11/Xlib.h>
 extern Display* display;
-extern Window window;
-extern GC gc;
+extern Pixmap backBuffer;
+extern ThemeGCs themeGCs;
 #endif
 
 
@@ -17,7 +18,7 @@ void drawHelpTopic(HDC /*hdc*/, int x, int y, int contentTop, int contentBottom,
 {
     if (y >= contentTop && y < contentBottom)
     {
-        XDrawString(display, window, gc, x, y, topic.c_str(), topic.length());
+        XDrawString(display, backBuffer, themeGCs.text, x, y, topic.c_str(), topic.length());
     }
 }
 #endif
@@ -131,6 +132,8 @@ void buildHelpTopicsCache()
     helpTopicsCache.push_back({"`", "View bookmarks", false});
     helpTopicsCache.push_back({"p", "Pin clip", false});
     helpTopicsCache.push_back({"'", "View pinned clips", false});
+    helpTopicsCache.push_back({"Shift+p", "View primary selections", false});
+    helpTopicsCache.push_back({"Shift+a", "View archived clips", false});
     helpTopicsCache.push_back({"i", "Edit current clip", false});
     helpTopicsCache.push_back({"?", "This help", false});
     helpTopicsCache.push_back({"Shift+d", "Delete item", false});
@@ -153,6 +156,20 @@ void buildHelpTopicsCache()
     helpTopicsCache.push_back({"Enter", "Copy item", false});
     helpTopicsCache.push_back({"Escape", "Exit pinned clips", false});
 
+    helpTopicsCache.push_back({"Primary Selections (primary_history):", "", true});
+    helpTopicsCache.push_back({"j/k", "Navigate items", false});
+    helpTopicsCache.push_back({"g/G", "Top/bottom", false});
+    helpTopicsCache.push_back({"Shift+d", "Delete item", false});
+    helpTopicsCache.push_back({"Enter", "Add item to clip history", false});
+    helpTopicsCache.push_back({"Escape", "Exit primary selections", false});
+
+    helpTopicsCache.push_back({"Archive (archive_history):", "", true});
+    helpTopicsCache.push_back({"j/k", "Navigate items", false});
+    helpTopicsCache.push_back({"g/G", "Top/bottom", false});
+    helpTopicsCache.push_back({"/", "Type a search, Enter runs it", false});
+    helpTopicsCache.push_back({"Enter", "Add item to clip history", false});
+    helpTopicsCache.push_back({"Escape", "Clear search / Exit archive", false});
+
     helpTopicsCache.push_back({"Add Bookmark Group Dialog:", "", true});
     helpTopicsCache.push_back({"Type text", "Define Group Name / Filter Existing", false});
     helpTopicsCache.push_back({"Backspace", "Delete char", false});
@@ -181,6 +198,16 @@ void buildHelpTopicsCache()
     helpTopicsCache.push_back({"config", "Select config option or modify with: config key value", false});
     helpTopicsCache.push_back({"Enter", "Select config or apply change", false});
     helpTopicsCache.push_back({"Example: config max_clips 1000", "", false});
+    helpTopicsCache.push_back({"config near_duplicates", "off/newest/oldest: fold clips differing only in whitespace", false});
+    helpTopicsCache.push_back({"config archive_history", "Keep clips past max_clips in a searchable on-disk archive", false});
+    helpTopicsCache.push_back({"config archive_partition", "day/week: the span of one archive segment", false});
+    helpTopicsCache.push_back({"config archive_retention", "forever, or rules like 7d,1y>20 (1 year for clips over 20 chars)", false});
+    helpTopicsCache.push_back({"config compress_min_size", "Stored clips from this many bytes on are compressed", false});
+    helpTopicsCache.push_back({"config max_memory_bytes", "Cap on history text in memory; 0 for none", false});
+    helpTopicsCache.push_back({"config spill_min_size", "Under the cap, clips this large keep only a preview in memory", false});
+    helpTopicsCache.push_back({"config eviction_policy", "oldest/frecent/largest/typed: which clip goes past the limits", false});
+    helpTopicsCache.push_back({"config compress_dictionary", "Compress short clips against a dictionary learned from history", false});
+    helpTopicsCache.push_back({"stats", "Print clipboard capture counters", false});
     helpTopicsCache.push_back({"Escape", "Cancel command", false});
 
     helpTopicsCache.push_back({"Help Window:", "", true});
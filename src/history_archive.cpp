@@ -0,0 +1,818 @@
+#include "history_archive.h"
+#include "config.h"
+#include "content_store.h"
+#include "lz_codec.h"
+#include "record_store.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sys/stat.h>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Followed by 'e' when the rest is encrypted, 'p' when it is not
+    const std::string SEGMENT_MAGIC = "MMRYSEG2";
+    const char SEGMENT_ENCRYPTED = 'e';
+    const char SEGMENT_PLAIN = 'p';
+
+    // What a segment's clips contain, so a needle with one of these can
+    // skip segments without any
+    const unsigned FLAG_MULTILINE = 1;
+    const unsigned FLAG_URL = 2;
+    const unsigned FLAG_NON_ASCII = 4;
+
+    // About 1% false positives at ten bits per distinct trigram
+    const unsigned BLOOM_HASHES = 4;
+    const size_t BLOOM_BITS_PER_TRIGRAM = 10;
+    const size_t BLOOM_MIN_BYTES = 64;
+    const size_t BLOOM_MAX_BYTES = 16 * 1024;
+
+    unsigned flagsOf(const std::string& text)
+    {
+        unsigned flags = 0;
+        if (text.find('\n') != std::string::npos)
+        {
+            flags |= FLAG_MULTILINE;
+        }
+        if (text.find("://") != std::string::npos)
+        {
+            flags |= FLAG_URL;
+        }
+        if (std::any_of(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x80; }))
+        {
+            flags |= FLAG_NON_ASCII;
+        }
+        return flags;
+    }
+
+    uint64_t trigramHash(const std::string& text, size_t pos)
+    {
+        char lower[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(text[pos + i])));
+        }
+        return fnv1a64(lower, sizeof(lower));
+    }
+
+    // Double hashing: the probes are h1 + i * h2
+    template <typename F>
+    void forEachProbe(uint64_t hash, size_t bits, F fn)
+    {
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+        for (unsigned i = 0; i < BLOOM_HASHES; ++i)
+        {
+            fn((h1 + static_cast<uint64_t>(i) * h2) % bits);
+        }
+    }
+
+    std::string buildBloom(const std::unordered_set<uint64_t>& trigrams)
+    {
+        size_t bytes = BLOOM_MIN_BYTES;
+        while (bytes * 8 < trigrams.size() * BLOOM_BITS_PER_TRIGRAM && bytes < BLOOM_MAX_BYTES)
+        {
+            bytes *= 2;
+        }
+        std::string bloom(bytes, '\0');
+        for (uint64_t trigram : trigrams)
+        {
+            forEachProbe(trigram, bytes * 8, [&bloom](size_t bit) { bloom[bit / 8] |= static_cast<char>(1 << (bit % 8)); });
+        }
+        return bloom;
+    }
+
+    void putNumber(std::string& out, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    bool getNumber(const std::string& data, size_t& pos, int bytes, uint64_t& value)
+    {
+        if (data.size() - pos < static_cast<size_t>(bytes))
+        {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += bytes;
+        return true;
+    }
+
+    // Synced before the rename, so a listed segment is always complete
+    bool writeFile(const std::string& path, const std::string& data)
+    {
+        std::string temporary = path + ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+        bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size() && std::fflush(file) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(file)) == 0;
+#else
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool containsLower(const std::string& text, const std::string& lowerNeedle)
+    {
+        auto found = std::search(text.begin(), text.end(), lowerNeedle.begin(), lowerNeedle.end(),
+                                 [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+        return found != text.end() || lowerNeedle.empty();
+    }
+}
+
+const char* const HistoryArchive::INDEX_COLLECTION = "archive";
+const char* const HistoryArchive::TAIL_COLLECTION = "archive_tail";
+
+bool HistoryArchive::open(const std::string& directory, const RecordStore& records, ContentStore& contents,
+                          const ConfigManager& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = directory;
+    m_contents = &contents;
+    m_weekly = config.archivePartition == "week";
+    m_encrypted = config.encrypted;
+    m_key = config.encryptionKey;
+    m_segments.clear();
+    m_sealedClips = 0;
+    m_nextFile = 0;
+    m_tails.clear();
+    m_tailClips = 0;
+    m_cache.clear();
+
+#ifdef _WIN32
+    bool created = mkdir(directory.c_str()) == 0 || errno == EEXIST;
+#else
+    bool created = mkdir(directory.c_str(), 0700) == 0 || errno == EEXIST;
+#endif
+
+    // "file|count|newest|oldest|flags|shortest|longest|bloom", the Bloom
+    // filter last, as raw bytes
+    for (const std::string& record : records.read(INDEX_COLLECTION))
+    {
+        std::vector<std::string> fields;
+        size_t pos = 0;
+        while (fields.size() < 7)
+        {
+            size_t bar = record.find('|', pos);
+            if (bar == std::string::npos)
+            {
+                break;
+            }
+            fields.push_back(record.substr(pos, bar - pos));
+            pos = bar + 1;
+        }
+        if (fields.size() < 7 || pos == record.size())
+        {
+            continue;
+        }
+        Segment segment;
+        try
+        {
+            segment.file = fields[0];
+            segment.count = std::stoull(fields[1]);
+            segment.newest = std::stoll(fields[2]);
+            segment.oldest = std::stoll(fields[3]);
+            segment.flags = static_cast<unsigned>(std::stoul(fields[4]));
+            segment.shortest = std::stoull(fields[5]);
+            segment.longest = std::stoull(fields[6]);
+            segment.bloom = record.substr(pos);
+            m_nextFile = std::max<size_t>(m_nextFile, std::stoull(segment.file) + 1);
+        }
+        catch (...)
+        {
+            continue;
+        }
+        m_sealedClips += segment.count;
+        m_segments.push_back(std::move(segment));
+    }
+
+    for (const std::string& record : records.read(TAIL_COLLECTION))
+    {
+        Clip clip;
+        std::string key = ContentStore::referenceKey(record);
+        if (key.empty() || !contents.lookup(key, clip.content))
+        {
+            continue;
+        }
+        try
+        {
+            clip.timestamp = std::stoll(record.substr(0, record.find('|')));
+        }
+        catch (...)
+        {
+            continue;
+        }
+        // Saved newest period first, each tail newest first
+        Tail& tail = m_tails[periodOf(clip.timestamp)];
+        tail.clips.push_back(std::move(clip));
+        tail.keys.push_back(std::move(key));
+        m_tailClips++;
+    }
+    return created;
+}
+
+size_t HistoryArchive::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sealedClips + m_tailClips;
+}
+
+size_t HistoryArchive::segmentCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segments.size();
+}
+
+size_t HistoryArchive::segmentsSearched() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segmentsSearched;
+}
+
+size_t HistoryArchive::segmentsSkipped() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segmentsSkipped;
+}
+
+long long HistoryArchive::periodOf(long long timestamp) const
+{
+    // Days since the epoch, or weeks starting on Monday; the epoch was a Thursday
+    long long day = timestamp >= 0 ? timestamp / 86400 : (timestamp - 86399) / 86400;
+    if (m_weekly)
+    {
+        return day + 3 >= 0 ? (day + 3) / 7 : (day + 3 - 6) / 7;
+    }
+    return day;
+}
+
+void HistoryArchive::add(long long timestamp, const std::string& content)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_contents)
+    {
+        return;
+    }
+    // A segment holds a single period, so retention can drop it whole
+    long long period = periodOf(timestamp);
+    Tail& tail = m_tails[period];
+    auto position = std::find_if(tail.clips.begin(), tail.clips.end(),
+                                 [timestamp](const Clip& clip) { return clip.timestamp <= timestamp; });
+    size_t index = position - tail.clips.begin();
+    tail.clips.insert(position, Clip { timestamp, content });
+    tail.keys.insert(tail.keys.begin() + index, m_contents->intern(content));
+    m_tailClips++;
+    if (tail.clips.size() < SEGMENT_CLIPS || !seal(period))
+    {
+        saveTails();
+    }
+}
+
+void HistoryArchive::sealPastPeriods(long long now)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_contents)
+    {
+        return;
+    }
+    long long current = periodOf(now);
+    std::vector<long long> past;
+    for (const auto& tail : m_tails)
+    {
+        if (tail.first < current)
+        {
+            past.push_back(tail.first);
+        }
+    }
+    for (long long period : past)
+    {
+        seal(period);
+    }
+}
+
+RecordStore::Records HistoryArchive::tailRecords(long long skipPeriod) const
+{
+    RecordStore::Records records;
+    records.reserve(m_tailClips);
+    for (const auto& tail : m_tails)
+    {
+        if (tail.first == skipPeriod)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < tail.second.clips.size(); ++i)
+        {
+            records.push_back(std::to_string(tail.second.clips[i].timestamp) + "|" + ContentStore::REFERENCE_TAG +
+                              tail.second.keys[i]);
+        }
+    }
+    return records;
+}
+
+bool HistoryArchive::saveTails()
+{
+    return m_contents->put(TAIL_COLLECTION, tailRecords(std::numeric_limits<long long>::min()));
+}
+
+std::string HistoryArchive::indexRecord(const Segment& segment)
+{
+    return segment.file + "|" + std::to_string(segment.count) + "|" + std::to_string(segment.newest) + "|" +
+           std::to_string(segment.oldest) + "|" + std::to_string(segment.flags) + "|" +
+           std::to_string(segment.shortest) + "|" + std::to_string(segment.longest) + "|" + segment.bloom;
+}
+
+RecordStore::Records HistoryArchive::indexRecords(const std::vector<Segment>& segments) const
+{
+    RecordStore::Records index;
+    index.reserve(segments.size());
+    for (const Segment& segment : segments)
+    {
+        index.push_back(indexRecord(segment));
+    }
+    return index;
+}
+
+bool HistoryArchive::mayContain(const Segment& segment, const std::string& lowerNeedle)
+{
+    unsigned needed = flagsOf(lowerNeedle);
+    if ((segment.flags & needed) != needed || lowerNeedle.size() > segment.longest)
+    {
+        return false;
+    }
+
+    size_t bits = segment.bloom.size() * 8;
+    for (size_t pos = 0; pos + 3 <= lowerNeedle.size(); ++pos)
+    {
+        bool present = true;
+        forEachProbe(trigramHash(lowerNeedle, pos), bits, [&](size_t bit)
+        {
+            present = present && (segment.bloom[bit / 8] & (1 << (bit % 8)));
+        });
+        if (!present)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HistoryArchive::writeSegment(const std::vector<Clip>& clips, Segment& segment) const
+{
+    // u64 timestamp, u32 length, bytes; newest first
+    std::string raw;
+    unsigned flags = 0;
+    std::unordered_set<uint64_t> trigrams;
+    long long newest = clips.front().timestamp;
+    long long oldest = newest;
+    size_t shortest = clips.front().content.size();
+    size_t longest = shortest;
+    for (const Clip& clip : clips)
+    {
+        newest = std::max(newest, clip.timestamp);
+        oldest = std::min(oldest, clip.timestamp);
+        shortest = std::min(shortest, clip.content.size());
+        longest = std::max(longest, clip.content.size());
+        putNumber(raw, static_cast<uint64_t>(clip.timestamp), 8);
+        putNumber(raw, clip.content.size(), 4);
+        raw += clip.content;
+
+        flags |= flagsOf(clip.content);
+        for (size_t pos = 0; pos + 3 <= clip.content.size(); ++pos)
+        {
+            trigrams.insert(trigramHash(clip.content, pos));
+        }
+    }
+
+    segment.count = clips.size();
+    // Clips leave the history in list order, which need not be time order
+    segment.newest = newest;
+    segment.oldest = oldest;
+    segment.flags = flags;
+    segment.shortest = shortest;
+    segment.longest = longest;
+    segment.bloom = buildBloom(trigrams);
+    if (m_directory.empty())
+    {
+        return false;
+    }
+    std::string packed = lzCompress(raw);
+    std::string data = m_encrypted && !m_key.empty() ? SEGMENT_MAGIC + SEGMENT_ENCRYPTED + encryptWithKey(packed, m_key)
+                                                     : SEGMENT_MAGIC + SEGMENT_PLAIN + packed;
+    return writeFile(m_directory + "/" + segment.file + ".seg", data);
+}
+
+bool HistoryArchive::readSegment(const std::string& name, std::vector<Clip>& clips) const
+{
+    std::ifstream file(m_directory + "/" + name + ".seg", std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() <= SEGMENT_MAGIC.size() || data.compare(0, SEGMENT_MAGIC.size(), SEGMENT_MAGIC) != 0)
+    {
+        return false;
+    }
+
+    std::string packed = data.substr(SEGMENT_MAGIC.size() + 1);
+    if (data[SEGMENT_MAGIC.size()] == SEGMENT_ENCRYPTED)
+    {
+        if (m_key.empty())
+        {
+            return false;
+        }
+        packed = decryptWithKey(packed, m_key);
+    }
+    std::string raw;
+    if (!lzDecompress(packed, raw))
+    {
+        return false;
+    }
+
+    clips.clear();
+    size_t pos = 0;
+    while (pos < raw.size())
+    {
+        uint64_t timestamp;
+        uint64_t length;
+        if (!getNumber(raw, pos, 8, timestamp) || !getNumber(raw, pos, 4, length) || raw.size() - pos < length)
+        {
+            return false;
+        }
+        clips.push_back(Clip { static_cast<long long>(timestamp), raw.substr(pos, length) });
+        pos += length;
+    }
+    return true;
+}
+
+void HistoryArchive::setPartition(const std::string& partition)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool weekly = partition == "week";
+    if (weekly == m_weekly)
+    {
+        return;
+    }
+    // The tails are keyed by periods of the old kind, so their clips are
+    // sorted into tails of the new kind; still newest first in each
+    std::map<long long, Tail, std::greater<long long>> tails;
+    tails.swap(m_tails);
+    m_weekly = weekly;
+    for (auto& old : tails)
+    {
+        for (size_t i = 0; i < old.second.clips.size(); ++i)
+        {
+            Clip& clip = old.second.clips[i];
+            Tail& tail = m_tails[periodOf(clip.timestamp)];
+            auto position = std::find_if(tail.clips.begin(), tail.clips.end(),
+                                         [&clip](const Clip& other) { return other.timestamp <= clip.timestamp; });
+            tail.keys.insert(tail.keys.begin() + (position - tail.clips.begin()), std::move(old.second.keys[i]));
+            tail.clips.insert(position, std::move(clip));
+        }
+    }
+}
+
+bool HistoryArchive::setEncryption(bool encrypted, const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (key == m_key)
+    {
+        m_encrypted = encrypted;
+        return true;
+    }
+
+    // Every rewritten segment is written beside the old one first, so a
+    // failure leaves them all under the old key
+    std::vector<std::string> rewritten;
+    bool ok = true;
+    for (const Segment& segment : m_segments)
+    {
+        std::string path = m_directory + "/" + segment.file + ".seg";
+        std::ifstream file(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() <= SEGMENT_MAGIC.size() || data[SEGMENT_MAGIC.size()] != SEGMENT_ENCRYPTED)
+        {
+            continue;
+        }
+        std::string packed = m_key.empty() ? std::string() : decryptWithKey(data.substr(SEGMENT_MAGIC.size() + 1), m_key);
+        if (packed.empty())
+        {
+            continue;
+        }
+        data = key.empty() ? SEGMENT_MAGIC + SEGMENT_PLAIN + packed
+                           : SEGMENT_MAGIC + SEGMENT_ENCRYPTED + encryptWithKey(packed, key);
+        if (!writeFile(path + ".new", data))
+        {
+            ok = false;
+            break;
+        }
+        rewritten.push_back(path);
+    }
+    for (const std::string& path : rewritten)
+    {
+        std::string fresh = path + ".new";
+        if (!ok || std::rename(fresh.c_str(), path.c_str()) != 0)
+        {
+            std::remove(fresh.c_str());
+        }
+    }
+    if (!ok)
+    {
+        return false;
+    }
+    m_encrypted = encrypted;
+    m_key = key;
+    return true;
+}
+
+bool HistoryArchive::seal(long long period)
+{
+    auto tail = m_tails.find(period);
+    if (tail == m_tails.end() || tail->second.clips.empty())
+    {
+        return false;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08zu", m_nextFile);
+    Segment segment;
+    segment.file = name;
+    if (!writeSegment(tail->second.clips, segment))
+    {
+        return false;
+    }
+    m_nextFile++;
+
+    // A late period's segment goes among the others by time
+    std::vector<Segment> segments = m_segments;
+    auto position = std::upper_bound(segments.begin(), segments.end(), segment.newest,
+                                     [](long long newest, const Segment& other) { return newest < other.newest; });
+    segments.insert(position, segment);
+
+    // The index gains the segment as the tail empties, in one commit
+    RecordStore::Transaction transaction;
+    transaction.put(INDEX_COLLECTION, indexRecords(segments));
+    transaction.put(TAIL_COLLECTION, tailRecords(period));
+    if (!m_contents->commit(std::move(transaction)))
+    {
+        std::remove((m_directory + "/" + segment.file + ".seg").c_str());
+        return false;
+    }
+
+    m_sealedClips += segment.count;
+    m_segments = std::move(segments);
+    m_tailClips -= tail->second.clips.size();
+    m_tails.erase(tail);
+    return true;
+}
+
+const std::vector<HistoryArchive::Clip>* HistoryArchive::load(size_t segment)
+{
+    const std::string& name = m_segments[segment].file;
+    for (auto it = m_cache.begin(); it != m_cache.end(); ++it)
+    {
+        if (it->first == name)
+        {
+            m_cache.splice(m_cache.begin(), m_cache, it);
+            return &m_cache.front().second;
+        }
+    }
+
+    std::vector<Clip> clips;
+    if (!readSegment(name, clips))
+    {
+        return nullptr;
+    }
+    m_cache.emplace_front(name, std::move(clips));
+    if (m_cache.size() > CACHED_SEGMENTS)
+    {
+        m_cache.pop_back();
+    }
+    return &m_cache.front().second;
+}
+
+bool HistoryArchive::at(size_t index, Clip& clip)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& tail : m_tails)
+    {
+        if (index < tail.second.clips.size())
+        {
+            clip = tail.second.clips[index];
+            return true;
+        }
+        index -= tail.second.clips.size();
+    }
+
+    for (size_t segment = m_segments.size(); segment-- > 0;)
+    {
+        if (index >= m_segments[segment].count)
+        {
+            index -= m_segments[segment].count;
+            continue;
+        }
+        const std::vector<Clip>* clips = load(segment);
+        if (!clips || index >= clips->size())
+        {
+            return false;
+        }
+        clip = (*clips)[index];
+        return true;
+    }
+    return false;
+}
+
+void HistoryArchive::search(const std::string& lowerNeedle, size_t limit, std::vector<size_t>& matches)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    matches.clear();
+    size_t base = 0;
+    for (const auto& tail : m_tails)
+    {
+        for (size_t i = 0; i < tail.second.clips.size() && matches.size() < limit; ++i)
+        {
+            if (containsLower(tail.second.clips[i].content, lowerNeedle))
+            {
+                matches.push_back(base + i);
+            }
+        }
+        base += tail.second.clips.size();
+    }
+
+    for (size_t segment = m_segments.size(); segment-- > 0 && matches.size() < limit;)
+    {
+        if (!mayContain(m_segments[segment], lowerNeedle))
+        {
+            m_segmentsSkipped++;
+            base += m_segments[segment].count;
+            continue;
+        }
+        m_segmentsSearched++;
+        const std::vector<Clip>* clips = load(segment);
+        for (size_t i = 0; clips && i < clips->size() && matches.size() < limit; ++i)
+        {
+            if (containsLower((*clips)[i].content, lowerNeedle))
+            {
+                matches.push_back(base + i);
+            }
+        }
+        base += m_segments[segment].count;
+    }
+}
+
+size_t HistoryArchive::enforceRetention(const std::vector<RetentionRule>& rules, long long now)
+{
+    if (rules.empty())
+    {
+        return 0;
+    }
+    auto kept = [&](long long timestamp, size_t length)
+    {
+        return std::any_of(rules.begin(), rules.end(), [&](const RetentionRule& rule)
+        {
+            return now - timestamp <= rule.maxAge && length > rule.minLength;
+        });
+    };
+
+    std::vector<Segment> segments;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_contents)
+        {
+            return 0;
+        }
+        segments = m_segments;
+    }
+
+    // Decoding and rewriting happen outside the lock; only sealed segments
+    // are touched, and nothing else replaces or removes them
+    size_t removed = 0;
+    std::unordered_set<std::string> dropped;
+    std::vector<std::pair<std::string, Segment>> rewritten;
+    for (const Segment& segment : segments)
+    {
+        // The newest and longest clip might not be one and the same, but if
+        // no rule keeps even that combination, nothing in the segment is kept
+        if (!kept(segment.newest, segment.longest))
+        {
+            dropped.insert(segment.file);
+            removed += segment.count;
+            continue;
+        }
+        if (kept(segment.oldest, segment.shortest))
+        {
+            continue;
+        }
+
+        std::vector<Clip> clips;
+        if (!readSegment(segment.file, clips))
+        {
+            continue;
+        }
+        std::vector<Clip> remaining;
+        std::copy_if(clips.begin(), clips.end(), std::back_inserter(remaining),
+                     [&](const Clip& clip) { return kept(clip.timestamp, clip.content.size()); });
+        if (remaining.size() == clips.size())
+        {
+            continue;
+        }
+        if (remaining.empty())
+        {
+            dropped.insert(segment.file);
+            removed += segment.count;
+            continue;
+        }
+
+        Segment replacement;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            char name[32];
+            std::snprintf(name, sizeof(name), "%08zu", m_nextFile++);
+            replacement.file = name;
+        }
+        if (!writeSegment(remaining, replacement))
+        {
+            continue;
+        }
+        removed += clips.size() - remaining.size();
+        rewritten.emplace_back(segment.file, std::move(replacement));
+    }
+    if (dropped.empty() && rewritten.empty())
+    {
+        return 0;
+    }
+
+    std::vector<std::string> obsolete;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Segment> next;
+        size_t sealedClips = 0;
+        for (const Segment& segment : m_segments)
+        {
+            if (dropped.count(segment.file))
+            {
+                continue;
+            }
+            auto replaced = std::find_if(rewritten.begin(), rewritten.end(),
+                                         [&](const auto& entry) { return entry.first == segment.file; });
+            next.push_back(replaced == rewritten.end() ? segment : replaced->second);
+            sealedClips += next.back().count;
+        }
+
+        if (m_contents->put(INDEX_COLLECTION, indexRecords(next)))
+        {
+            m_segments = std::move(next);
+            m_sealedClips = sealedClips;
+            obsolete.assign(dropped.begin(), dropped.end());
+            for (const auto& entry : rewritten)
+            {
+                obsolete.push_back(entry.first);
+            }
+            m_cache.remove_if([&](const auto& cached)
+            {
+                return std::find(obsolete.begin(), obsolete.end(), cached.first) != obsolete.end();
+            });
+        }
+        else
+        {
+            // The index still lists the old files, so the new ones go
+            removed = 0;
+            for (const auto& entry : rewritten)
+            {
+                obsolete.push_back(entry.second.file);
+            }
+        }
+    }
+
+    for (const std::string& name : obsolete)
+    {
+        std::remove((m_directory + "/" + name + ".seg").c_str());
+    }
+    return removed;
+}
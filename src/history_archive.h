@@ -0,0 +1,154 @@
+#ifndef HISTORY_ARCHIVE_H
+#define HISTORY_ARCHIVE_H
+
+#include "record_store.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ConfigManager;
+class ContentStore;
+
+// Clips that max_clips pushed out of the history, kept when
+// archive_history is set. Each day (or week, per archive_partition) has a
+// tail its clips go to, references into the content store kept in one
+// collection. A tail is sealed into an immutable segment file,
+// LZ-compressed and encrypted as a whole and listed in the "archive"
+// collection, once it holds SEGMENT_CLIPS clips or its period is over.
+// Eviction policies other than oldest-first send clips out of time order,
+// and they still join their period's tail.
+//
+// A segment file records whether it is encrypted, so turning encryption
+// on or off leaves the archive readable, and a new key re-encrypts it.
+//
+// Only the tail is resident. Sealed segments are read when a row or a
+// search reaches them, and the last few decoded are cached, so the archive
+// can grow for years at a bounded cost in memory.
+//
+// Each index entry also carries a summary of its segment: the time span,
+// the shortest and longest clip, a bitmap of what the clips contain (line
+// breaks, URLs, non-ASCII text) and a Bloom filter of their lowercased
+// trigrams. A search reads only the segments whose summary admits the
+// needle, and retention drops a segment from its summary alone.
+//
+// The ingest worker enforces retention while the event thread reads and
+// adds, so every public method takes the archive's lock.
+class HistoryArchive
+{
+public:
+    struct Clip
+    {
+        long long timestamp { 0 };
+        std::string content;
+    };
+
+    static const size_t SEGMENT_CLIPS = 256;
+    static const char* const INDEX_COLLECTION;
+    static const char* const TAIL_COLLECTION;
+
+    bool open(const std::string& directory, const RecordStore& records, ContentStore& contents,
+              const ConfigManager& config);
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    size_t segmentCount() const;
+
+    // Takes a clip leaving the history; it is the newest archived from then on
+    void add(long long timestamp, const std::string& content);
+
+    // "day" or "week"; the open tails are regrouped when it changes
+    void setPartition(const std::string& partition);
+
+    // Whether new segments are encrypted, and with which key. A new key
+    // rewrites the encrypted segments; false if that failed, the old key
+    // then staying in use.
+    bool setEncryption(bool encrypted, const std::string& key);
+
+    // Seals the tails of the periods before now's
+    void sealPastPeriods(long long now);
+
+    // 0 is the newest archived clip: the tails newest period first, then
+    // the segments, newest first
+    bool at(size_t index, Clip& clip);
+
+    // Indices of the clips containing lowerNeedle, which must be lowercase,
+    // newest first and at most limit of them
+    void search(const std::string& lowerNeedle, size_t limit, std::vector<size_t>& matches);
+
+    // Segments searches decoded, and those their summaries ruled out
+    size_t segmentsSearched() const;
+    size_t segmentsSkipped() const;
+
+    // Unlinks the sealed segments no rule keeps anything of, and rewrites
+    // those only some clips of have expired. The number of clips removed.
+    size_t enforceRetention(const std::vector<RetentionRule>& rules, long long now);
+
+private:
+    struct Segment
+    {
+        std::string file;
+        size_t count { 0 };
+        long long newest { 0 };
+        long long oldest { 0 };
+        unsigned flags { 0 };
+        size_t shortest { 0 };
+        size_t longest { 0 };
+        std::string bloom;
+    };
+
+    static const size_t CACHED_SEGMENTS = 4;
+
+    static std::string indexRecord(const Segment& segment);
+    static bool mayContain(const Segment& segment, const std::string& lowerNeedle);
+    long long periodOf(long long timestamp) const;
+
+    // Writes the clips as a new segment file and fills in its summary
+    bool writeSegment(const std::vector<Clip>& clips, Segment& segment) const;
+    bool readSegment(const std::string& file, std::vector<Clip>& clips) const;
+    RecordStore::Records indexRecords(const std::vector<Segment>& segments) const;
+
+    // Newest first, with the content store key of each
+    struct Tail
+    {
+        std::vector<Clip> clips;
+        std::vector<std::string> keys;
+    };
+
+    // The tails' records, but for the tail of skipPeriod
+    RecordStore::Records tailRecords(long long skipPeriod) const;
+    bool seal(long long period);
+    bool saveTails();
+    // Newest first; nullptr if the file cannot be read
+    const std::vector<Clip>* load(size_t segment);
+
+    mutable std::mutex m_mutex;
+    std::string m_directory;
+    ContentStore* m_contents { nullptr };
+    bool m_weekly { false };
+    bool m_encrypted { false };
+    std::string m_key;
+
+    // Oldest first by their newest clip, as listed in the index
+    std::vector<Segment> m_segments;
+    size_t m_sealedClips { 0 };
+    size_t m_nextFile { 0 };
+
+    // By period, newest first
+    std::map<long long, Tail, std::greater<long long>> m_tails;
+    size_t m_tailClips { 0 };
+
+    size_t m_segmentsSearched { 0 };
+    size_t m_segmentsSkipped { 0 };
+
+    // By file name, most recently used first
+    std::list<std::pair<std::string, std::vector<Clip>>> m_cache;
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "ingest_pipeline.h"
+#include "blob_store.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+
+bool prepareClip(std::string raw, PreparedClip& clip)
+{
+    while (!raw.empty() && (raw.back() == '\n' || raw.back() == '\r'))
+    {
+        raw.pop_back();
+    }
+    if (raw.empty())
+    {
+        return false;
+    }
+
+    clip.content = std::move(raw);
+    clip.lowercase.resize(clip.content.size());
+    std::transform(clip.content.begin(), clip.content.end(), clip.lowercase.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    clip.hash = fnv1a64(clip.content.data(), clip.content.size());
+    clip.fingerprint = normalizedFingerprint(clip.content);
+    clip.isPath = isPath(clip.content);
+    clip.timestamp = std::chrono::system_clock::now();
+    return true;
+}
+
+void prepareBlobClip(const std::string& mimeType, size_t size, const std::string& key, PreparedClip& clip)
+{
+    clip.content = blobPlaceholder(mimeType, size, key);
+    clip.lowercase = clip.content;
+    std::transform(clip.lowercase.begin(), clip.lowercase.end(), clip.lowercase.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    clip.hash = fnv1a64(clip.content.data(), clip.content.size());
+    clip.fingerprint = 0;
+    clip.isPath = false;
+    clip.timestamp = std::chrono::system_clock::now();
+    clip.blobKey = key;
+    clip.mimeType = mimeType;
+    clip.blobSize = size;
+}
+
+const char* const SPILLED_TEXT_TYPE = "text/plain;charset=utf-8";
+
+namespace
+{
+    // Cut back to a character boundary, so the preview stays valid UTF-8
+    size_t previewLength(const char* data, size_t size)
+    {
+        if (size <= SPILL_PREVIEW_SIZE)
+        {
+            return size;
+        }
+        size_t length = SPILL_PREVIEW_SIZE;
+        while (length > 0 && (static_cast<unsigned char>(data[length]) & 0xc0) == 0x80)
+        {
+            --length;
+        }
+        return length;
+    }
+}
+
+void spillClip(const std::string& key, PreparedClip& clip)
+{
+    size_t size = clip.content.size();
+    size_t length = previewLength(clip.content.data(), size);
+    clip.content.resize(length);
+    clip.content.shrink_to_fit();
+    clip.lowercase.resize(length);
+    clip.lowercase.shrink_to_fit();
+    // Whitespace folding would compare previews only
+    clip.fingerprint = 0;
+    clip.blobKey = key;
+    clip.mimeType = SPILLED_TEXT_TYPE;
+    clip.blobSize = size;
+}
+
+void prepareSpilledClip(const char* data, size_t size, const std::string& key, PreparedClip& clip)
+{
+    clip.content.assign(data, previewLength(data, size));
+    clip.lowercase.resize(clip.content.size());
+    std::transform(clip.content.begin(), clip.content.end(), clip.lowercase.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    clip.hash = fnv1a64(data, size);
+    clip.fingerprint = 0;
+    clip.isPath = false;
+    clip.timestamp = std::chrono::system_clock::now();
+    clip.blobKey = key;
+    clip.mimeType = SPILLED_TEXT_TYPE;
+    clip.blobSize = size;
+}
+
+#ifdef __linux__
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+IngestPipeline::~IngestPipeline()
+{
+    stop();
+}
+
+bool IngestPipeline::start(std::function<void()> save, BlobStore* blobs)
+{
+    if (isRunning())
+    {
+        return true;
+    }
+
+    m_readyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_readyFd < 0)
+    {
+        return false;
+    }
+
+    m_save = std::move(save);
+    m_blobs = blobs;
+    m_stopping = false;
+    m_worker = std::thread(&IngestPipeline::run, this);
+    return true;
+}
+
+void IngestPipeline::stop()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+
+    close(m_readyFd);
+    m_readyFd = -1;
+}
+
+bool IngestPipeline::submit(std::string&& raw, const std::string& mimeType)
+{
+    RawClip clip { std::move(raw), mimeType };
+    if (!m_inbound.tryPush(std::move(clip)))
+    {
+        raw = std::move(clip.data);
+        return false;
+    }
+    wakeWorker();
+    return true;
+}
+
+void IngestPipeline::collect(const std::function<void(PreparedClip&&)>& publish)
+{
+    uint64_t count;
+    while (read(m_readyFd, &count, sizeof(count)) == sizeof(count))
+    {
+    }
+
+    PreparedClip clip;
+    while (m_outbound.tryPop(clip))
+    {
+        publish(std::move(clip));
+    }
+}
+
+void IngestPipeline::requestSave()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_saveRequested = true;
+    }
+    m_wake.notify_one();
+}
+
+void IngestPipeline::wakeWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_workPending = true;
+    }
+    m_wake.notify_one();
+}
+
+bool IngestPipeline::prepare(RawClip&& raw, PreparedClip& clip)
+{
+    if (raw.mimeType.empty())
+    {
+        if (!prepareClip(std::move(raw.data), clip))
+        {
+            return false;
+        }
+        size_t spillSize = m_spillSize;
+        if (spillSize && m_blobs && clip.content.size() >= spillSize)
+        {
+            // Kept in memory after all if the blob cannot be written
+            std::string key = m_blobs->put(clip.content);
+            if (!key.empty())
+            {
+                spillClip(key, clip);
+            }
+        }
+        return true;
+    }
+    if (!m_blobs)
+    {
+        return false;
+    }
+    std::string key = m_blobs->put(raw.data);
+    if (key.empty())
+    {
+        return false;
+    }
+    prepareBlobClip(raw.mimeType, raw.data.size(), key, clip);
+    return true;
+}
+
+void IngestPipeline::signalReady()
+{
+    uint64_t one = 1;
+    if (write(m_readyFd, &one, sizeof(one)) != sizeof(one))
+    {
+        // The counter cannot overflow in practice; the clip is
+        // picked up with the next wakeup either way
+    }
+}
+
+void IngestPipeline::run()
+{
+    for (;;)
+    {
+        bool save = false;
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_workPending || m_saveRequested || m_stopping; });
+            m_workPending = false;
+            save = m_saveRequested;
+            m_saveRequested = false;
+            stopping = m_stopping;
+        }
+
+        RawClip raw;
+        bool prepared = false;
+        while (!stopping && m_inbound.tryPop(raw))
+        {
+            PreparedClip clip;
+            if (!prepare(std::move(raw), clip))
+            {
+                continue;
+            }
+            // The event thread drains in bursts; wake it and wait for room
+            // rather than drop, unless it is going away
+            while (!m_outbound.tryPush(std::move(clip)))
+            {
+                signalReady();
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_wake.wait_for(lock, std::chrono::milliseconds(1), [this] { return m_stopping; }))
+                {
+                    stopping = true;
+                    break;
+                }
+            }
+            prepared = true;
+        }
+        if (prepared)
+        {
+            signalReady();
+        }
+
+        if (save && m_save)
+        {
+            m_save();
+        }
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef INGEST_PIPELINE_H
+#define INGEST_PIPELINE_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// A clipboard capture after normalization, with everything the history
+// needs precomputed, so publishing it is just an insert.
+struct PreparedClip
+{
+    std::string content;
+    std::string lowercase;
+    uint64_t hash { 0 };
+    // Same for copies that differ only in whitespace; 0 for binary clips
+    uint64_t fingerprint { 0 };
+    bool isPath { false };
+    std::chrono::system_clock::time_point timestamp;
+
+    // Set for binary clips, whose bytes live in the blob store; content is
+    // then only a placeholder
+    std::string blobKey;
+    std::string mimeType;
+    size_t blobSize { 0 };
+};
+
+// Trims trailing line breaks and fills in the derived fields. False if
+// nothing is left to store.
+bool prepareClip(std::string raw, PreparedClip& clip);
+
+// Fills in a binary clip that is already stored under key
+void prepareBlobClip(const std::string& mimeType, size_t size, const std::string& key, PreparedClip& clip);
+
+// Text clips past the spill size live in the blob store under this type,
+// with only their first SPILL_PREVIEW_SIZE bytes as content. The hash is
+// still that of the whole text.
+extern const char* const SPILLED_TEXT_TYPE;
+const size_t SPILL_PREVIEW_SIZE = 4096;
+
+// Cuts a prepared text clip down to its preview, its text stored under key
+void spillClip(const std::string& key, PreparedClip& clip);
+
+// Fills in a spilled clip from the text stored under key
+void prepareSpilledClip(const char* data, size_t size, const std::string& key, PreparedClip& clip);
+
+#ifdef __linux__
+
+#include "blob_store.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Moves clipboard processing off the X event thread. The event thread only
+// submits raw transfers; a worker prepares them (normalize, hash, classify,
+// lowercase) and hands them back through readyFd(), an eventfd the event
+// loop polls next to the X connection. Binary clips are written to the
+// blob store there. The worker also runs the history saves, which encrypt
+// every item and rewrite the data file.
+class IngestPipeline
+{
+public:
+    ~IngestPipeline();
+
+    // save is called on the worker thread whenever requestSave() was
+    bool start(std::function<void()> save, BlobStore* blobs);
+    // Finishes a pending save before returning
+    void stop();
+    bool isRunning() const { return m_worker.joinable(); }
+
+    // Event thread. False when the queue is full; raw is then untouched.
+    // A mimeType marks raw as binary data for the blob store.
+    bool submit(std::string&& raw, const std::string& mimeType = std::string());
+
+    int readyFd() const { return m_readyFd; }
+
+    // Event thread: clears the wakeup and hands over every prepared clip
+    void collect(const std::function<void(PreparedClip&&)>& publish);
+
+    void requestSave();
+
+    // Text clips from this size on are spilled to the blob store by the
+    // worker; 0 keeps them all in memory
+    void setSpillSize(size_t bytes) { m_spillSize = bytes; }
+
+private:
+    struct RawClip
+    {
+        std::string data;
+        std::string mimeType;
+    };
+
+    void run();
+    void wakeWorker();
+    // Wakes the event thread to collect prepared clips
+    void signalReady();
+    bool prepare(RawClip&& raw, PreparedClip& clip);
+
+    SpscQueue<RawClip, 64> m_inbound;
+    SpscQueue<PreparedClip, 64> m_outbound;
+    int m_readyFd { -1 };
+
+    std::function<void()> m_save;
+    BlobStore* m_blobs { nullptr };
+    std::atomic<size_t> m_spillSize { 0 };
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_workPending { false };
+    bool m_saveRequested { false };
+    bool m_stopping { false };
+};
+
+#endif
+
+#endif
@@ -0,0 +1,315 @@
+#include "lz_codec.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 65535;
+    const unsigned HASH_BITS = 14;
+    const uint32_t NO_POSITION = UINT32_MAX;
+    // No input byte yields more than one length byte's 255 output bytes
+    const size_t MAX_RATIO = 255;
+
+    // Dictionary training looks at segments built from eight-byte grams
+    const size_t GRAM = 8;
+    const size_t MAX_SEGMENT = 256;
+
+    uint32_t read32(const char* data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    size_t hashOf(uint32_t value)
+    {
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void putLength(std::string& out, size_t length)
+    {
+        while (length >= 255)
+        {
+            out.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    void putSequence(std::string& out, const char* literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        size_t extra = matchLength ? matchLength - MIN_MATCH : 0;
+        out.push_back(static_cast<char>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(extra, 15)));
+        if (literalCount >= 15)
+        {
+            putLength(out, literalCount - 15);
+        }
+        out.append(literals, literalCount);
+        if (matchLength)
+        {
+            out.push_back(static_cast<char>(offset & 0xff));
+            out.push_back(static_cast<char>(offset >> 8));
+            if (extra >= 15)
+            {
+                putLength(out, extra - 15);
+            }
+        }
+    }
+
+    struct Reader
+    {
+        const unsigned char* data;
+        size_t size;
+        size_t pos { 0 };
+        bool ok { true };
+
+        bool atEnd() const { return pos >= size; }
+
+        unsigned byte()
+        {
+            if (pos >= size)
+            {
+                ok = false;
+                return 0;
+            }
+            return data[pos++];
+        }
+
+        size_t length(size_t base)
+        {
+            size_t length = base;
+            if (base == 15)
+            {
+                unsigned more;
+                do
+                {
+                    more = byte();
+                    length += more;
+                } while (ok && more == 255);
+            }
+            return length;
+        }
+    };
+}
+
+std::string lzCompress(const std::string& input, const std::string& dictionary)
+{
+    // Matches are searched in the dictionary and the input as one window
+    std::string window = dictionary;
+    window += input;
+    const char* data = window.data();
+    size_t start = dictionary.size();
+    size_t end = window.size();
+
+    std::string out;
+    out.reserve(input.size() / 2 + 16);
+    for (size_t size = input.size(); ; size >>= 7)
+    {
+        if (size < 0x80)
+        {
+            out.push_back(static_cast<char>(size));
+            break;
+        }
+        out.push_back(static_cast<char>((size & 0x7f) | 0x80));
+    }
+
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, NO_POSITION);
+    for (size_t pos = start > MAX_OFFSET ? start - MAX_OFFSET : 0; pos + MIN_MATCH <= start; ++pos)
+    {
+        table[hashOf(read32(data + pos))] = static_cast<uint32_t>(pos);
+    }
+
+    size_t anchor = start;
+    size_t pos = start;
+    while (pos + MIN_MATCH <= end)
+    {
+        uint32_t sequence = read32(data + pos);
+        size_t slot = hashOf(sequence);
+        uint32_t candidate = table[slot];
+        table[slot] = static_cast<uint32_t>(pos);
+
+        if (candidate == NO_POSITION || pos - candidate > MAX_OFFSET || read32(data + candidate) != sequence)
+        {
+            ++pos;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (pos + length < end && data[candidate + length] == data[pos + length])
+        {
+            ++length;
+        }
+        putSequence(out, data + anchor, pos - anchor, pos - candidate, length);
+
+        // Later matches can start inside this one
+        size_t matchEnd = pos + length;
+        for (++pos; pos < matchEnd && pos + MIN_MATCH <= end; pos += 2)
+        {
+            table[hashOf(read32(data + pos))] = static_cast<uint32_t>(pos);
+        }
+        pos = matchEnd;
+        anchor = pos;
+    }
+    putSequence(out, data + anchor, end - anchor, 0, 0);
+    return out;
+}
+
+bool lzDecompress(const std::string& input, std::string& output, const std::string& dictionary)
+{
+    Reader reader { reinterpret_cast<const unsigned char*>(input.data()), input.size() };
+
+    size_t size = 0;
+    for (unsigned shift = 0; ; shift += 7)
+    {
+        unsigned byte = reader.byte();
+        if (!reader.ok || shift > 56)
+        {
+            return false;
+        }
+        size |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+
+    // The length is not trusted with an allocation before it is plausible
+    if (size / MAX_RATIO > input.size())
+    {
+        return false;
+    }
+
+    std::string window;
+    window.reserve(dictionary.size() + size);
+    window = dictionary;
+    size_t limit = dictionary.size() + size;
+
+    while (true)
+    {
+        unsigned token = reader.byte();
+        size_t literals = reader.length(token >> 4);
+        if (!reader.ok || literals > reader.size - reader.pos || window.size() + literals > limit)
+        {
+            return false;
+        }
+        window.append(input, reader.pos, literals);
+        reader.pos += literals;
+        if (reader.atEnd())
+        {
+            break;
+        }
+
+        size_t offset = reader.byte();
+        offset |= static_cast<size_t>(reader.byte()) << 8;
+        size_t length = reader.length(token & 0x0f) + MIN_MATCH;
+        if (!reader.ok || offset == 0 || offset > window.size() || window.size() + length > limit)
+        {
+            return false;
+        }
+        // Byte by byte, as the match may overlap what it produces
+        size_t from = window.size() - offset;
+        for (size_t i = 0; i < length; ++i)
+        {
+            window.push_back(window[from + i]);
+        }
+    }
+
+    if (window.size() != limit)
+    {
+        return false;
+    }
+    output.assign(window, dictionary.size(), std::string::npos);
+    return true;
+}
+
+std::string lzTrainDictionary(const std::vector<std::string>& samples, size_t maxSize)
+{
+    auto gramAt = [](const std::string& sample, size_t pos)
+    {
+        return fnv1a64(sample.data() + pos, GRAM);
+    };
+
+    // In how many samples each gram appears
+    std::unordered_map<uint64_t, uint32_t> counts;
+    for (const std::string& sample : samples)
+    {
+        std::unordered_set<uint64_t> seen;
+        for (size_t pos = 0; pos + GRAM <= sample.size(); ++pos)
+        {
+            if (seen.insert(gramAt(sample, pos)).second)
+            {
+                counts[gramAt(sample, pos)]++;
+            }
+        }
+    }
+
+    // Runs of shared grams become segments, scored by how shared they are
+    std::unordered_map<std::string, uint64_t> segments;
+    for (const std::string& sample : samples)
+    {
+        size_t pos = 0;
+        while (pos + GRAM <= sample.size())
+        {
+            if (counts[gramAt(sample, pos)] < 2)
+            {
+                ++pos;
+                continue;
+            }
+            size_t first = pos;
+            uint64_t score = 0;
+            while (pos + GRAM <= sample.size() && pos - first + GRAM < MAX_SEGMENT)
+            {
+                uint32_t count = counts[gramAt(sample, pos)];
+                if (count < 2)
+                {
+                    break;
+                }
+                score += count;
+                ++pos;
+            }
+            segments[sample.substr(first, pos - first + GRAM - 1)] += score;
+        }
+    }
+
+    std::vector<std::pair<uint64_t, const std::string*>> ranked;
+    ranked.reserve(segments.size());
+    for (const auto& segment : segments)
+    {
+        ranked.emplace_back(segment.second, &segment.first);
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b)
+    {
+        return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+    });
+
+    std::vector<const std::string*> chosen;
+    std::string joined;
+    for (const auto& entry : ranked)
+    {
+        const std::string& segment = *entry.second;
+        if (joined.size() + segment.size() > maxSize)
+        {
+            continue;
+        }
+        if (joined.find(segment) == std::string::npos)
+        {
+            chosen.push_back(&segment);
+            joined += segment;
+        }
+    }
+
+    // Nearest the input means the shortest offsets, so the best go last
+    std::string dictionary;
+    dictionary.reserve(joined.size());
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it)
+    {
+        dictionary += **it;
+    }
+    return dictionary;
+}
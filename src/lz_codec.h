@@ -0,0 +1,24 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <string>
+#include <vector>
+
+// A small LZ77 codec in the LZ4 style, for clip texts: runs of literals
+// and back references of up to 64 KiB, found through a hash of the next
+// four bytes. Matches may also reach into a dictionary given to both
+// sides, which is what lets short clips compress at all.
+//
+// The output starts with the original length as a varint, then sequences
+// of: a token (literal count in the high nibble, match length minus four
+// in the low one, 15 meaning more length bytes follow), the literals, and
+// a two-byte little-endian offset. The last sequence has literals only.
+std::string lzCompress(const std::string& input, const std::string& dictionary = std::string());
+// False when the data is damaged or needs another dictionary
+bool lzDecompress(const std::string& input, std::string& output, const std::string& dictionary = std::string());
+
+// Builds a dictionary of at most maxSize bytes from the segments that
+// recur most across the samples, the most useful last
+std::string lzTrainDictionary(const std::vector<std::string>& samples, size_t maxSize);
+
+#endif
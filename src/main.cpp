@@ -4,6 +4,17 @@
 #include "ui.h"
 #include "config.h"
 #include "utils.h"
+#include "shm_renderer.h"
+#include "selection_owner.h"
+#include "selection_reader.h"
+#include "selection_requests.h"
+#include "ingest_pipeline.h"
+#include "primary_history.h"
+#include "blob_store.h"
+#include "xcb_backend.h"
+#include "event_loop.h"
+#include "allocation_counter.h"
+#include "clip_rows.h"
 
 /*
 
@@ -50,11 +61,17 @@
     Window window;
     Window root;
     int screen;
-    GC gc;
+    ThemeGCs themeGCs;
+    Pixmap backBuffer;
+    int backBufferWidth;
+    int backBufferHeight;
     XFontStruct* font;
+    FontMetrics fontMetrics;
     Atom clipboardAtom;
     Atom utf8Atom;
     Atom textAtom;
+    Atom targetsAtom;
+    Atom pngAtom;
     int xfixes_event_base;
     int xfixes_error_base;
 #endif
@@ -85,15 +102,157 @@ public:
 private:
     std::atomic<bool> hotkeyGrabbed{false};
     mutable std::ofstream logfile;
+    // The ingest worker logs too, from saveToFile
+    mutable std::mutex logMutex;
     ConfigManager config;
+    // Frames drawn and the X requests they issued since the last report
+    unsigned long frameCount { 0 };
+    unsigned long long frameRequests { 0 };
+    unsigned long long peakFrameRequests { 0 };
+    // With MMRY_COUNT_ALLOCATIONS; otherwise always 0
+    unsigned long long frameAllocations { 0 };
+    unsigned long allocatingFrames { 0 };
+
+    // Set when the hotkey maps the window, cleared by the first blit
+    bool awaitingFirstPaint { false };
+    std::chrono::steady_clock::time_point hotkeyTime;
+
+#ifdef __linux__
+    // Draws the clip list client-side when shm_renderer is on and MIT-SHM works
+    ShmRenderer shmRenderer;
+
+    // Row storage reused by every frame, so steady-state rendering does not
+    // allocate. The draw calls only ever see views into these; the clip rows
+    // also keep their trimmed text, so unchanged rows are not trimmed again.
+    ClipRows clipRows;
+    std::vector<std::string> bookmarkRowCache;
+    std::vector<std::pair<long long, std::string>> pinnedRowCache;
+    std::vector<std::string_view> dialogRows;
+
+    // Serves CLIPBOARD to other clients after a copy out of the history
+    SelectionOwner clipboardOwner;
+    // Server time of the last key press, used as the ownership timestamp
+    Time lastUserTime { CurrentTime };
+    // Prepares captured clips and runs the saves off the event thread
+    IngestPipeline ingestPipeline;
+
+    // Debounced conversion of one selection. Owner changes within the
+    // window of each other are one copy: only the last is converted. A
+    // transfer that completes for an owner that has since been replaced is
+    // discarded.
+    struct SelectionWatch
+    {
+        Atom selection { None };
+        std::chrono::milliseconds debounce { 0 };
+        size_t maxTextSize { 0 };
+        // Ask for TARGETS first, so binary-only owners can be served too
+        bool negotiateTargets { false };
+
+        bool conversionPending { false };
+        std::chrono::steady_clock::time_point conversionDue;
+        Time pendingOwnerTime { CurrentTime };
+        unsigned long ownerGeneration { 0 };
+
+        unsigned long ownerChanges { 0 };   // XFixes notifications
+        unsigned long conversions { 0 };    // conversions actually requested
+        unsigned long coalesced { 0 };      // changes superseded within the window
+        unsigned long staleDropped { 0 };   // transfers finished for a replaced owner
+        unsigned long timedOut { 0 };       // owners that never answered
+    };
+    SelectionWatch clipboardWatch;
+
+    // Every conversion in flight, each on its own property with a deadline
+    SelectionRequests selectionRequests;
+
+    // Everything the main thread waits on, registered under these tokens
+    EventLoop eventLoop;
+    enum LoopSource : uint32_t
+    {
+        LOOP_X,
+        LOOP_INGEST,
+        LOOP_SELECTION_TIMEOUT,
+        LOOP_OWNER_TIMEOUT,
+        LOOP_XCB
+    };
+#ifdef MMRY_XCB
+    // Carries the readers' property requests when built with XCB
+    XcbConnection xcbConnection;
+#endif
+    const std::chrono::seconds SELECTION_TRANSFER_TIMEOUT { 2 };
+    // Replies that matched no request: late answers after a timeout, or
+    // replies meant for another client on our window
+    unsigned long unmatchedReplies { 0 };
+
+    // Opt-in (primary_history): mouse selections go to their own ring and
+    // reach the main history only when promoted from the primary dialog.
+    // PRIMARY changes with every drag, so it is debounced harder and its
+    // transfers are capped, which bounds the work one selection can cost.
+    SelectionWatch primaryWatch;
+    const std::chrono::milliseconds PRIMARY_DEBOUNCE { 300 };
+    const size_t PRIMARY_MAX_BYTES { 64 * 1024 };
+
+    // Images copied to CLIPBOARD; the history keeps only their key
+    BlobStore blobStore;
+    const size_t MAX_BLOB_SIZE { 64 * 1024 * 1024 };
+    // encrypted covers the texts in the database and the archive only.
+    // Blob files are served to other clients straight from their mapping,
+    // so they stay as copied; said in the log whenever encryption is on.
+    const char* const UNENCRYPTED_IMAGES_NOTE {
+        "encrypted covers texts only, copied images are kept unencrypted in the blobs directory" };
+#endif
+    PrimaryHistory primaryHistory;
+
+    // Marks a data file line as a blob reference rather than clip text
+    const std::string BLOB_RECORD_TAG { "@blob|" };
+    // The clip history's collection in the database
+    const std::string HISTORY_COLLECTION { "history" };
+
+    // Copies promoted in place of an entry differing only in whitespace
+    unsigned long nearDuplicatesFolded { 0 };
+
+    // Clips max_memory_bytes pushed out of the history
+    unsigned long memoryEvictions { 0 };
+
+    // Picks the clips to evict; it sees every insertItem and eraseItem
+    EvictionPolicy evictionPolicy;
+    // Clips go in at the top, or at the bottom while loading, so the list
+    // stays ordered by these
+    long long topOrder { 0 };
+    long long bottomOrder { 0 };
+    // What the history's texts take in memory, both copies of each
+    size_t residentTotal { 0 };
+
+    // Clips evicted since the last save, waiting for it to archive them
+    std::vector<HistoryArchive::Clip> archiveQueue;
+    std::mutex archiveQueueMutex;
+
+    // What saveToFile reads of the configuration, copied from it on the
+    // event thread whenever it changes, as the worker must not read the
+    // config while a command writes it
+    struct SaveSettings
+    {
+        bool archiveHistory { false };
+        bool compressDictionary { false };
+        std::string archiveRetention;
+    };
+    SaveSettings saveSettings;
+    std::mutex saveSettingsMutex;
+    // config.m_debugging, for writeLog on either thread
+    std::atomic<bool> debugLogging { true };
+
+    // Archive retention runs with a save, at most once an hour
+    std::chrono::steady_clock::time_point retentionDue;
+    unsigned long archivedClipsExpired { 0 };
 
     // Helper method for logging
     void writeLog(const std::string& message) const
     {
-        if (config.m_debugging)
+        if (debugLogging)
         {
             auto now = std::chrono::system_clock::now();
             auto in_time_t = std::chrono::system_clock::to_time_t(now);
+            // localtime's result is shared as well
+            std::lock_guard<std::mutex> lock(logMutex);
             logfile << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %X") << " | " << message << std::endl;
         }
     }
@@ -670,6 +829,120 @@ public:
         }
 
 
+        // Promoting PRIMARY selections
+        //
+        if (primaryDialogVisible)
+        {
+            if (key_value == "j" || key_value == "DOWN")
+            {
+                if (key_primary_down()) return;
+            }
+
+            if (key_value == "k" || key_value == "UP")
+            {
+                if (key_primary_up()) return;
+            }
+
+            if (key_value == "g")
+            {
+                if (key_primary_top()) return;
+            }
+
+            if (key_value == "G")
+            {
+                if (key_primary_bottom()) return;
+            }
+
+            if (key_value == "D")
+            {
+                if (key_primary_delete()) return;
+            }
+
+            if (key_value == "RETURN")
+            {
+                if (key_primary_promote()) return;
+            }
+
+            return;
+        }
+
+
+        // Browsing and searching the archive
+        //
+        if (archiveDialogVisible)
+        {
+            if (archiveFilterMode)
+            {
+                if (key_value == "RETURN")
+                {
+                    if (key_archive_search()) return;
+                }
+                if (key_value == "BACKSPACE")
+                {
+                    if (!archiveFilterText.empty())
+                    {
+                        archiveFilterText.pop_back();
+                        drawConsole();
+                    }
+                    return;
+                }
+                // Text input for the search, run on Enter as it reads the segments
+#ifdef _WIN32
+                char typedChar = getCharFromMsg(msg);
+                if (typedChar != 0 && typedChar != '\r' && typedChar != '\n')
+                {
+                    archiveFilterText += typedChar;
+                    drawConsole();
+                }
+#else
+                char buffer[10];
+                int count = XLookupString(keyEvent, buffer, sizeof(buffer), nullptr, nullptr);
+                if (count > 0 && buffer[0] != '\r' && buffer[0] != '\n')
+                {
+                    archiveFilterText += std::string(buffer, count);
+                    drawConsole();
+                }
+#endif
+                return;
+            }
+
+            if (key_value == "/")
+            {
+                archiveFilterMode = true;
+                archiveFilterText.clear();
+                drawConsole();
+                return;
+            }
+
+            if (key_value == "j" || key_value == "DOWN")
+            {
+                if (key_archive_down()) return;
+            }
+
+            if (key_value == "k" || key_value == "UP")
+            {
+                if (key_archive_up()) return;
+            }
+
+            if (key_value == "g")
+            {
+                if (key_archive_top()) return;
+            }
+
+            if (key_value == "G")
+            {
+                if (key_archive_bottom()) return;
+            }
+
+            if (key_value == "RETURN")
+            {
+                if (key_archive_restore()) return;
+            }
+
+            return;
+        }
+
+
         // Adding the current clip to a bookmark group
         //
         if (addToBookmarkDialogVisible)
@@ -1041,6 +1314,18 @@ public:
         {
             if (key_main_pins_start()) return;
         }
+
+        // Primary selections dialog
+        if (key_value == "P")
+        {
+            if (key_main_primary_start()) return;
+        }
+
+        // Archived clips dialog
+        if (key_value == "A")
+        {
+            if (key_main_archive_start()) return;
+        }
     }
 
 
@@ -1072,11 +1357,31 @@ public:
                 drawConsole();
                 return true;
             }
+            if (archiveFilterMode)
+            {
+                archiveFilterMode = false;
+                archiveFilterText.clear();
+                archiveSearched = false;
+                selectedArchiveItem = 0;
+                archiveScrollOffset = 0;
+                drawConsole();
+                return true;
+            }
             if (pinnedDialogVisible)
             {
                 pinnedDialogVisible = false;
                 drawConsole();
             }
+            else if (primaryDialogVisible)
+            {
+                primaryDialogVisible = false;
+                drawConsole();
+            }
+            else if (archiveDialogVisible)
+            {
+                archiveDialogVisible = false;
+                drawConsole();
+            }
             else if (bookmarkDialogVisible)
             {
                 // Escape hides dialog but not window
@@ -1132,7 +1437,7 @@ public:
                 // Restore original theme and exit theme selection mode but doesn't hide window
                 if (!config.originalTheme.empty())
                 {
-                    config.switchTheme(config.originalTheme);
+                    switchTheme(config.originalTheme);
                 }
                 cmd_themeSelectMode = false;
                 availableThemes.clear();
@@ -1170,14 +1475,12 @@ public:
         {
             if (!editDialogInput.empty())
             {
-                // Create a new ClipboardItem from the edited content
-                ClipboardItem newItem(editDialogInput);
-
-                // Insert the new item at the beginning of the items vector
-                items.insert(items.begin(), newItem);
+                // Insert the edited content as a new item at the top
+                insertItem(0, ClipboardItem(editDialogInput));
+                evictClips();
 
                 // Save to file with updated content
-                saveToFile();
+                requestSave();
 
                 std::cout << "Clip edited and saved as new item.\n";
             }
@@ -1411,14 +1714,16 @@ public:
                 {
                     // Create new group and add current clip
                     bookmarkGroups.push_back(bookmarkDialogInput);
-                    saveBookmarkGroups();
-                    
+                    if (!saveBookmarkGroups())
+                    {
+                        bookmarkGroups.pop_back();
+                        std::cout << "Could not save the bookmark group: " << bookmarkDialogInput << "\n";
+                    }
                     // Add current clip to bookmark
-                    if (!items.empty() && selectedItem < getDisplayItemCount())
+                    else if (!items.empty() && selectedItem < getDisplayItemCount())
                     {
                         size_t actualIndex = getActualItemIndex(selectedItem);
-                        addClipToBookmarkGroup(bookmarkDialogInput, items[actualIndex].content);
-                        std::cout << "Added clip to bookmark group: " << bookmarkDialogInput << "\n";
+                        addClipToBookmarkGroup(bookmarkDialogInput, clipText(items[actualIndex]));
                     }
                 }
                 else
@@ -1427,8 +1732,7 @@ public:
                     if (!items.empty() && selectedItem < getDisplayItemCount())
                     {
                         size_t actualIndex = getActualItemIndex(selectedItem);
-                        addClipToBookmarkGroup(bookmarkDialogInput, items[actualIndex].content);
-                        std::cout << "Added clip to bookmark group: " << bookmarkDialogInput << "\n";
+                        addClipToBookmarkGroup(bookmarkDialogInput, clipText(items[actualIndex]));
                     }
                 }
                 
@@ -1512,13 +1816,14 @@ public:
             {
                 std::string groupToDelete = bookmarkGroups[selectedViewBookmarkGroup];
                 
-                // Remove group from list
+                // Remove group from list, and its clips with it
                 bookmarkGroups.erase(bookmarkGroups.begin() + selectedViewBookmarkGroup);
-                saveBookmarkGroups();
-                
-                // Delete bookmark file
-                std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + groupToDelete + ".txt";
-                unlink(bookmarkFile.c_str());
+                if (!bookmarkStore.dropGroup(groupToDelete, bookmarkGroups))
+                {
+                    bookmarkGroups.insert(bookmarkGroups.begin() + selectedViewBookmarkGroup, groupToDelete);
+                    std::cout << "Could not delete bookmark group: " << groupToDelete << "\n";
+                    return true;
+                }
                 
                 std::cout << "Deleted bookmark group and all clips: " << groupToDelete << "\n";
                 
@@ -1584,7 +1889,7 @@ public:
 
         bool key_marks_clips_down()
         {
-            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkClips.size() : getBookmarkItemCount();
+            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkIndices.size() : getBookmarkItemCount();
             if (selectedViewBookmarkItem < currentItemCount - 1)
             {
                 selectedViewBookmarkItem++;
@@ -1615,7 +1920,7 @@ public:
 
         bool key_marks_clips_bottom()
         {
-            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkClips.size() : getBookmarkItemCount();
+            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkIndices.size() : getBookmarkItemCount();
             if (currentItemCount > 0)
             {
                 selectedViewBookmarkItem = currentItemCount - 1;
@@ -1630,99 +1935,37 @@ public:
             if (selectedViewBookmarkGroup < bookmarkGroups.size())
             {
                 std::string selectedGroup = bookmarkGroups[selectedViewBookmarkGroup];
-                std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-                std::ifstream file(bookmarkFile);
-                
-                if (file.is_open())
-                {
-                    std::string line;
-                    std::vector<std::string> lines;
-                    std::vector<std::string> actualBookmarkItems; // To hold decrypted items
 
-                    // Read all lines and decrypt for comparison/deletion
-                    while (std::getline(file, line))
-                    {
-                        lines.push_back(line); // Store original line with timestamp
-                        size_t pos = line.find('|');
-                        if (pos != std::string::npos && pos > 0)
-                        {
-                            std::string content = line.substr(pos + 1);
-                            try
-                            {
-                                actualBookmarkItems.push_back(decrypt(content, config));
-                            }
-                            catch (...)
-                            {
-                                actualBookmarkItems.push_back(content);
-                            }
-                        }
-                    }
-                    file.close();
+                size_t actualIndexToDelete = selectedViewBookmarkItem;
+                if (filterBookmarkClipsMode)
+                {
+                    actualIndexToDelete = selectedViewBookmarkItem < filteredBookmarkIndices.size()
+                        ? filteredBookmarkIndices[selectedViewBookmarkItem] : (size_t)-1;
+                }
 
-                    std::string itemToDeleteContent;
-                    size_t actualIndexToDelete = -1;
+                // Remove the selected item if valid
+                if (bookmarkStore.erase(selectedGroup, actualIndexToDelete))
+                {
+                    std::cout << "Deleted bookmark item from group: " << selectedGroup << "\n";
 
+                    // Update filter if active
                     if (filterBookmarkClipsMode)
                     {
-                        if (selectedViewBookmarkItem < filteredBookmarkClips.size())
-                        {
-                            itemToDeleteContent = filteredBookmarkClips[selectedViewBookmarkItem];
-                            // Find the index of this item in the original actualBookmarkItems
-                            for (size_t i = 0; i < actualBookmarkItems.size(); ++i)
-                            {
-                                if (actualBookmarkItems[i] == itemToDeleteContent)
-                                {
-                                    actualIndexToDelete = i;
-                                    break;
-                                }
-                            }
-                        }
+                        updateFilteredBookmarkClips();
                     }
-                    else
+
+                    // Adjust selection
+                    size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkIndices.size() : getBookmarkItemCount();
+                    if (selectedViewBookmarkItem > 0 && selectedViewBookmarkItem >= currentItemCount)
                     {
-                        if (selectedViewBookmarkItem < actualBookmarkItems.size())
-                        {
-                            actualIndexToDelete = selectedViewBookmarkItem;
-                        }
+                        selectedViewBookmarkItem = currentItemCount - 1;
                     }
-                    
-                    // Remove the selected item if valid
-                    if (actualIndexToDelete != (size_t)-1 && actualIndexToDelete < lines.size())
+                    if (currentItemCount == 0)
                     {
-                        lines.erase(lines.begin() + actualIndexToDelete);
-                        
-                        // Write back remaining lines
-                        std::ofstream outFile(bookmarkFile);
-                        if (outFile.is_open())
-                        {
-                            for (const auto& l : lines)
-                            {
-                                outFile << l << "\n";
-                            }
-                            outFile.close();
-                            
-                            std::cout << "Deleted bookmark item from group: " << selectedGroup << "\n";
-                            
-                            // Update filter if active
-                            if (filterBookmarkClipsMode)
-                            {
-                                updateFilteredBookmarkClips();
-                            }
-
-                            // Adjust selection
-                            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkClips.size() : getBookmarkItemCount();
-                            if (selectedViewBookmarkItem > 0 && selectedViewBookmarkItem >= currentItemCount)
-                            {
-                                selectedViewBookmarkItem = currentItemCount - 1;
-                            }
-                            if (currentItemCount == 0)
-                            {
-                                selectedViewBookmarkItem = 0; // Reset if list becomes empty
-                            }
-                            
-                            drawConsole();
-                        }
+                        selectedViewBookmarkItem = 0; // Reset if list becomes empty
                     }
+
+                    drawConsole();
                 }
             }
             return true;
@@ -1730,79 +1973,29 @@ public:
 
         bool key_marks_clips_copy()
         {
-            if (filterBookmarkClipsMode)
+            const BookmarkStore::Entry* entry = bookmarkEntryAt(selectedViewBookmarkItem);
+            if (entry)
             {
-                if (selectedViewBookmarkItem < filteredBookmarkClips.size())
+                copyToClipboard(entry->content);
+                int lines = countLines(entry->content);
+                if (lines > 1)
                 {
-                    copyToClipboard(filteredBookmarkClips[selectedViewBookmarkItem]);
-                    int lines = countLines(filteredBookmarkClips[selectedViewBookmarkItem]);
-                    if (lines > 1)
-                    {
-                        std::cout << "Copied " << lines << " lines from bookmark" << "\n";
-                    }
-                    else
-                    {
-                        std::cout << "Copied from bookmark: " << filteredBookmarkClips[selectedViewBookmarkItem].substr(0, 50) << "..." << "\n";
-                    }
-                    viewBookmarksDialogVisible = false;
-                    hideWindow();
+                    std::cout << "Copied " << lines << " lines from bookmark" << "\n";
                 }
+                else
+                {
+                    std::cout << "Copied from bookmark: " << entry->content.substr(0, 50) << "..." << "\n";
+                }
+                viewBookmarksDialogVisible = false;
+                hideWindow();
+            }
+            if (filterBookmarkClipsMode)
+            {
                 // Clear filter if active
                 filterBookmarkClipsMode = false;
                 filterBookmarkClipsText.clear();
-                return true;
-            }
-            else
-            {
-                if (selectedViewBookmarkGroup < bookmarkGroups.size())
-                {
-                    std::string selectedGroup = bookmarkGroups[selectedViewBookmarkGroup];
-                    std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-                    std::ifstream file(bookmarkFile);
-                    
-                    if (file.is_open())
-                    {
-                        std::string line;
-                        std::vector<std::string> bookmarkItems;
-                        
-                        while (std::getline(file, line))
-                        {
-                            size_t pos = line.find('|');
-                            if (pos != std::string::npos && pos > 0)
-                            {
-                                std::string content = line.substr(pos + 1);
-                                try
-                                {
-                                    std::string decryptedContent = decrypt(content, config);
-                                    bookmarkItems.push_back(decryptedContent);
-                                }
-                                catch (...)
-                                {
-                                    bookmarkItems.push_back(content);
-                                }
-                            }
-                        }
-                        file.close();
-                        
-                        if (selectedViewBookmarkItem < bookmarkItems.size())
-                        {
-                            copyToClipboard(bookmarkItems[selectedViewBookmarkItem]);
-                            int lines = countLines(bookmarkItems[selectedViewBookmarkItem]);
-                            if (lines > 1)
-                            {
-                                std::cout << "Copied " << lines << " lines from bookmark" << "\n";
-                            }
-                            else
-                            {
-                                std::cout << "Copied from bookmark: " << bookmarkItems[selectedViewBookmarkItem].substr(0, 50) << "..." << "\n";
-                            }
-                            viewBookmarksDialogVisible = false;
-                            hideWindow();
-                        }
-                    }
-                }
-                return true;
             }
+            return true;
         }
 
         bool key_marks_clips_groups()
@@ -1815,8 +2008,7 @@ public:
         // Pinned Clips
         bool key_pin_down()
         {
-            auto sortedItems = getSortedPinnedItems(config.pinnedFile);
-            if (selectedViewPinnedItem < sortedItems.size() - 1)
+            if (selectedViewPinnedItem + 1 < pinnedStore.size())
             {
                 selectedViewPinnedItem++;
                 updatePinnedScrollOffset();
@@ -1846,10 +2038,9 @@ public:
 
         bool key_pin_bottom()
         {
-            auto sortedItems = getSortedPinnedItems(config.pinnedFile);
-            if (!sortedItems.empty())
+            if (!pinnedStore.empty())
             {
-                selectedViewPinnedItem = sortedItems.size() - 1;
+                selectedViewPinnedItem = pinnedStore.size() - 1;
                 updatePinnedScrollOffset();
                 drawConsole();
             }
@@ -1858,93 +2049,48 @@ public:
 
         bool key_pin_delete()
         {
-            auto sortedItems = getSortedPinnedItems(config.pinnedFile);
-            
             // Remove the selected item if valid
-            if (selectedViewPinnedItem < sortedItems.size())
+            if (pinnedStore.erase(selectedViewPinnedItem))
             {
-                sortedItems.erase(sortedItems.begin() + selectedViewPinnedItem);
+                std::cout << "Deleted pinned clip\n";
 
-                // Write back remaining lines
-                std::ofstream outFile(config.pinnedFile);
-                if (outFile.is_open())
+                // Adjust selection
+                if (selectedViewPinnedItem > 0 && selectedViewPinnedItem >= pinnedStore.size())
                 {
-                    for (const auto& item : sortedItems)
-                    {
-                        outFile << item << "\n";
-                    }
-                    outFile.close();
-                    
-                    std::cout << "Deleted pinned clip\n";
-                    
-                    // Adjust selection
-                    if (selectedViewPinnedItem > 0 && selectedViewPinnedItem >= sortedItems.size())
-                    {
-                        selectedViewPinnedItem = sortedItems.size() - 1;
-                    }
-                    
-                    // Close dialog if no pinned clips left
-                    if (sortedItems.empty())
-                    {
-                        pinnedDialogVisible = false;
-                    }
-                    
-                    drawConsole();
+                    selectedViewPinnedItem = pinnedStore.size() - 1;
+                }
+
+                // Close dialog if no pinned clips left
+                if (pinnedStore.empty())
+                {
+                    pinnedDialogVisible = false;
                 }
+
+                drawConsole();
             }
             return true;
         }
 
         bool key_pin_copy()
         {
-            auto sortedItems = getSortedPinnedItems(config.pinnedFile);
-
-            if (selectedViewPinnedItem < sortedItems.size())
+            if (selectedViewPinnedItem < pinnedStore.size())
             {
-                std::string selectedLine = sortedItems[selectedViewPinnedItem];
-                size_t pos = selectedLine.find('|');
-                if (pos != std::string::npos)
-                {
-                    std::string contentToCopy;
-                    std::string contentToSave = selectedLine.substr(pos + 1);
-                    try
-                    {
-                        contentToCopy = decrypt(contentToSave, config);
-                    }
-                    catch (...)
-                    {
-                        contentToCopy = contentToSave;
-                    }
-
-                    copyToClipboard(contentToCopy);
-
-                    int lineCount = countLines(contentToCopy);
-                    if (lineCount > 1)
-                    {
-                        std::cout << "Copied " << lineCount << " lines from pinned clips\n";
-                    }
-                    else
-                    {
-                        std::cout << "Copied from pinned clips: " << contentToCopy.substr(0, 50) << "...\n";
-                    }
-
-                    // Remove the old line from sorted items
-                    sortedItems.erase(sortedItems.begin() + selectedViewPinnedItem);
+                const std::string& contentToCopy = pinnedStore.at(selectedViewPinnedItem).content;
+                copyToClipboard(contentToCopy);
 
-                    // Add the new line at the beginning
-                    auto newTimestamp = std::chrono::system_clock::now().time_since_epoch().count();
-                    std::string newLine = std::to_string(newTimestamp) + "|" + contentToSave;
-                    sortedItems.insert(sortedItems.begin(), newLine);
-                    
-                    // Write the updated lines back to the file
-                    std::ofstream outFile(config.pinnedFile);
-                    for (const auto& l : sortedItems)
-                    {
-                        outFile << l << std::endl;
-                    }
-                    outFile.close();
+                int lineCount = countLines(contentToCopy);
+                if (lineCount > 1)
+                {
+                    std::cout << "Copied " << lineCount << " lines from pinned clips\n";
+                }
+                else
+                {
+                    std::cout << "Copied from pinned clips: " << contentToCopy.substr(0, 50) << "...\n";
                 }
 
+                // The copied clip becomes the newest pin
+                pinnedStore.touch(selectedViewPinnedItem);
+
                 pinnedDialogVisible = false;
                 hideWindow();
             }
@@ -1978,29 +2124,11 @@ public:
                 if (!items.empty() && selectedItem < getDisplayItemCount())
                 {
                     size_t actualIndex = getActualItemIndex(selectedItem);
-                    std::string clipContent = items[actualIndex].content;
-                    
-                    // Read existing bookmarks in this group
-                    std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-                    std::ifstream file(bookmarkFile);
-                    std::string line;
-                    bool alreadyExists = false;
-                    
-                    while (std::getline(file, line))
-                    {
-                        std::string decrypted = decrypt(line, config);
-                        if (decrypted == clipContent)
-                        {
-                            alreadyExists = true;
-                            break;
-                        }
-                    }
-                    file.close();
+                    std::string clipContent = clipText(items[actualIndex]);
                     
-                    if (!alreadyExists)
+                    if (!bookmarkStore.contains(selectedGroup, clipContent))
                     {
                         addClipToBookmarkGroup(selectedGroup, clipContent);
-                        std::cout << "Added clip to bookmark group: " << selectedGroup << "\n";
                     }
                     else
                     {
@@ -2063,7 +2191,7 @@ public:
             if (!items.empty() && selectedItem < getDisplayItemCount())
             {
                 size_t actualIndex = getActualItemIndex(selectedItem);
-                items.erase(items.begin() + actualIndex);
+                eraseItem(actualIndex);
                 
                 // Update filtered items after deletion
                 updateFilteredItems();
@@ -2075,7 +2203,7 @@ public:
                 }
                 
                 // Save changes and redraw
-                saveToFile();
+                requestSave();
                 drawConsole();
             }
             return true;
@@ -2086,7 +2214,7 @@ public:
             if (!items.empty() && selectedItem < getDisplayItemCount())
             {
                 size_t actualIndex = getActualItemIndex(selectedItem);
-                copyToClipboard(items[actualIndex].content);
+                copyItemToClipboard(items[actualIndex]);
                 int lines = countLines(items[actualIndex].content);
                 if (lines > 1)
                 {
@@ -2176,7 +2304,7 @@ public:
                 {
                     config.originalTheme = config.theme;
                     selectedTheme = 0;
-                    config.switchTheme(availableThemes[0]);
+                    switchTheme(availableThemes[0]);
                 }
                 drawConsole();
                 return true;
@@ -2203,7 +2331,7 @@ public:
         {
             if (!config.originalTheme.empty())
             {
-                config.switchTheme(config.originalTheme);
+                switchTheme(config.originalTheme);
             }
             cmd_themeSelectMode = false;
             availableThemes.clear();
@@ -2217,7 +2345,7 @@ public:
         {
             if (selectedTheme < availableThemes.size())
             {
-                config.switchTheme(availableThemes[selectedTheme]);
+                switchTheme(availableThemes[selectedTheme]);
                 // Save to config
                 config.saveConfig();
             }
@@ -2238,7 +2366,7 @@ public:
                 // Apply live preview
                 if (selectedTheme < availableThemes.size())
                 {
-                    config.switchTheme(availableThemes[selectedTheme]);
+                    switchTheme(availableThemes[selectedTheme]);
                 }
                 drawConsole();
             }
@@ -2254,7 +2382,7 @@ public:
                 // Apply live preview
                 if (selectedTheme < availableThemes.size())
                 {
-                    config.switchTheme(availableThemes[selectedTheme]);
+                    switchTheme(availableThemes[selectedTheme]);
                 }
                 drawConsole();
             }
@@ -2399,7 +2527,7 @@ public:
             if (!items.empty() && selectedItem < getDisplayItemCount())
             {
                 size_t actualIndex = getActualItemIndex(selectedItem);
-                items.erase(items.begin() + actualIndex);
+                eraseItem(actualIndex);
                 
                 // Adjust selection
                 size_t displayCount = getDisplayItemCount();
@@ -2414,7 +2542,7 @@ public:
                     updateFilteredItems();
                 }
                 
-                saveToFile();
+                requestSave();
                 drawConsole();
             }
             return true;
@@ -2448,16 +2576,16 @@ public:
                 size_t actualIndex = getActualItemIndex(selectedItem);
                 std::string clipContent = items[actualIndex].content;
 
-                copyToClipboard(clipContent);
+                copyItemToClipboard(items[actualIndex]);
 
                 // Update timestamp and move to top if not already at top
                 if (actualIndex != 0)
                 {
-                    // Remove from current position
-                    items.erase(items.begin() + actualIndex);
-
-                    // Create new item with current timestamp and insert at top
-                    items.emplace(items.begin(), ClipboardItem(clipContent));
+                    // Move to the top with the current timestamp
+                    moveItemToTop(actualIndex, [](ClipboardItem& item)
+                    {
+                        item.timestamp = std::chrono::system_clock::now();
+                    });
 
                     // Reset selection to top
                     selectedItem = 0;
@@ -2469,7 +2597,7 @@ public:
                     }
 
                     // Save to file with updated timestamp
-                    saveToFile();
+                    requestSave();
 
                     std::cout << "Clip moved to top after copying\n";
                 }
@@ -2542,28 +2670,18 @@ public:
             if (!items.empty() && selectedItem < getDisplayItemCount())
             {
                 size_t actualIndex = getActualItemIndex(selectedItem);
-                std::string clipContent = items[actualIndex].content;
-                
-                // Read existing bookmarks in this group
-                std::ifstream file(config.pinnedFile);
-                std::string line;
-                bool alreadyExists = false;
+                std::string clipContent = clipText(items[actualIndex]);
                 
-                while (std::getline(file, line))
+                if (!pinnedStore.contains(clipContent))
                 {
-                    std::string decrypted = decrypt(line, config);
-                    if (decrypted == clipContent)
+                    if (addClipToPinned(clipContent))
                     {
-                        alreadyExists = true;
-                        break;
+                        std::cout << "Added clip to pinned\n";
+                    }
+                    else
+                    {
+                        std::cout << "Could not save the pinned clip\n";
                     }
-                }
-                file.close();
-                
-                if (!alreadyExists)
-                {
-                    addClipToPinned(clipContent);
-                    std::cout << "Added clip to pinned\n";
                 }
                 else
                 {
@@ -2573,6 +2691,193 @@ public:
             return true;
         }
 
+        // Primary Selections
+        bool key_primary_down()
+        {
+            if (selectedPrimaryItem + 1 < primaryHistory.size())
+            {
+                selectedPrimaryItem++;
+                updatePrimaryScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        bool key_primary_up()
+        {
+            if (selectedPrimaryItem > 0)
+            {
+                selectedPrimaryItem--;
+                updatePrimaryScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        bool key_primary_top()
+        {
+            selectedPrimaryItem = 0;
+            primaryScrollOffset = 0;
+            drawConsole();
+            return true;
+        }
+
+        bool key_primary_bottom()
+        {
+            if (!primaryHistory.empty())
+            {
+                selectedPrimaryItem = primaryHistory.size() - 1;
+                updatePrimaryScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        bool key_primary_delete()
+        {
+            if (selectedPrimaryItem < primaryHistory.size())
+            {
+                primaryHistory.erase(selectedPrimaryItem);
+                if (selectedPrimaryItem >= primaryHistory.size() && selectedPrimaryItem > 0)
+                {
+                    selectedPrimaryItem--;
+                }
+                updatePrimaryScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        // Copies the selection into the main history, the only way one gets there
+        bool key_primary_promote()
+        {
+            if (selectedPrimaryItem < primaryHistory.size())
+            {
+                processClipboardContent(primaryHistory.at(selectedPrimaryItem));
+                std::cout << "Primary selection added to history\n";
+            }
+            primaryDialogVisible = false;
+            drawConsole();
+            return true;
+        }
+
+        // Archive
+        size_t archiveRowCount() const
+        {
+            return archiveSearched ? archiveMatches.size() : historyArchive.size();
+        }
+
+        bool key_archive_down()
+        {
+            if (selectedArchiveItem + 1 < archiveRowCount())
+            {
+                selectedArchiveItem++;
+                updateArchiveScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        bool key_archive_up()
+        {
+            if (selectedArchiveItem > 0)
+            {
+                selectedArchiveItem--;
+                updateArchiveScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        bool key_archive_top()
+        {
+            selectedArchiveItem = 0;
+            archiveScrollOffset = 0;
+            drawConsole();
+            return true;
+        }
+
+        bool key_archive_bottom()
+        {
+            if (archiveRowCount() > 0)
+            {
+                selectedArchiveItem = archiveRowCount() - 1;
+                updateArchiveScrollOffset();
+                drawConsole();
+            }
+            return true;
+        }
+
+        bool key_archive_search()
+        {
+            const size_t MAX_MATCHES = 1000;
+            std::string needle = archiveFilterText;
+            std::transform(needle.begin(), needle.end(), needle.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            historyArchive.search(needle, MAX_MATCHES, archiveMatches);
+            archiveSearched = !needle.empty();
+            archiveFilterMode = false;
+            selectedArchiveItem = 0;
+            archiveScrollOffset = 0;
+            drawConsole();
+            return true;
+        }
+
+        // Copies the archived clip back to the top of the history
+        bool key_archive_restore()
+        {
+            if (selectedArchiveItem < archiveRowCount())
+            {
+                size_t index = archiveSearched ? archiveMatches[selectedArchiveItem] : selectedArchiveItem;
+                HistoryArchive::Clip clip;
+                if (historyArchive.at(index, clip))
+                {
+                    processClipboardContent(clip.content);
+                    std::cout << "Archived clip added to history\n";
+                }
+            }
+            archiveDialogVisible = false;
+            drawConsole();
+            return true;
+        }
+
+        bool key_main_archive_start()
+        {
+            if (historyArchive.empty() && !config.archiveHistory)
+            {
+                std::cout << "The history archive is off (config archive_history true)\n";
+                return true;
+            }
+            archiveDialogVisible = true;
+            archiveFilterMode = false;
+            archiveFilterText.clear();
+            archiveSearched = false;
+            archiveMatches.clear();
+            selectedArchiveItem = 0;
+            archiveScrollOffset = 0;
+            drawConsole();
+            return true;
+        }
+
+        bool key_main_primary_start()
+        {
+#ifndef __linux__
+            std::cout << "Primary selection history needs X11\n";
+            return true;
+#endif
+            if (!config.primaryHistory)
+            {
+                std::cout << "Primary selection history is off (config primary_history true)\n";
+                return true;
+            }
+            primaryDialogVisible = true;
+            selectedPrimaryItem = 0;
+            primaryScrollOffset = 0;
+            drawConsole();
+
+            return true;
+        }
+
         bool key_main_pins_start()
         {
             pinnedDialogVisible = true;
@@ -2588,6 +2893,16 @@ public:
             if (!items.empty() && selectedItem < getDisplayItemCount())
             {
                 size_t actualIndex = getActualItemIndex(selectedItem);
+                if (items[actualIndex].isSpilled())
+                {
+                    std::cout << "Clips past spill_min_size cannot be edited\n";
+                    return true;
+                }
+                if (items[actualIndex].isBlob())
+                {
+                    std::cout << "Binary clips cannot be edited\n";
+                    return true;
+                }
                 editDialogInput = items[actualIndex].content;
                 editDialogVisible = true;
                 editDialogScrollOffset = 0;
@@ -2758,6 +3073,56 @@ public:
         }
     }
 
+    void switchTheme(const std::string& themeName)
+    {
+        config.switchTheme(themeName);
+        applyThemeColors();
+    }
+
+    // Push the current theme colours to the window background and the
+    // per-colour GCs, so drawing itself never has to change GC state
+    void applyThemeColors()
+    {
+#ifdef __linux__
+        if (!display) return;
+
+        XSetWindowBackground(display, window, config.backgroundColor);
+        setThemeGCColors(display, themeGCs,
+                         config.backgroundColor, config.textColor, config.selectionColor, config.borderColor);
+#endif
+    }
+
+    // Switch between the MIT-SHM renderer and core X drawing to follow the
+    // shm_renderer setting
+    void updateRenderer()
+    {
+#ifdef __linux__
+        if (!display) return;
+
+        if (!config.shmRenderer)
+        {
+            if (shmRenderer.isActive())
+            {
+                shmRenderer.shutdown();
+                writeLog("MIT-SHM renderer disabled");
+            }
+            return;
+        }
+        if (shmRenderer.isActive())
+        {
+            return;
+        }
+        if (shmRenderer.init(display, screen, font))
+        {
+            writeLog("MIT-SHM renderer enabled");
+        }
+        else
+        {
+            writeLog("MIT-SHM unavailable, using core X drawing");
+        }
+#endif
+    }
+
 
 
 
@@ -2786,9 +3151,18 @@ public:
             return;
         }
 
-        clipboardAtom = XInternAtom(display, "CLIPBOARD", False);
-        utf8Atom = XInternAtom(display, "UTF8_STRING", False);
-        textAtom = XInternAtom(display, "TEXT", False);
+        // One round trip for every atom the selection code uses. Xlib
+        // caches the results, so the owner and reader interning the same
+        // names in their init() are answered without asking the server.
+        const char* atomNames[] = { "CLIPBOARD", "UTF8_STRING", "TEXT", "TARGETS", "image/png", "TIMESTAMP", "INCR" };
+        Atom atoms[sizeof(atomNames) / sizeof(atomNames[0])];
+        XInternAtoms(display, const_cast<char**>(atomNames), static_cast<int>(sizeof(atomNames) / sizeof(atomNames[0])),
+                     False, atoms);
+        clipboardAtom = atoms[0];
+        utf8Atom = atoms[1];
+        textAtom = atoms[2];
+        targetsAtom = atoms[3];
+        pngAtom = atoms[4];
         
         // Create window
         createWindow();
@@ -2801,14 +3175,56 @@ public:
         config.setupConfigDir();
         config.loadConfig();
         config.loadTheme();
+        applyThemeColors();
+        updateRenderer();
+        applyEvictionPolicy();
 #ifdef __linux__
-        if (gc)
+        if (!blobStore.open(config.configDir + "/blobs"))
         {
-            XSetForeground(display, gc, config.textColor);
+            writeLog("Could not create the blob directory, images will not be kept");
+        }
+        else if (config.encrypted)
+        {
+            writeLog(UNENCRYPTED_IMAGES_NOTE);
         }
 #endif
+        bool importedLegacyFiles = false;
+        if (!database.open(config.databaseFile))
+        {
+            std::cerr << "Cannot open " << config.databaseFile << ", changes will not be saved" << std::endl;
+        }
+        else if (database.isNew())
+        {
+            importedLegacyFiles = importLegacyFiles();
+        }
+        contentStore.open(database, config);
         loadFromFile();
+        bookmarkStore.open(database, contentStore, config);
+        pinnedStore.open(database, contentStore, config);
+        if (!historyArchive.open(config.configDir + "/archive", database, contentStore, config))
+        {
+            writeLog("Could not create the archive directory, old clips will not be archived");
+        }
+        updateSaveSettings();
+        evictClips();
         loadBookmarkGroups();
+        if (importedLegacyFiles)
+        {
+            // Stores the imported bookmarks by reference now rather than on
+            // first view, so a failure shows up in the log at startup
+            for (const std::string& group : bookmarkGroups)
+            {
+                bookmarkStore.count(group);
+            }
+            if (bookmarkStore.importFailed())
+            {
+                writeLog("Could not store the imported bookmarks by reference, they stay as imported; "
+                         "keep the bookmark files in " + config.bookmarksDir);
+            }
+        }
+
+        // Render the first frame now, so the hotkey only has to blit it
+        drawConsole();
 
 
         #ifdef _WIN32
@@ -2947,26 +3363,131 @@ Comment=Autostart for )" << appLabel << R"(
 
         // Listen for clipboard changes
         XFixesSelectSelectionInput(display, root, clipboardAtom, XFixesSetSelectionOwnerNotifyMask);
+        if (!clipboardOwner.init(display, window, clipboardAtom, SELECTION_TRANSFER_TIMEOUT))
+        {
+            writeLog("Could not create the clipboard owner's timer, stalled INCR readers will not be dropped");
+        }
+        clipboardWatch.selection = clipboardAtom;
+        primaryWatch.selection = XA_PRIMARY;
+        updateSelectionWatches();
+        if (!selectionRequests.init(display, window, SELECTION_TRANSFER_TIMEOUT))
+        {
+            writeLog("Could not create the selection timer, stuck transfers will hold their slot");
+        }
+#ifdef MMRY_XCB
+        if (xcbConnection.connect(DisplayString(display)))
+        {
+            selectionRequests.setConnection(xcbConnection.handle());
+        }
+        else
+        {
+            writeLog("Could not open the XCB connection, reading selections through Xlib");
+        }
+#endif
+
+        if (!ingestPipeline.start([this] { saveToFile(); }, &blobStore))
+        {
+            writeLog("Could not start the ingest pipeline, processing clips inline");
+        }
+        ingestPipeline.setSpillSize(spillSize());
+
+        if (!eventLoop.init())
+        {
+            std::cerr << "Cannot create the event loop" << std::endl;
+            running = false;
+        }
+        eventLoop.add(ConnectionNumber(display), LOOP_X);
+        eventLoop.add(ingestPipeline.readyFd(), LOOP_INGEST);
+        eventLoop.add(selectionRequests.timerFd(), LOOP_SELECTION_TIMEOUT);
+        eventLoop.add(clipboardOwner.timerFd(), LOOP_OWNER_TIMEOUT);
+#ifdef MMRY_XCB
+        if (xcbConnection.isConnected())
+        {
+            eventLoop.add(xcbConnection.fd(), LOOP_XCB);
+        }
+#endif
         
-        // --- Event loop: blocking, waits for next event -----------
+        // --- Event loop: sleeps in epoll on the X connection, the
+        // pipeline's wakeup, the selection timeouts and the debounce
+        // deadline, so all are served by this thread -----------
         while (running)
         {
+            dispatchSelectionRequests();
+#ifdef MMRY_XCB
+            pollSelectionReplies();
+#endif
+
+            if (XPending(display) == 0)
+            {
+                updateConversionDeadline();
+                uint32_t ready[8];
+                size_t count = eventLoop.wait(ready, 8);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    switch (ready[i])
+                    {
+                        case LOOP_INGEST:
+                            publishPreparedClips();
+                            break;
+                        case LOOP_SELECTION_TIMEOUT:
+                            expireSelectionRequests();
+                            break;
+                        case LOOP_OWNER_TIMEOUT:
+                            if (size_t dropped = clipboardOwner.expire())
+                            {
+                                writeLog("Dropped " + std::to_string(dropped) + " INCR transfers whose requestor stopped reading");
+                            }
+                            break;
+#ifdef MMRY_XCB
+                        case LOOP_XCB:
+                            // Replies are picked up by pollSelectionReplies() above
+                            xcbConnection.drain();
+                            break;
+#endif
+                        default:
+                            // X events, due conversions and wake() are all
+                            // handled at the top of the loop
+                            break;
+                    }
+                }
+                continue;
+            }
+
             XEvent event;
             XNextEvent(display, &event);
 
+            if (event.type == KeyPress)
+            {
+                lastUserTime = event.xkey.time;
+            }
+
+            // Requests from other clients for the clipboard we hold
+            if (clipboardOwner.handleEvent(event))
+            {
+                continue;
+            }
+
             // Handle clipboard change event
             if (event.type == xfixes_event_base + XFixesSelectionNotify)
             {
                 XFixesSelectionNotifyEvent *selection_event = (XFixesSelectionNotifyEvent*)&event;
                 if (selection_event->selection == clipboardAtom)
                 {
-                    requestClipboardContent();
+                    // Our own copies are already in the history, but they
+                    // still replace whatever owner came before
+                    scheduleSelectionRequest(clipboardWatch, selection_event->selection_timestamp,
+                                             selection_event->owner != window && selection_event->owner != None);
+                }
+                else if (selection_event->selection == XA_PRIMARY && config.primaryHistory)
+                {
+                    scheduleSelectionRequest(primaryWatch, selection_event->selection_timestamp,
+                                             selection_event->owner != None);
                 }
                 continue;
             }
 
-            // Handle clipboard content arrival
-            if (event.type == SelectionNotify)
+            // Handle clipboard content arrival, and the pieces of INCR transfers
+            if (event.type == SelectionNotify || event.type == PropertyNotify)
             {
                 handleSelectionNotify(&event);
                 continue;
@@ -2990,7 +3511,11 @@ Comment=Autostart for )" << appLabel << R"(
                 switch (event.type)
                 {
                     case Expose:
-                        drawConsole();
+                        // The back buffer is kept current, even while hidden
+                        if (event.xexpose.count == 0)
+                        {
+                            presentFrame();
+                        }
                         break;
                     case KeyPress:
                         handleKeyPress(&event);
@@ -3095,6 +3620,10 @@ Comment=Autostart for )" << appLabel << R"(
     void setRunning(bool state)
     {
         running = state;
+#ifdef __linux__
+        // May come from a signal handler while the loop sleeps
+        eventLoop.wake();
+#endif
     }
     
     void stop()
@@ -3112,10 +3641,20 @@ Comment=Autostart for )" << appLabel << R"(
             XFreeFont(display, font);
             font = nullptr;
         }
-        if (gc)
+        // Writes out a save that is still pending
+        ingestPipeline.stop();
+        selectionRequests.shutdown();
+        clipboardOwner.shutdown();
+#ifdef MMRY_XCB
+        xcbConnection.disconnect();
+#endif
+        eventLoop.shutdown();
+        shmRenderer.shutdown();
+        freeThemeGCs(display, themeGCs);
+        if (backBuffer)
         {
-            XFreeGC(display, gc);
-            gc = nullptr;
+            XFreePixmap(display, backBuffer);
+            backBuffer = 0;
         }
         if (display)
         {
@@ -3298,7 +3837,7 @@ Comment=Autostart for )" << appLabel << R"(
         else
         {
             // Scrolling for clips
-            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkClips.size() : getBookmarkItemCount();
+            size_t currentItemCount = filterBookmarkClipsMode ? filteredBookmarkIndices.size() : getBookmarkItemCount();
             
             if (selectedViewBookmarkItem < viewBookmarksScrollOffset)
             {
@@ -3448,6 +3987,30 @@ Comment=Autostart for )" << appLabel << R"(
         }
     }
     
+    void updateArchiveScrollOffset()
+    {
+        if (selectedArchiveItem < archiveScrollOffset)
+        {
+            archiveScrollOffset = selectedArchiveItem;
+        }
+        else if (selectedArchiveItem >= archiveScrollOffset + VIEW_BOOKMARKS_DIALOG_ROWS)
+        {
+            archiveScrollOffset = selectedArchiveItem - VIEW_BOOKMARKS_DIALOG_ROWS + 1;
+        }
+    }
+
+    void updatePrimaryScrollOffset()
+    {
+        if (selectedPrimaryItem < primaryScrollOffset)
+        {
+            primaryScrollOffset = selectedPrimaryItem;
+        }
+        else if (selectedPrimaryItem >= primaryScrollOffset + VIEW_BOOKMARKS_DIALOG_ROWS)
+        {
+            primaryScrollOffset = selectedPrimaryItem - VIEW_BOOKMARKS_DIALOG_ROWS + 1;
+        }
+    }
+    
     void updateAddBookmarkScrollOffset()
     {
         const int VISIBLE_ITEMS = 10; // Number of groups visible in add bookmark dialog
@@ -3546,7 +4109,7 @@ Comment=Autostart for )" << appLabel << R"(
             if (!args.empty())
             {
                 // Direct theme switch: "theme dracula"
-                config.switchTheme(args);
+                switchTheme(args);
             }
             else
             {
@@ -3559,7 +4122,7 @@ Comment=Autostart for )" << appLabel << R"(
                 {
                     config.originalTheme = config.theme;
                     selectedTheme = 0;
-                    config.switchTheme(availableThemes[0]);
+                    switchTheme(availableThemes[0]);
                 }
                 drawConsole();
             }
@@ -3588,11 +4151,34 @@ Comment=Autostart for )" << appLabel << R"(
                     
                     std::cout << "DEBUG: Parsed configKey='" << configKey << "', configValue='" << configValue << "'\n";
                     
+                    bool wasEncrypted = config.encrypted;
+                    std::string oldKey = config.encryptionKey;
                         // Validate and update config based on type
                     if (config.updateConfigValue(configKey, configValue))
                     {
+                        if ((configKey == "encrypted" || configKey == "encryption_key") &&
+                            !applyEncryption(wasEncrypted, oldKey))
+                        {
+                            std::cout << "Could not re-encrypt the stored clips, keeping the old key\n";
+                            return;
+                        }
+#ifdef __linux__
+                        if (configKey == "encrypted" && config.encrypted && !wasEncrypted)
+                        {
+                            std::cout << UNENCRYPTED_IMAGES_NOTE << "\n";
+                            writeLog(UNENCRYPTED_IMAGES_NOTE);
+                        }
+#endif
                         std::cout << "DEBUG: updateConfigValue returned true, calling saveConfig()\n";
                         config.saveConfig();
+                        applyThemeColors();
+                        updateRenderer();
+                        applyEvictionPolicy();
+                        updateSaveSettings();
+#ifdef __linux__
+                        updateSelectionWatches();
+                        ingestPipeline.setSpillSize(spillSize());
+#endif
                         std::cout << "Updated " << configKey << " = " << configValue << "\n";
                     }
                     else
@@ -3617,6 +4203,12 @@ Comment=Autostart for )" << appLabel << R"(
             return;
         }
         
+        if (cmd == "stats")
+        {
+            printStats();
+            return;
+        }
+        
         // Handle other commands (for future implementation)
         std::cout << "Command executed: " << command << "\n";
         
@@ -3628,84 +4220,155 @@ Comment=Autostart for )" << appLabel << R"(
         // - "export" - export clipboard history
     }
     
-    void loadBookmarkGroups()
+    // Hands the stores the new encryption settings, which re-encrypts what
+    // they hold under a new key. False, with the old settings back, if
+    // that could not be done.
+    bool applyEncryption(bool wasEncrypted, const std::string& oldKey)
     {
-        // Cross-platform path separator
-#ifdef _WIN32
-        const char pathSep = '\\';
-#else
-        const char pathSep = '/';
-#endif
-        
-        std::string bookmarkFile = config.bookmarksDir + pathSep + "bookmarks.txt";
-        std::ifstream file(bookmarkFile);
-        bookmarkGroups.clear();
-        
-        if (file.is_open())
+        if (contentStore.setEncryption(config.encrypted, config.encryptionKey))
         {
-            std::string line;
-            while (std::getline(file, line))
+            if (historyArchive.setEncryption(config.encrypted, config.encryptionKey))
             {
-                if (!line.empty() && line.find('|') != std::string::npos)
-                {
-                    size_t pos = line.find('|');
-                    std::string groupName = line.substr(0, pos);
-                    if (!groupName.empty())
-                    {
-                        bookmarkGroups.push_back(groupName);
-                    }
-                }
+                return true;
             }
-            file.close();
-        }
-        
-        // Always ensure we have at least one group
-        if (bookmarkGroups.empty())
-        {
-            bookmarkGroups.push_back("default");
+            contentStore.setEncryption(wasEncrypted, oldKey);
         }
+        config.encrypted = wasEncrypted;
+        config.encryptionKey = oldKey;
+        return false;
     }
+
+    void printStats()
+    {
+#ifdef __linux__
+        printSelectionStats("Clipboard", clipboardWatch);
+        if (config.primaryHistory)
+        {
+            printSelectionStats("Primary", primaryWatch);
+        }
+        std::cout << "Unmatched selection replies: " << unmatchedReplies << "\n";
+        std::cout << "Event loop wakeups: " << eventLoop.wakeups() << "\n";
+#endif
+        std::cout << "Near duplicates folded: " << nearDuplicatesFolded << "\n";
+        std::cout << "Stored clip texts: " << contentStore.size() << "\n";
+        std::cout << "Archived clips: " << historyArchive.size() << " in "
+                  << historyArchive.segmentCount() << " sealed segments\n";
+        std::cout << "Archive segments searched: " << historyArchive.segmentsSearched()
+                  << ", skipped by summary: " << historyArchive.segmentsSkipped() << "\n";
+        std::cout << "Archived clips expired: " << archivedClipsExpired << "\n";
+        printMemoryStats();
+    }
+
+#ifdef __linux__
+    void printSelectionStats(const char* name, const SelectionWatch& watch)
+    {
+        std::ostringstream stats;
+        stats << name << ": " << watch.ownerChanges << " owner changes, "
+              << watch.conversions << " conversions, "
+              << watch.coalesced << " coalesced, "
+              << watch.staleDropped << " stale dropped, "
+              << watch.timedOut << " timed out "
+              << "(debounce " << watch.debounce.count() << " ms)";
+        std::cout << stats.str() << "\n";
+        writeLog(stats.str());
+    }
+#endif
     
-    void saveBookmarkGroups()
+    void loadBookmarkGroups()
     {
-        std::string bookmarkFile = config.bookmarksDir + "/bookmarks.txt";
-        std::ofstream file(bookmarkFile);
+        bookmarkGroups = bookmarkStore.loadGroups();
         
-        if (file.is_open())
+        // Always ensure we have at least one group
+        if (bookmarkGroups.empty())
+        {
+            bookmarkGroups.push_back("default");
+        }
+    }
+    
+    bool saveBookmarkGroups()
+    {
+        return bookmarkStore.saveGroups(bookmarkGroups);
+    }
+
+    // Copies clips.txt, pinned.txt and the bookmark files into a new
+    // database in one commit. The files are left where they are.
+    bool importLegacyFiles()
+    {
+        auto readLines = [](const std::string& path)
+        {
+            RecordStore::Records lines;
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (!line.empty())
+                {
+                    lines.push_back(line);
+                }
+            }
+            return lines;
+        };
+
+        RecordStore::Transaction transaction;
+        transaction.put(HISTORY_COLLECTION, readLines(config.dataFile));
+        transaction.put(PinnedStore::COLLECTION, readLines(config.pinnedFile));
+
+        // "name|0" per group
+        RecordStore::Records groups;
+        for (const std::string& line : readLines(config.bookmarksDir + "/bookmarks.txt"))
         {
-            for (const auto& group : bookmarkGroups)
+            std::string group = line.substr(0, line.find('|'));
+            if (!group.empty())
             {
-                file << group << "|0\n"; // Group name | clip count
+                transaction.put(BookmarkStore::collectionFor(group),
+                                readLines(config.bookmarksDir + "/bookmarks_" + group + ".txt"));
+                groups.push_back(group);
             }
-            file.close();
         }
+        transaction.put(BookmarkStore::GROUPS_COLLECTION, std::move(groups));
+
+        if (!database.commit(std::move(transaction)))
+        {
+            writeLog("Could not import the clip, pin and bookmark files into " + config.databaseFile);
+            return false;
+        }
+        return true;
     }
     
     void addClipToBookmarkGroup(const std::string& groupName, const std::string& content)
     {
-        std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + groupName + ".txt";
-        std::ofstream file(bookmarkFile, std::ios::app);
-        
-        if (file.is_open())
+        if (bookmarkStore.add(groupName, content))
+        {
+            std::cout << "Added clip to bookmark group: " << groupName << "\n";
+        }
+        else
         {
-            auto timestamp = std::chrono::system_clock::now().time_since_epoch().count();
-            std::string contentToSave = encrypt(content, config);
-            file << timestamp << "|" << contentToSave << "\n";
-            file.close();
+            std::cout << "Could not save the bookmark in group: " << groupName << "\n";
         }
     }
 
-    void addClipToPinned(const std::string& content)
+    // Row of the clip list as shown: through the filter when one is active
+    const BookmarkStore::Entry* bookmarkEntryAt(size_t row)
     {
-        std::ofstream file(config.pinnedFile, std::ios::app);
-        
-        if (file.is_open())
+        if (selectedViewBookmarkGroup >= bookmarkGroups.size())
+        {
+            return nullptr;
+        }
+        const std::vector<BookmarkStore::Entry>& entries = bookmarkStore.entries(bookmarkGroups[selectedViewBookmarkGroup]);
+        if (filterBookmarkClipsMode)
         {
-            auto timestamp = std::chrono::system_clock::now().time_since_epoch().count();
-            std::string contentToSave = encrypt(content, config);
-            file << timestamp << "|" << contentToSave << "\n";
-            file.close();
+            if (row >= filteredBookmarkIndices.size())
+            {
+                return nullptr;
+            }
+            row = filteredBookmarkIndices[row];
         }
+        return row < entries.size() ? &entries[row] : nullptr;
+    }
+
+    bool addClipToPinned(const std::string& content)
+    {
+        return pinnedStore.add(content);
     }
 
     void createWindow()
@@ -3719,7 +4382,7 @@ Comment=Autostart for )" << appLabel << R"(
         
         // Set window properties
         XStoreName(display, window, "MMRY");
-        XSelectInput(display, window, ExposureMask | KeyPressMask | StructureNotifyMask);
+        XSelectInput(display, window, ExposureMask | KeyPressMask | StructureNotifyMask | PropertyChangeMask);
         
         // Set minimum window size constraints
         XSizeHints hints;
@@ -3728,20 +4391,18 @@ Comment=Autostart for )" << appLabel << R"(
         hints.min_height = MIN_WINDOW_HEIGHT;
         XSetWMNormalHints(display, window, &hints);
         
-        // Create graphics context
-        gc = XCreateGC(display, window, 0, nullptr);
-        XSetForeground(display, gc, config.textColor);
-        
         // Load font (try to find a monospace font)
         font = XLoadQueryFont(display, "-*-fixed-medium-r-*-*-13-*-*-*-*-*-*-*");
         if (!font)
         {
             font = XLoadQueryFont(display, "fixed");
         }
-        if (font)
-        {
-            XSetFont(display, gc, font->fid);
-        }
+
+        // Create one graphics context per theme colour
+        loadFontMetrics(font, fontMetrics);
+        createThemeGCs(display, window, font, themeGCs);
+        setThemeGCColors(display, themeGCs,
+                         config.backgroundColor, config.textColor, config.selectionColor, config.borderColor);
         
         // Set window to be always on top and skip taskbar
         XWMHints wmHints;
@@ -3862,6 +4523,10 @@ Comment=Autostart for )" << appLabel << R"(
         if (!visible)
         {
 #ifdef __linux__
+            // The frame is already rendered; the Expose that follows the map
+            // only has to copy it to the window
+            hotkeyTime = std::chrono::steady_clock::now();
+            awaitingFirstPaint = true;
             XMapWindow(display, window);
 #endif
 #ifdef _WIN32
@@ -3892,6 +4557,12 @@ Comment=Autostart for )" << appLabel << R"(
 #endif
             visible = false;
             std::cout << "Window hidden\n";
+
+#ifdef __linux__
+            // Whatever led to the hide (copy, filter reset) changed the list,
+            // so bring the hidden frame up to date for the next show
+            drawConsole();
+#endif
         }
     }
     
@@ -3907,15 +4578,72 @@ public:
     // Linux UI Methods
     // !@!
 #ifdef __linux__
+        // Renders into the back buffer even while the window is unmapped,
+        // and only copies it to the window when visible
         void drawConsole()
         {
-            if (!visible) return;
-            
-            // Clear window with theme background
-            XSetWindowBackground(display, window, config.backgroundColor);
-            XClearWindow(display, window);
+            renderFrame();
+            if (visible)
+            {
+                presentFrame();
+            }
+        }
+
+        void ensureBackBuffer()
+        {
+            if (backBuffer && backBufferWidth == windowWidth && backBufferHeight == windowHeight)
+            {
+                return;
+            }
+            if (backBuffer)
+            {
+                XFreePixmap(display, backBuffer);
+            }
+            backBuffer = XCreatePixmap(display, window, windowWidth, windowHeight,
+                                       DefaultDepth(display, screen));
+            backBufferWidth = windowWidth;
+            backBufferHeight = windowHeight;
+        }
+
+        void presentFrame()
+        {
+            if (!backBuffer)
+            {
+                renderFrame();
+            }
+            XCopyArea(display, backBuffer, window, themeGCs.background,
+                      0, 0, backBufferWidth, backBufferHeight, 0, 0);
+            XFlush(display);
+
+            if (awaitingFirstPaint)
+            {
+                awaitingFirstPaint = false;
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - hotkeyTime).count();
+                writeLog("Hotkey to first paint: " + std::to_string(latency / 1000.0) + " ms");
+            }
+        }
+
+        void renderFrame()
+        {
+            if (!display || !window) return;
+
+            unsigned long firstRequest = NextRequest(display);
+            unsigned long long firstAllocation = threadAllocations();
+
+            ensureBackBuffer();
+
+            // The MIT-SHM image covers the whole frame, so only the core path
+            // needs an explicit clear
+            bool useShm = shmRenderer.isActive() && shmRenderer.resize(windowWidth, windowHeight);
+            if (!useShm)
+            {
+                XFillRectangle(display, backBuffer, themeGCs.background, 0, 0, backBufferWidth, backBufferHeight);
+            }
             
-            // Build console draw data
+            // Build console draw data. Everything handed down is a view into
+            // member state or the row caches below, which keep their storage
+            // from frame to frame.
             ConsoleDrawData data;
             data.filterMode = filterMode;
             data.filterText = filterText;
@@ -3926,13 +4654,15 @@ public:
             
             if (cmd_themeSelectMode)
             {
-                data.themeItems = availableThemes;
+                data.themeItems = ItemView<std::string>(availableThemes).window(themeSelectScrollOffset, CONSOLE_SELECT_ROWS);
+                data.themeCount = availableThemes.size();
                 data.selectedTheme = selectedTheme;
                 data.themeScrollOffset = themeSelectScrollOffset;
             }
             if (cmd_configSelectMode)
             {
-                data.configItems = availableConfigs;
+                data.configItems = ItemView<std::string>(availableConfigs).window(configSelectScrollOffset, CONSOLE_SELECT_ROWS);
+                data.configCount = availableConfigs.size();
                 data.selectedConfig = selectedConfig;
                 data.configScrollOffset = configSelectScrollOffset;
             }
@@ -3967,170 +4697,109 @@ public:
                 if (maxItems < 1) maxItems = 1;
                 
                 size_t endIdx = std::min(consoleScrollOffset + maxItems, displayCount);
+                size_t rowCount = endIdx > consoleScrollOffset ? endIdx - consoleScrollOffset : 0;
+                clipRows.reserve(rowCount);
                 
-                for (size_t i = consoleScrollOffset; i < endIdx; ++i)
+                // Lines start at x = 10 and must end inside the selection bar
+                const int clipLineWidth = clipListWidth - 5;
+                
+                for (size_t row = 0; row < rowCount; ++row)
                 {
+                    size_t i = consoleScrollOffset + row;
                     size_t actualIndex = filterMode ? filteredItems[i] : i;
                     const auto& item = items[actualIndex];
                     
-                    std::string line;
-                    if (i == selectedItem)
-                    {
-                        line = "> ";
-                    }
-                    else
-                    {
-                        line = "  ";
-                    }
-                    
+                    std::tm tm {};
                     if (config.verboseMode)
                     {
                         auto time_t = std::chrono::system_clock::to_time_t(item.timestamp);
-                        auto tm = *std::localtime(&time_t);
-                        
-                        std::ostringstream timeStream;
-                        timeStream << std::put_time(&tm, "%H:%M:%S");
-                        
-                        size_t lineCount = 1;
-                        for (char c : item.content)
-                        {
-                            if (c == '\n') lineCount++;
-                        }
-                        
-                        line += timeStream.str() + " | " + std::to_string(lineCount) + " lines | ";
-                        
-                        std::string content = item.content;
-                        int maxContentLength = calculateMaxContentLength(clipListWidth, true);
-                        if (static_cast<int>(content.length()) > maxContentLength)
-                        {
-                            content = smartTrim(content, maxContentLength);
-                        }
-                        
-                        for (char& c : content)
-                        {
-                            if (c == '\n' || c == '\r') c = ' ';
-                        }
-                        
-                        line += content;
-                    }
-                    else
-                    {
-                        size_t lineCount = 1;
-                        for (char c : item.content)
-                        {
-                            if (c == '\n') lineCount++;
-                        }
-                        
-                        std::string content = item.content;
-                        int maxContentLength = calculateMaxContentLength(clipListWidth, false);
-                        if (static_cast<int>(content.length()) > maxContentLength)
-                        {
-                            content = smartTrim(content, maxContentLength);
-                        }
-                        
-                        for (char& c : content)
-                        {
-                            if (c == '\n' || c == '\r') c = ' ';
-                        }
-                        
-                        line += content;
-                        
-                        if (lineCount > 1)
-                        {
-                            line += " (" + std::to_string(lineCount) + " lines)";
-                        }
+                        tm = *std::localtime(&time_t);
                     }
-                    
-                    data.clipLines.push_back(line);
+                    clipRows.format(row, item.content, item.hash, item.isPath, i == selectedItem,
+                                    config.verboseMode ? &tm : nullptr, clipLineWidth, fontMetrics);
                 }
+                
+                data.clipLines = clipRows.rows(rowCount);
             }
             
-            ::drawConsole(display, window, gc, data);
+            if (useShm)
+            {
+                ::drawConsole(backBuffer, themeGCs, shmRenderer, data);
+            }
+            else
+            {
+                ::drawConsole(display, backBuffer, themeGCs, data);
+            }
             
             // Draw dialogs if visible
             if (bookmarkDialogVisible)
             {
                 DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 400, 300);
-                std::vector<std::string> filteredGroups;
+                dialogRows.clear();
                 for (const auto& group : bookmarkGroups)
                 {
                     if (bookmarkDialogInput.empty() || group.find(bookmarkDialogInput) != std::string::npos)
                     {
-                        filteredGroups.push_back(group);
+                        dialogRows.push_back(group);
                     }
                 }
-                drawBookmarkDialog(display, window, gc, font, dims,
-                                 bookmarkDialogInput, filteredGroups,
-                                 selectedBookmarkGroup, bookmarkMgmtScrollOffset,
-                                 config.backgroundColor, config.textColor, config.selectionColor, config.borderColor);
+                drawBookmarkDialog(display, backBuffer, themeGCs, fontMetrics, dims,
+                                 bookmarkDialogInput,
+                                 ItemView<std::string_view>(dialogRows).window(bookmarkMgmtScrollOffset, BOOKMARK_DIALOG_ROWS),
+                                 bookmarkMgmtScrollOffset, selectedBookmarkGroup);
             }
             if (addToBookmarkDialogVisible)
             {
                 DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 400, 300);
-                std::vector<std::string> displayedGroups;
-                if (filterAddBookmarksMode)
+                dialogRows.clear();
+                for (const auto& group : bookmarkGroups)
                 {
-                    std::string lowerFilterText = stringToLower(filterAddBookmarksText);
-                    for (const auto& group : bookmarkGroups)
+                    if (!filterAddBookmarksMode || containsIgnoreCase(group, filterAddBookmarksText))
                     {
-                        if (stringToLower(group).find(lowerFilterText) != std::string::npos)
-                        {
-                            displayedGroups.push_back(group);
-                        }
+                        dialogRows.push_back(group);
                     }
                 }
-                else
-                {
-                    displayedGroups = bookmarkGroups;
-                }
-                if (selectedAddBookmarkGroup >= displayedGroups.size() && !displayedGroups.empty())
+                if (selectedAddBookmarkGroup >= dialogRows.size() && !dialogRows.empty())
                 {
-                    selectedAddBookmarkGroup = displayedGroups.size() - 1;
+                    selectedAddBookmarkGroup = dialogRows.size() - 1;
                 }
 
-                drawAddToBookmarkDialog(display, window, gc, font, dims,
-                                      displayedGroups,
-                                      selectedAddBookmarkGroup, addBookmarkScrollOffset,
-                                      filterAddBookmarksMode, filterAddBookmarksText,
-                                      config.backgroundColor, config.textColor, config.selectionColor, config.borderColor);
+                drawAddToBookmarkDialog(display, backBuffer, themeGCs, fontMetrics, dims,
+                                      ItemView<std::string_view>(dialogRows).window(addBookmarkScrollOffset, ADD_TO_BOOKMARK_DIALOG_ROWS),
+                                      addBookmarkScrollOffset, selectedAddBookmarkGroup,
+                                      filterAddBookmarksMode, filterAddBookmarksText);
             }
             if (viewBookmarksDialogVisible)
             {
                 DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 600, 500);
                 std::string title;
-                std::vector<std::string> items;
                 size_t selItem = 0;
-                size_t scrollOff = 0;
+                size_t scrollOff = viewBookmarksScrollOffset;
                 bool filterActive = false;
-                std::string filterTxt;
+                std::string_view filterTxt;
                 int itemLH = 18;
-                std::string emptyMsg;
+                std::string_view emptyMsg;
+                dialogRows.clear();
                 if (viewBookmarksShowingGroups)
                 {
                     title = "Select Bookmark Group";
-                    if (filterBookmarksMode)
+                    filterActive = filterBookmarksMode;
+                    if (filterActive)
                     {
-                        std::string lowerFilter = stringToLower(filterBookmarksText);
-                        for (const auto& group : bookmarkGroups)
-                        {
-                            if (stringToLower(group).find(lowerFilter) != std::string::npos)
-                            {
-                                items.push_back(group);
-                            }
-                        }
-                        filterActive = true;
                         filterTxt = filterBookmarksText;
                     }
-                    else
+                    for (const auto& group : bookmarkGroups)
                     {
-                        items = bookmarkGroups;
+                        if (!filterActive || containsIgnoreCase(group, filterBookmarksText))
+                        {
+                            dialogRows.push_back(group);
+                        }
                     }
-                    if (selectedViewBookmarkGroup >= items.size() && !items.empty())
+                    if (selectedViewBookmarkGroup >= dialogRows.size() && !dialogRows.empty())
                     {
-                        selectedViewBookmarkGroup = items.size() - 1;
+                        selectedViewBookmarkGroup = dialogRows.size() - 1;
                     }
                     selItem = selectedViewBookmarkGroup;
-                    scrollOff = viewBookmarksScrollOffset;
                 }
                 else
                 {
@@ -4142,138 +4811,242 @@ public:
                     {
                         title = "View Bookmarks";
                     }
+                    
+                    // Only the rows on screen are copied out, flattened and trimmed
+                    size_t totalItems = 0;
+                    size_t rowCount = 0;
+                    auto addRow = [&](const std::string& content)
+                    {
+                        if (totalItems >= scrollOff && rowCount < VIEW_BOOKMARKS_DIALOG_ROWS)
+                        {
+                            if (bookmarkRowCache.size() <= rowCount)
+                            {
+                                bookmarkRowCache.emplace_back();
+                            }
+                            bookmarkRowCache[rowCount++] = content;
+                        }
+                        totalItems++;
+                    };
+                    
                     if (filterBookmarkClipsMode)
                     {
-                        items = filteredBookmarkClips;
+                        for (size_t row = 0; row < filteredBookmarkIndices.size(); ++row)
+                        {
+                            addRow(bookmarkEntryAt(row)->content);
+                        }
                         filterActive = true;
                         filterTxt = filterBookmarkClipsText;
                     }
-                    else
+                    else if (selectedViewBookmarkGroup < bookmarkGroups.size())
                     {
-                        if (selectedViewBookmarkGroup < bookmarkGroups.size())
+                        for (const BookmarkStore::Entry& entry : bookmarkStore.entries(bookmarkGroups[selectedViewBookmarkGroup]))
                         {
-                            std::string selectedGroup = bookmarkGroups[selectedViewBookmarkGroup];
-                            std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-                            std::ifstream file(bookmarkFile);
-                            if (file.is_open())
-                            {
-                                std::string line;
-                                while (std::getline(file, line))
-                                {
-                                    size_t pos = line.find('|');
-                                    if (pos != std::string::npos && pos > 0)
-                                    {
-                                        std::string content = line.substr(pos + 1);
-                                        try
-                                        {
-                                            items.push_back(decrypt(content, config));
-                                        }
-                                        catch (...)
-                                        {
-                                            items.push_back(content);
-                                        }
-                                    }
-                                }
-                                file.close();
-                            }
+                            addRow(entry.content);
                         }
                     }
-                    int maxContentLength = calculateDialogContentLength(dims);
-                    for (auto& item : items)
+                    
+                    // Items start at x + 20 behind a "> " marker and must end
+                    // inside the selection bar
+                    int maxContentWidth = dims.width - 35 - fontMetrics.textWidth("> ");
+                    for (size_t row = 0; row < rowCount; ++row)
                     {
-                        if (static_cast<int>(item.length()) > maxContentLength)
-                        {
-                            item = smartTrim(item, maxContentLength);
-                        }
+                        std::string& item = bookmarkRowCache[row];
                         for (char& c : item)
                         {
                             if (c == '\n' || c == '\r') c = ' ';
                         }
+                        if (fontMetrics.textWidth(item) > maxContentWidth)
+                        {
+                            item = smartTrimToWidth(item, maxContentWidth, fontMetrics);
+                        }
+                        dialogRows.push_back(item);
                     }
-                    if (selectedViewBookmarkItem >= items.size() && !items.empty())
+                    if (selectedViewBookmarkItem >= totalItems && totalItems > 0)
                     {
-                        selectedViewBookmarkItem = items.size() - 1;
+                        selectedViewBookmarkItem = totalItems - 1;
                     }
                     selItem = selectedViewBookmarkItem;
-                    scrollOff = viewBookmarksScrollOffset;
                     itemLH = LINE_HEIGHT;
                     emptyMsg = "No bookmarks in this group";
                 }
 
-                drawViewBookmarksDialog(display, window, gc, font, dims,
-                                      title, items, selItem, scrollOff,
-                                      filterActive, filterTxt, itemLH, emptyMsg,
-                                      config.backgroundColor, config.textColor, config.selectionColor, config.borderColor);
+                // The group list is still whole; the clip rows are already the window
+                ItemView<std::string_view> rows(dialogRows);
+                size_t firstRow = scrollOff;
+                if (viewBookmarksShowingGroups)
+                {
+                    rows = rows.window(scrollOff, VIEW_BOOKMARKS_DIALOG_ROWS);
+                }
+                drawViewBookmarksDialog(display, backBuffer, themeGCs, fontMetrics, dims,
+                                      title, rows, firstRow, selItem,
+                                      filterActive, filterTxt, itemLH, emptyMsg);
             }
             if (pinnedDialogVisible)
             {
-                auto sortedItems = getSortedPinnedItems(config.pinnedFile);
-                std::vector<std::pair<long long, std::string>> displayItems;
-                for (const auto& line : sortedItems)
-                {
-                    size_t pos = line.find('|');
-                    if (pos != std::string::npos && pos > 0)
-                    {
-                        std::string timestampStr = line.substr(0, pos);
-                        std::string content = line.substr(pos + 1);
-                        try
-                        {
-                            std::string decryptedContent = decrypt(content, config);
-                            long long timestamp = std::stoll(timestampStr);
-                            displayItems.push_back({timestamp, decryptedContent});
-                        }
-                        catch (...)
-                        {
-                            try
-                            {
-                                long long timestamp = std::stoll(timestampStr);
-                                displayItems.push_back({timestamp, content});
-                            }
-                            catch (...)
-                            {
-                                long long timestamp = std::chrono::system_clock::now().time_since_epoch().count();
-                                displayItems.push_back({timestamp, content});
-                            }
-                        }
-                    }
-                }
-                int numItems = displayItems.empty() ? 1 : displayItems.size();
+                size_t totalItems = pinnedStore.size();
+                int numItems = totalItems == 0 ? 1 : totalItems;
                 int preferredHeight = (numItems * LINE_HEIGHT) + 80;
                 DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, windowWidth - 40, preferredHeight);
-                int maxContentLength = calculateDialogContentLength(dims);
-                for (auto& entry : displayItems)
+                m_maxVisiblePinnedItems = std::max(1, dims.contentHeight / LINE_HEIGHT);
+                
+                // Flatten and trim only the rows on screen
+                // Same layout as the bookmark items: x + 20, "> " marker
+                int maxContentWidth = dims.width - 35 - fontMetrics.textWidth("> ");
+                size_t rowCount = 0;
+                for (size_t index = viewPinnedScrollOffset;
+                     index < totalItems && rowCount < static_cast<size_t>(m_maxVisiblePinnedItems); ++index)
                 {
-                    if (static_cast<int>(entry.second.length()) > maxContentLength)
+                    if (pinnedRowCache.size() <= rowCount)
                     {
-                        entry.second = smartTrim(entry.second, maxContentLength);
+                        pinnedRowCache.emplace_back();
                     }
+                    auto& entry = pinnedRowCache[rowCount++];
+                    entry.first = pinnedStore.at(index).timestamp;
+                    entry.second = pinnedStore.at(index).content;
                     for (char& c : entry.second)
                     {
                         if (c == '\n' || c == '\r') c = ' ';
                     }
+                    if (fontMetrics.textWidth(entry.second) > maxContentWidth)
+                    {
+                        entry.second = smartTrimToWidth(entry.second, maxContentWidth, fontMetrics);
+                    }
                 }
 
-                drawPinnedDialog(display, window, gc, font, displayItems, dims,
-                                 selectedViewPinnedItem, viewPinnedScrollOffset, m_maxVisiblePinnedItems,
-                                 config.backgroundColor, config.textColor, config.selectionColor, config.borderColor, LINE_HEIGHT);
+                drawPinnedDialog(display, backBuffer, themeGCs, fontMetrics, dims,
+                                 ItemView<std::pair<long long, std::string>>(pinnedRowCache.data(), rowCount),
+                                 viewPinnedScrollOffset, selectedViewPinnedItem,
+                                 LINE_HEIGHT);
+            }
+            if (primaryDialogVisible)
+            {
+                DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 600, 500);
+                if (selectedPrimaryItem >= primaryHistory.size() && !primaryHistory.empty())
+                {
+                    selectedPrimaryItem = primaryHistory.size() - 1;
+                }
+
+                // Flatten and trim only the rows on screen
+                int maxContentWidth = dims.width - 35 - fontMetrics.textWidth("> ");
+                size_t rowCount = 0;
+                for (size_t i = primaryScrollOffset; i < primaryHistory.size() && rowCount < VIEW_BOOKMARKS_DIALOG_ROWS; ++i)
+                {
+                    if (bookmarkRowCache.size() <= rowCount)
+                    {
+                        bookmarkRowCache.emplace_back();
+                    }
+                    std::string& item = bookmarkRowCache[rowCount++];
+                    item = primaryHistory.at(i);
+                    for (char& c : item)
+                    {
+                        if (c == '\n' || c == '\r') c = ' ';
+                    }
+                    if (fontMetrics.textWidth(item) > maxContentWidth)
+                    {
+                        item = smartTrimToWidth(item, maxContentWidth, fontMetrics);
+                    }
+                }
+                dialogRows.assign(bookmarkRowCache.begin(), bookmarkRowCache.begin() + rowCount);
+
+                drawViewBookmarksDialog(display, backBuffer, themeGCs, fontMetrics, dims,
+                                      "Primary Selections", ItemView<std::string_view>(dialogRows),
+                                      primaryScrollOffset, selectedPrimaryItem,
+                                      false, std::string_view(), LINE_HEIGHT,
+                                      "No primary selections captured");
+            }
+            if (archiveDialogVisible)
+            {
+                DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 600, 500);
+                size_t totalRows = archiveRowCount();
+                if (selectedArchiveItem >= totalRows && totalRows > 0)
+                {
+                    selectedArchiveItem = totalRows - 1;
+                }
+
+                // Only the rows on screen are read, a segment at a time
+                int maxContentWidth = dims.width - 35 - fontMetrics.textWidth("> ");
+                size_t rowCount = 0;
+                HistoryArchive::Clip clip;
+                for (size_t i = archiveScrollOffset; i < totalRows && rowCount < VIEW_BOOKMARKS_DIALOG_ROWS; ++i)
+                {
+                    if (bookmarkRowCache.size() <= rowCount)
+                    {
+                        bookmarkRowCache.emplace_back();
+                    }
+                    std::string& item = bookmarkRowCache[rowCount++];
+                    item = historyArchive.at(archiveSearched ? archiveMatches[i] : i, clip) ? clip.content : "[unreadable]";
+                    for (char& c : item)
+                    {
+                        if (c == '\n' || c == '\r') c = ' ';
+                    }
+                    if (fontMetrics.textWidth(item) > maxContentWidth)
+                    {
+                        item = smartTrimToWidth(item, maxContentWidth, fontMetrics);
+                    }
+                }
+                dialogRows.assign(bookmarkRowCache.begin(), bookmarkRowCache.begin() + rowCount);
+
+                drawViewBookmarksDialog(display, backBuffer, themeGCs, fontMetrics, dims,
+                                      "Archive", ItemView<std::string_view>(dialogRows),
+                                      archiveScrollOffset, selectedArchiveItem,
+                                      archiveFilterMode, archiveFilterText, LINE_HEIGHT,
+                                      archiveSearched ? "No archived clip matches" : "No clips archived");
             }
             if (helpDialogVisible)
             {
                 DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 600, 500);
 
-                drawHelpDialog(display, window, gc, dims,
-                               helpFilterMode, helpFilterText, helpDialogScrollOffset,
-                               config.backgroundColor, config.textColor, config.borderColor);
+                drawHelpDialog(display, backBuffer, themeGCs, dims,
+                               helpFilterMode, helpFilterText, helpDialogScrollOffset);
             }
             if (editDialogVisible)
             {
                 DialogDimensions dims = calculateDialogDimensions(windowWidth, windowHeight, 600, 400);
 
-                drawEditDialog(display, window, gc, font, dims,
+                drawEditDialog(display, backBuffer, themeGCs, fontMetrics, dims,
                                editDialogInput, editDialogCursorLine, editDialogCursorPos,
-                               editDialogScrollOffset,
-                               config.backgroundColor, config.textColor, config.borderColor);
+                               editDialogScrollOffset);
+            }
+
+            logFrameRequests(NextRequest(display) - firstRequest, threadAllocations() - firstAllocation);
+        }
+
+        // Instrumentation hook: how many X requests rendering frames cost,
+        // and with MMRY_COUNT_ALLOCATIONS how many heap allocations, summed
+        // and reported once per FRAME_REPORT_INTERVAL frames rather than one
+        // log line per frame
+        void logFrameRequests(unsigned long requestCount, unsigned long long allocations)
+        {
+            static const unsigned long FRAME_REPORT_INTERVAL = 256;
+            frameCount++;
+            frameRequests += requestCount;
+            peakFrameRequests = std::max<unsigned long long>(peakFrameRequests, requestCount);
+            frameAllocations += allocations;
+            if (allocations)
+            {
+                allocatingFrames++;
+            }
+            if (frameCount < FRAME_REPORT_INTERVAL)
+            {
+                return;
             }
+            std::string report = "drawConsole: " + std::to_string(frameCount) + " frames issued " +
+                                 std::to_string(frameRequests) + " X requests, " +
+                                 std::to_string(frameRequests / frameCount) + " a frame, at most " +
+                                 std::to_string(peakFrameRequests);
+#ifdef MMRY_COUNT_ALLOCATIONS
+            // Rows are cached between frames, so once their caches have grown
+            // to fit, redrawing should not allocate; only clips wide enough
+            // to need an ellipsis are expected to
+            report += "; " + std::to_string(allocatingFrames) + " of them allocated, " +
+                      std::to_string(frameAllocations) + " allocations in all";
+#endif
+            writeLog(report);
+            frameCount = 0;
+            frameRequests = 0;
+            peakFrameRequests = 0;
+            frameAllocations = 0;
+            allocatingFrames = 0;
         }
 #endif
     // End Linux UI Methods
@@ -4309,6 +5082,7 @@ public:
             SetBkMode(hdc, TRANSPARENT);
             
             // Build console draw data
+            std::vector<std::string> clipLines;
             ConsoleDrawData data;
             data.filterMode = filterMode;
             data.filterText = filterText;
@@ -4319,13 +5093,15 @@ public:
             
             if (cmd_themeSelectMode)
             {
-                data.themeItems = availableThemes;
+                data.themeItems = ItemView<std::string>(availableThemes).window(themeSelectScrollOffset, CONSOLE_SELECT_ROWS);
+                data.themeCount = availableThemes.size();
                 data.selectedTheme = selectedTheme;
                 data.themeScrollOffset = themeSelectScrollOffset;
             }
             if (cmd_configSelectMode)
             {
-                data.configItems = availableConfigs;
+                data.configItems = ItemView<std::string>(availableConfigs).window(configSelectScrollOffset, CONSOLE_SELECT_ROWS);
+                data.configCount = availableConfigs.size();
                 data.selectedConfig = selectedConfig;
                 data.configScrollOffset = configSelectScrollOffset;
             }
@@ -4434,8 +5210,9 @@ public:
                         }
                     }
                     
-                    data.clipLines.push_back(line);
+                    clipLines.push_back(line);
                 }
+                data.clipLines = clipLines;
             }
             
             ::drawConsole(hdc, data, WIN_SEL_RECT_HEIGHT, WIN_SEL_RECT_OFFSET_Y);
@@ -4542,7 +5319,10 @@ public:
                     }
                     if (filterBookmarkClipsMode)
                     {
-                        items = filteredBookmarkClips;
+                        for (size_t row = 0; row < filteredBookmarkIndices.size(); ++row)
+                        {
+                            items.push_back(bookmarkEntryAt(row)->content);
+                        }
                         filterActive = true;
                         filterTxt = filterBookmarkClipsText;
                     }
@@ -4550,29 +5330,9 @@ public:
                     {
                         if (selectedViewBookmarkGroup < bookmarkGroups.size())
                         {
-                            std::string selectedGroup = bookmarkGroups[selectedViewBookmarkGroup];
-                            std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-                            std::ifstream file(bookmarkFile);
-                            if (file.is_open())
+                            for (const BookmarkStore::Entry& entry : bookmarkStore.entries(bookmarkGroups[selectedViewBookmarkGroup]))
                             {
-                                std::string line;
-                                while (std::getline(file, line))
-                                {
-                                    size_t pos = line.find('|');
-                                    if (pos != std::string::npos && pos > 0)
-                                    {
-                                        std::string content = line.substr(pos + 1);
-                                        try
-                                        {
-                                            items.push_back(decrypt(content, config));
-                                        }
-                                        catch (...)
-                                        {
-                                            items.push_back(content);
-                                        }
-                                    }
-                                }
-                                file.close();
+                                items.push_back(entry.content);
                             }
                         }
                     }
@@ -4606,35 +5366,10 @@ public:
 
             if (pinnedDialogVisible)
             {
-                auto sortedItems = getSortedPinnedItems(config.pinnedFile);
                 std::vector<std::pair<long long, std::string>> displayItems;
-                for (const auto& line : sortedItems)
+                for (size_t index = 0; index < pinnedStore.size(); ++index)
                 {
-                    size_t pos = line.find('|');
-                    if (pos != std::string::npos && pos > 0)
-                    {
-                        std::string timestampStr = line.substr(0, pos);
-                        std::string content = line.substr(pos + 1);
-                        try
-                        {
-                            std::string decryptedContent = decrypt(content, config);
-                            long long timestamp = std::stoll(timestampStr);
-                            displayItems.push_back({timestamp, decryptedContent});
-                        }
-                        catch (...)
-                        {
-                            try
-                            {
-                                long long timestamp = std::stoll(timestampStr);
-                                displayItems.push_back({timestamp, content});
-                            }
-                            catch (...)
-                            {
-                                long long timestamp = std::chrono::system_clock::now().time_since_epoch().count();
-                                displayItems.push_back({timestamp, content});
-                            }
-                        }
-                    }
+                    displayItems.push_back({pinnedStore.at(index).timestamp, pinnedStore.at(index).content});
                 }
                 int numItems = displayItems.empty() ? 1 : displayItems.size();
                 int preferredHeight = (numItems * LINE_HEIGHT) + 80;
@@ -4699,142 +5434,666 @@ public:
 
     
 #ifdef __linux__
-    void requestClipboardContent()
+    // Starts or stops following PRIMARY to match primary_history
+    void updateSelectionWatches()
     {
-        // Request clipboard content as UTF8_STRING
-        XConvertSelection(display, clipboardAtom, utf8Atom, clipboardAtom, window, CurrentTime);
+        clipboardWatch.debounce = std::chrono::milliseconds(config.clipboardDebounceMs);
+        clipboardWatch.maxTextSize = config.maxClipSize;
+        clipboardWatch.negotiateTargets = true;
+
+        primaryWatch.debounce = std::max(PRIMARY_DEBOUNCE, clipboardWatch.debounce);
+        primaryWatch.maxTextSize = PRIMARY_MAX_BYTES;
+        XFixesSelectSelectionInput(display, root, XA_PRIMARY,
+                                   config.primaryHistory ? XFixesSetSelectionOwnerNotifyMask : 0);
+        if (!config.primaryHistory)
+        {
+            primaryWatch.conversionPending = false;
+        }
+    }
+
+    // Notes a new owner; the conversion waits out the debounce window,
+    // which every further change in the burst restarts
+    void scheduleSelectionRequest(SelectionWatch& watch, Time ownerTime, bool convert)
+    {
+        watch.ownerGeneration++;
+        watch.ownerChanges++;
+        if (watch.conversionPending)
+        {
+            watch.coalesced++;
+        }
+
+        watch.conversionPending = convert;
+        watch.pendingOwnerTime = ownerTime;
+        watch.conversionDue = std::chrono::steady_clock::now() + watch.debounce;
+    }
+
+    // Arms the loop's deadline for the earliest scheduled conversion. With
+    // every request slot taken it waits for a reply or a timeout instead.
+    void updateConversionDeadline()
+    {
+        bool any = false;
+        std::chrono::steady_clock::time_point earliest;
+        if (!selectionRequests.full())
+        {
+            for (const SelectionWatch* watch : { &clipboardWatch, &primaryWatch })
+            {
+                if (watch->conversionPending && (!any || watch->conversionDue < earliest))
+                {
+                    earliest = watch->conversionDue;
+                    any = true;
+                }
+            }
+        }
+        if (any)
+        {
+            eventLoop.setDeadline(earliest);
+        }
+        else
+        {
+            eventLoop.clearDeadline();
+        }
+    }
+
+    void dispatchSelectionRequest(SelectionWatch& watch)
+    {
+        if (!watch.conversionPending || std::chrono::steady_clock::now() < watch.conversionDue)
+        {
+            return;
+        }
+
+        // Request the content (or the list of targets) for the ownership
+        // we were told about. Older transfers may still be running; they
+        // have their own property and are dropped as stale when they end.
+        Atom target = watch.negotiateTargets ? targetsAtom : utf8Atom;
+        if (!selectionRequests.start(watch.selection, watch.pendingOwnerTime, watch.ownerGeneration,
+                                     target, maxTransferSize(watch, target)))
+        {
+            // Every slot is busy; try again when one frees up
+            return;
+        }
+        watch.conversionPending = false;
+        watch.conversions++;
+    }
+
+    void dispatchSelectionRequests()
+    {
+        dispatchSelectionRequest(clipboardWatch);
+        dispatchSelectionRequest(primaryWatch);
+    }
+
+    size_t maxTransferSize(const SelectionWatch& watch, Atom target) const
+    {
+        return target == pngAtom ? MAX_BLOB_SIZE : watch.maxTextSize;
+    }
+
+    SelectionWatch* watchFor(Atom selection)
+    {
+        if (selection == clipboardWatch.selection) return &clipboardWatch;
+        if (selection == primaryWatch.selection) return &primaryWatch;
+        return nullptr;
+    }
+
+    void expireSelectionRequests()
+    {
+        selectionRequests.expire([this](SelectionRequests::Request& request)
+        {
+            if (SelectionWatch* watch = watchFor(request.selection))
+            {
+                watch->timedOut++;
+            }
+            writeLog("Selection owner did not answer, giving up on its transfer");
+        });
+    }
+
+    // Text is preferred whenever the owner offers it; an image is only taken
+    // from owners that have nothing else
+    Atom chooseSelectionTarget(const SelectionWatch& watch, const std::string& targetList) const
+    {
+        const long* targets = reinterpret_cast<const long*>(targetList.data());
+        size_t count = targetList.size() / sizeof(long);
+        bool hasUtf8 = false;
+        bool hasString = false;
+        bool hasPng = false;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Atom target = static_cast<Atom>(targets[i]);
+            hasUtf8 |= target == utf8Atom;
+            hasString |= target == XA_STRING;
+            hasPng |= target == pngAtom;
+        }
+        if (hasUtf8) return utf8Atom;
+        if (hasString) return XA_STRING;
+        if (hasPng && &watch == &clipboardWatch) return pngAtom;
+        return None;
     }
-#endif
 
-#ifdef __linux__
     void handleSelectionNotify(XEvent* event)
     {
-        if (event->xselection.property == None)
+        SelectionRequests::Request* request = selectionRequests.match(*event);
+        if (!request)
+        {
+            if (event->type == SelectionNotify)
+            {
+                unmatchedReplies++;
+            }
+            return;
+        }
+        SelectionWatch* watch = watchFor(request->selection);
+        if (watch)
+        {
+            SelectionReader::Result result = request->reader.handleEvent(*event);
+            if (result == SelectionReader::Result::Pending)
+            {
+                // Another INCR piece came in, so the owner is still sending.
+                // Polled replies that are not in yet are no such sign.
+                selectionRequests.extend(*request);
+            }
+            handleSelectionTransfer(*watch, *request, result);
+        }
+    }
+
+#ifdef MMRY_XCB
+    // Finishes the reads whose GetProperty replies have come in
+    void pollSelectionReplies()
+    {
+        selectionRequests.forEachActive([this](SelectionRequests::Request& request) {
+            if (!request.reader.awaitingReplies())
+            {
+                return;
+            }
+            SelectionReader::Result result = request.reader.pollReplies();
+            SelectionWatch* watch = watchFor(request.selection);
+            if (watch)
+            {
+                handleSelectionTransfer(*watch, request, result);
+            }
+        });
+    }
+#endif
+
+    void handleSelectionTransfer(SelectionWatch& watch, SelectionRequests::Request& request, SelectionReader::Result result)
+    {
+        SelectionReader& reader = request.reader;
+        switch (result)
+        {
+            case SelectionReader::Result::Ignored:
+            case SelectionReader::Result::Pending:
+                return;
+
+            case SelectionReader::Result::Failed:
+                if (request.generation == watch.ownerGeneration)
+                {
+                    // Owners without TARGETS get the old guess; if UTF8_STRING
+                    // is not available, try plain STRING
+                    if (reader.target() == targetsAtom)
+                    {
+                        selectionRequests.retarget(request, utf8Atom, maxTransferSize(watch, utf8Atom));
+                        return;
+                    }
+                    if (reader.target() == utf8Atom)
+                    {
+                        selectionRequests.retarget(request, XA_STRING, maxTransferSize(watch, XA_STRING));
+                        return;
+                    }
+                }
+                selectionRequests.finish(request);
+                return;
+
+            case SelectionReader::Result::Complete:
+                break;
+        }
+
+        if (request.generation != watch.ownerGeneration)
+        {
+            // A newer owner is already scheduled or in flight
+            watch.staleDropped++;
+            selectionRequests.finish(request);
+            return;
+        }
+
+        if (reader.target() == targetsAtom)
         {
-            // If UTF8_STRING is not available, try plain TEXT
-            XConvertSelection(display, clipboardAtom, XA_STRING, clipboardAtom, window, CurrentTime);
+            Atom target = chooseSelectionTarget(watch, reader.content());
+            if (target != None)
+            {
+                selectionRequests.retarget(request, target, maxTransferSize(watch, target));
+                return;
+            }
+            selectionRequests.finish(request);
+            return;
+        }
+
+        // The slot is free again once the data is out of the reader
+        Atom target = reader.target();
+        bool truncated = reader.truncated();
+        size_t totalSize = reader.totalSize();
+        std::string raw = reader.takeContent();
+        selectionRequests.finish(request);
+
+        if (target == pngAtom)
+        {
+            if (truncated)
+            {
+                writeLog("Image of " + std::to_string(totalSize) + " bytes is too large to keep");
+                return;
+            }
+            if (!ingestPipeline.isRunning() || !ingestPipeline.submit(std::move(raw), "image/png"))
+            {
+                processBlobContent(raw, "image/png");
+            }
             return;
         }
 
-        Atom target = event->xselection.target;
         if (target != utf8Atom && target != XA_STRING)
         {
             // We are not interested in other formats
             return;
         }
 
-        Atom type;
-        int format;
-        unsigned long nitems, bytes_after;
-        unsigned char* data = nullptr;
+        if (&watch == &primaryWatch)
+        {
+            addPrimarySelection(std::move(raw), truncated);
+            return;
+        }
 
-        XGetWindowProperty(display, window, clipboardAtom, 0, LONG_MAX, False, AnyPropertyType,
-                           &type, &format, &nitems, &bytes_after, &data);
+        if (truncated)
+        {
+            writeLog("Clip of " + std::to_string(totalSize) + " bytes exceeds max_clip_size, storing truncated");
+        }
+        // The raw buffer moves to the worker; only the prepared clip comes
+        // back to this thread
+        if (!ingestPipeline.isRunning() || !ingestPipeline.submit(std::move(raw)))
+        {
+            processClipboardContent(raw);
+        }
+    }
 
-        if (data)
+    void addPrimarySelection(std::string&& text, bool truncated)
+    {
+        // A selection past the cap is not worth keeping as a prefix
+        if (truncated)
+        {
+            return;
+        }
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
         {
-            std::string content(reinterpret_cast<char*>(data), nitems);
-            XFree(data);
-            processClipboardContent(content);
+            text.pop_back();
+        }
+        if (text.size() < config.primaryMinLength)
+        {
+            return;
+        }
+        if (primaryHistory.add(std::move(text)) && primaryDialogVisible)
+        {
+            drawConsole();
         }
     }
 #endif
 
     void processClipboardContent(const std::string& content)
     {
-        // Trim trailing newlines
-        std::string trimmed_content = content;
-        while (!trimmed_content.empty() && (trimmed_content.back() == '\n' || trimmed_content.back() == '\r'))
+        PreparedClip clip;
+        if (!prepareClip(content, clip))
+        {
+            return;
+        }
+#ifdef __linux__
+        // As the ingest worker would have
+        if (spillSize() && clip.content.size() >= spillSize())
+        {
+            std::string key = blobStore.put(clip.content);
+            if (!key.empty())
+            {
+                spillClip(key, clip);
+            }
+        }
+#endif
+        if (publishClip(std::move(clip)))
         {
-            trimmed_content.pop_back();
+            // Refresh the frame; while hidden this keeps the back buffer current
+            drawConsole();
         }
+    }
 
-        if (trimmed_content.empty() || trimmed_content == lastClipboardContent)
+#ifdef __linux__
+    void processBlobContent(const std::string& data, const std::string& mimeType)
+    {
+        std::string key = blobStore.put(data);
+        if (key.empty())
         {
+            writeLog("Could not store a " + mimeType + " clip in the blob store");
             return;
         }
+        PreparedClip clip;
+        prepareBlobClip(mimeType, data.size(), key, clip);
+        if (publishClip(std::move(clip)))
+        {
+            drawConsole();
+        }
+    }
+
+    void publishPreparedClips()
+    {
+        bool changed = false;
+        ingestPipeline.collect([this, &changed](PreparedClip&& clip)
+        {
+            changed |= publishClip(std::move(clip));
+        });
+        if (changed)
+        {
+            // Refresh the frame; while hidden this keeps the back buffer current
+            drawConsole();
+        }
+    }
+#endif
 
-        lastClipboardContent = trimmed_content;
+    // Puts a prepared clip at the top of the history, moving an existing
+    // copy up rather than storing it twice. False if nothing changed.
+    bool publishClip(PreparedClip&& clip)
+    {
+        if (clip.hash == lastClipboardHash && clip.content == lastClipboardContent)
+        {
+            return false;
+        }
+        lastClipboardContent = clip.content;
+        lastClipboardHash = clip.hash;
 
-        // The rest of the logic from checkClipboard
-        size_t duplicateIndex = 0;
-        
-        // Check for duplicates and move to top if found
-        bool isDuplicate = false;
+        // Compare hashes first; only a match needs the full content compare.
+        // A copy differing only in whitespace is found by its fingerprint
+        // in the same pass, when near_duplicates asks for it.
+        bool foldNear = config.nearDuplicates != "off" && clip.fingerprint != 0;
+        size_t duplicateIndex = items.size();
+        size_t nearIndex = items.size();
         for (size_t i = 0; i < items.size(); i++)
         {
-            if (items[i].content == trimmed_content)
+            if (items[i].hash == clip.hash && items[i].content == clip.content)
             {
-                isDuplicate = true;
                 duplicateIndex = i;
                 break;
             }
+            if (foldNear && nearIndex == items.size() && items[i].fingerprint == clip.fingerprint && !items[i].isBlob())
+            {
+                nearIndex = i;
+            }
         }
-      
-        if (isDuplicate)
+
+        if (duplicateIndex < items.size())
         {
             // Move existing clip to top
-            std::string clipContent = items[duplicateIndex].content;
-            items.erase(items.begin() + duplicateIndex);
-            items.emplace(items.begin(), clipContent);
+            moveItemToTop(duplicateIndex, [&clip](ClipboardItem& item)
+            {
+                item.timestamp = clip.timestamp;
+            });
+            std::cout << "Existing clip moved to top\n";
+        }
+        else if (nearIndex < items.size())
+        {
+            moveItemToTop(nearIndex, [this, &clip](ClipboardItem& item)
+            {
+                if (config.nearDuplicates == "newest")
+                {
+                    item = ClipboardItem(std::move(clip));
+                }
+                else
+                {
+                    item.timestamp = clip.timestamp;
+                }
+            });
+            nearDuplicatesFolded++;
+            std::cout << "Near-duplicate clip moved to top\n";
+        }
+        else
+        {
+            insertItem(0, ClipboardItem(std::move(clip)));
+            evictClips();
+            std::cout << "New clipboard item added\n";
+        }
 
-            // Reset selection to top when item is moved
-            selectedItem = 0;
+        // Reset selection to top when the history changes
+        selectedItem = 0;
 
-            // Update filtered items if in filter mode
-            if (filterMode)
+        // Update filtered items if in filter mode
+        if (filterMode)
+        {
+            updateFilteredItems();
+        }
+
+        requestSave();
+        return true;
+    }
+
+    // Keeps a clip leaving the history for the archive, when that is on.
+    // The next save archives it, as adding may seal a segment and sync.
+    void archiveItem(const ClipboardItem& item)
+    {
+        if (config.archiveHistory && !item.isBlob())
+        {
+            std::lock_guard<std::mutex> lock(archiveQueueMutex);
+            archiveQueue.push_back(HistoryArchive::Clip {
+                std::chrono::duration_cast<std::chrono::seconds>(item.timestamp.time_since_epoch()).count(),
+                item.content });
+        }
+    }
+
+    // Runs on the ingest worker, before the history is saved without them
+    void archiveQueuedClips()
+    {
+        std::vector<HistoryArchive::Clip> clips;
+        {
+            std::lock_guard<std::mutex> lock(archiveQueueMutex);
+            clips.swap(archiveQueue);
+        }
+        for (const HistoryArchive::Clip& clip : clips)
+        {
+            historyArchive.add(clip.timestamp, clip.content);
+        }
+    }
+
+    // Clips from here on are spilled, or 0. Blob files are not encrypted
+    // (see UNENCRYPTED_IMAGES_NOTE), so with encryption on nothing is
+    // spilled and only eviction applies.
+    size_t spillSize() const
+    {
+        return config.maxMemoryBytes && !config.encrypted ? config.spillMinSize : 0;
+    }
+
+    // The whole text of a clip, read back from the blob store when spilled
+    std::string clipText(const ClipboardItem& item) const
+    {
+#ifdef __linux__
+        if (item.isSpilled())
+        {
+            BlobMapping text = blobStore.map(item.blobKey);
+            if (text.valid())
             {
-                updateFilteredItems();
+                return std::string(text.data(), text.size());
             }
+            writeLog("clipText: spilled clip " + item.blobKey + " is missing");
+        }
+#endif
+        return item.content;
+    }
 
-            saveToFile();
+    static size_t residentBytes(const ClipboardItem& item)
+    {
+        return item.content.size() + item.lowercase_content.size();
+    }
 
-            std::cout << "Existing clip moved to top\n";
+    void applyEvictionPolicy()
+    {
+        EvictionPolicy::Kind kind;
+        if (EvictionPolicy::parse(config.evictionPolicy, kind))
+        {
+            evictionPolicy.setKind(kind);
+        }
+    }
 
-            // Refresh display if window is visible
-            if (visible)
+    // Drops the clips eviction_policy picks until the history is within
+    // max_clips and max_memory_bytes; spilling has already made the large
+    // clips small. The newest clip always stays.
+    void evictClips()
+    {
+        while (items.size() > 1)
+        {
+            bool overCount = items.size() > config.maxClips;
+            bool overMemory = config.maxMemoryBytes && residentTotal > config.maxMemoryBytes;
+            long long order;
+            if ((!overCount && !overMemory) || !evictionPolicy.victim(overMemory, items.front().order, order))
             {
-                drawConsole();
+                break;
+            }
+            // Orders fall from top to bottom
+            auto found = std::lower_bound(items.begin(), items.end(), order,
+                                          [](const ClipboardItem& item, long long value) { return item.order > value; });
+            if (found == items.end() || found->order != order)
+            {
+                residentTotal -= evictionPolicy.remove(order);
+                continue;
+            }
+            size_t index = found - items.begin();
+            archiveItem(items[index]);
+            eraseItem(index);
+            if (!overCount)
+            {
+                memoryEvictions++;
             }
-
-            return;
         }
+    }
 
-        items.emplace(items.begin(), trimmed_content);
-        while (items.size() > config.maxClips)
+    void printMemoryStats()
+    {
+        size_t spilled = 0;
+        size_t spilledBytes = 0;
+        for (const auto& item : items)
         {
-            items.pop_back();
+            if (item.isSpilled())
+            {
+                spilled++;
+                spilledBytes += item.blobSize;
+            }
         }
-        
-        // Reset selection to top when new item is added
-        selectedItem = 0;
-        
-        // Update filtered items if in filter mode
-        if (filterMode)
+        std::cout << "History memory: " << residentTotal << " bytes";
+        if (config.maxMemoryBytes)
         {
-            updateFilteredItems();
+            std::cout << " of " << config.maxMemoryBytes;
         }
-        
-        saveToFile();
-        
-        std::cout << "New clipboard item added\n";
-        
-        // Refresh display if window is visible
-        if (visible)
+        std::cout << "\n";
+        std::cout << "Spilled clips: " << spilled << ", " << spilledBytes << " bytes on disk\n";
+        std::cout << "Clips evicted by max_memory_bytes: " << memoryEvictions << "\n";
+    }
+
+    // Hands a clip entering the history at the top, or at the bottom while
+    // loading, to the eviction policy and the memory count
+    void trackItem(ClipboardItem& item, bool atTop)
+    {
+        long long seconds = std::chrono::duration_cast<std::chrono::seconds>(item.timestamp.time_since_epoch()).count();
+        item.order = atTop ? ++topOrder : --bottomOrder;
+        // Going to the top is a use; loading only counts the capture
+        if (atTop || item.frecency == EvictionPolicy::NO_USES)
+        {
+            item.frecency = EvictionPolicy::addUse(item.frecency, seconds);
+        }
+
+        EvictionPolicy::Clip clip;
+        clip.order = item.order;
+        clip.lastUsed = seconds;
+        clip.frecency = item.frecency;
+        clip.bytes = residentBytes(item);
+        clip.keepLonger = item.isPath || (!item.isBlob() && isUrl(item.content));
+        evictionPolicy.add(clip);
+        residentTotal += clip.bytes;
+    }
+
+    // Takes back what trackItem counted, whatever became of the item since
+    void untrackItem(const ClipboardItem& item)
+    {
+        residentTotal -= evictionPolicy.remove(item.order);
+    }
+
+    // index is 0, or items.size() while loading
+    void insertItem(size_t index, ClipboardItem&& item)
+    {
+        trackItem(item, index == 0);
+        std::lock_guard<std::mutex> lock(itemsMutex);
+        items.insert(items.begin() + index, std::move(item));
+    }
+
+    void eraseItem(size_t index)
+    {
+        untrackItem(items[index]);
+        std::lock_guard<std::mutex> lock(itemsMutex);
+        items.erase(items.begin() + index);
+    }
+
+    // Moves a clip to the top in one critical section, so a save on the
+    // worker never meets it moved out; update may change it on the way
+    void moveItemToTop(size_t index, const std::function<void(ClipboardItem&)>& update)
+    {
+        untrackItem(items[index]);
+        std::lock_guard<std::mutex> lock(itemsMutex);
+        ClipboardItem item = std::move(items[index]);
+        items.erase(items.begin() + index);
+        update(item);
+        trackItem(item, true);
+        items.push_front(std::move(item));
+    }
+
+    // Saves on the ingest worker when it runs, so the encryption and the
+    // file write stay off the event thread
+    void requestSave()
+    {
+#ifdef __linux__
+        if (ingestPipeline.isRunning())
         {
-            drawConsole();
+            ingestPipeline.requestSave();
+            return;
         }
+#endif
+        saveToFile();
     }
     
+    // Binary and spilled clips are served from the blob store's mapping of the file
+    void copyItemToClipboard(const ClipboardItem& item)
+    {
+#ifdef __linux__
+        if (item.isSpilled())
+        {
+            BlobMapping text = blobStore.map(item.blobKey);
+            if (!text.valid())
+            {
+                writeLog("copyItemToClipboard: spilled clip " + item.blobKey + " is missing");
+                return;
+            }
+            if (!clipboardOwner.ownText(std::move(text), lastUserTime))
+            {
+                writeLog("copyItemToClipboard: could not take ownership of CLIPBOARD");
+            }
+            return;
+        }
+        if (item.isBlob())
+        {
+            BlobMapping blob = blobStore.map(item.blobKey);
+            if (!blob.valid())
+            {
+                writeLog("copyItemToClipboard: blob " + item.blobKey + " is missing");
+                return;
+            }
+            if (!clipboardOwner.ownBlob(XInternAtom(display, item.mimeType.c_str(), False), std::move(blob), lastUserTime))
+            {
+                writeLog("copyItemToClipboard: could not take ownership of CLIPBOARD");
+            }
+            return;
+        }
+#endif
+        copyToClipboard(item.content);
+    }
+
     void copyToClipboard(const std::string& content)
     {
 #ifdef __linux__
-        // Use xclip to copy to clipboard
-        FILE* pipe = popen("xclip -selection clipboard", "w");
-        if (pipe)
+        if (!clipboardOwner.own(content, lastUserTime))
         {
-            fwrite(content.c_str(), 1, content.length(), pipe);
-            pclose(pipe);
+            writeLog("copyToClipboard: could not take ownership of CLIPBOARD");
         }
 #endif
 
@@ -4865,95 +6124,262 @@ public:
 #endif
     }
     
+    // The short clips in the history are what the dictionary is for
+    void trainCompressionDictionary()
+    {
+        const size_t MAX_SAMPLES = 256;
+        const size_t MAX_SAMPLE_SIZE = 1024;
+        std::vector<std::string> samples;
+        {
+            std::lock_guard<std::mutex> lock(itemsMutex);
+            for (const auto& item : items)
+            {
+                if (!item.isBlob() && item.content.size() <= MAX_SAMPLE_SIZE)
+                {
+                    samples.push_back(item.content);
+                    if (samples.size() == MAX_SAMPLES)
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+        if (contentStore.trainDictionary(samples))
+        {
+            writeLog("Trained a compression dictionary from " + std::to_string(samples.size()) + " clips");
+        }
+    }
+
+    // Event thread; the stores take their part under their own locks
+    void updateSaveSettings()
+    {
+        {
+            std::lock_guard<std::mutex> lock(saveSettingsMutex);
+            saveSettings.archiveHistory = config.archiveHistory;
+            saveSettings.compressDictionary = config.compressDictionary;
+            saveSettings.archiveRetention = config.archiveRetention;
+        }
+        debugLogging = config.m_debugging;
+        contentStore.setCompression(config.compressMinSize, config.compressDictionary);
+        historyArchive.setPartition(config.archivePartition);
+    }
+
     void saveToFile()
     {
-        std::ofstream file(config.dataFile);
-        if (file.is_open())
+        SaveSettings settings;
+        {
+            std::lock_guard<std::mutex> lock(saveSettingsMutex);
+            settings = saveSettings;
+        }
+
+        archiveQueuedClips();
+        if (settings.compressDictionary && !contentStore.hasDictionary())
         {
+            trainCompressionDictionary();
+        }
+
+        // Copied out under the lock, so the event thread only waits for the
+        // copy; compressing and encrypting new texts happens after it
+        struct SavedText
+        {
+            uint64_t hash;
+            std::string content;
+        };
+        RecordStore::Records records;
+        std::vector<std::pair<size_t, SavedText>> texts;
+        {
+            std::lock_guard<std::mutex> lock(itemsMutex);
+            records.reserve(items.size());
+            texts.reserve(items.size());
             for (const auto& item : items)
             {
-                // Store timestamp and content (encrypted if enabled)
                 auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
                     item.timestamp.time_since_epoch()).count();
-                std::string contentToSave = encrypt(item.content, config);
-                file << timestamp << "|" << contentToSave << "\n";
+                if (item.isBlob())
+                {
+                    // Only the reference; the bytes are in the blob store
+                    records.push_back(std::to_string(timestamp) + "|" + BLOB_RECORD_TAG + item.mimeType + "|" +
+                                      std::to_string(item.blobSize) + "|" + item.blobKey);
+                    continue;
+                }
+                texts.emplace_back(records.size(), SavedText { item.hash, item.content });
+                records.push_back(std::to_string(timestamp) + "|" + ContentStore::REFERENCE_TAG);
             }
-            file.close();
+        }
+        for (auto& text : texts)
+        {
+            // Compressed, encrypted and written only the first time the text is seen
+            records[text.first] += contentStore.intern(text.second.hash, text.second.content);
+        }
+        if (contentStore.put(HISTORY_COLLECTION, std::move(records)))
+        {
+            // Runs on the ingest worker, like the save itself
+            contentStore.collectGarbage();
+        }
+        enforceArchiveRetention(settings);
+    }
+
+    void enforceArchiveRetention(const SaveSettings& settings)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (!settings.archiveHistory || now < retentionDue)
+        {
+            return;
+        }
+        retentionDue = now + std::chrono::hours(1);
+        long long seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        // The clips of a period that is over stop waiting for company
+        historyArchive.sealPastPeriods(seconds);
+
+        std::vector<RetentionRule> rules;
+        if (!parseRetentionRules(settings.archiveRetention, rules))
+        {
+            writeLog("enforceArchiveRetention: invalid archive_retention \"" + settings.archiveRetention + "\"");
+            return;
+        }
+        size_t removed = historyArchive.enforceRetention(rules, seconds);
+        if (removed)
+        {
+            archivedClipsExpired += removed;
+            writeLog("Archive retention removed " + std::to_string(removed) + " clips");
         }
     }
     
+    // mime|size|key, as written by saveToFile
+    void loadBlobRecord(const std::string& record, long long seconds)
+    {
+        size_t first = record.find('|');
+        size_t second = first == std::string::npos ? first : record.find('|', first + 1);
+        if (second == std::string::npos)
+        {
+            return;
+        }
+        std::string mimeType = record.substr(0, first);
+        size_t size = std::stoull(record.substr(first + 1, second - first - 1));
+        std::string key = record.substr(second + 1);
+        PreparedClip clip;
+        if (mimeType == SPILLED_TEXT_TYPE)
+        {
+#ifdef __linux__
+            // Only the preview is read in, from the mapping
+            BlobMapping text = blobStore.map(key);
+            if (!text.valid())
+            {
+                writeLog("loadBlobRecord: spilled clip " + key + " is missing");
+                return;
+            }
+            prepareSpilledClip(text.data(), text.size(), key, clip);
+#else
+            return;
+#endif
+        }
+        else
+        {
+            prepareBlobClip(mimeType, size, key, clip);
+        }
+        clip.timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+        insertItem(items.size(), ClipboardItem(std::move(clip)));
+    }
+
+    // A long text from before max_memory_bytes was set goes to the blob
+    // store, and the next save refers to it there
+    bool spillLoadedText(const std::string& text, long long seconds)
+    {
+#ifdef __linux__
+        if (!spillSize() || text.size() < spillSize())
+        {
+            return false;
+        }
+        std::string key = blobStore.put(text);
+        if (key.empty())
+        {
+            return false;
+        }
+        PreparedClip clip;
+        prepareSpilledClip(text.data(), text.size(), key, clip);
+        clip.timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+        insertItem(items.size(), ClipboardItem(std::move(clip)));
+        return true;
+#else
+        (void)text;
+        (void)seconds;
+        return false;
+#endif
+    }
+
     void loadFromFile()
     {
-        std::ifstream file(config.dataFile);
-        if (file.is_open())
+        for (const std::string& line : database.read(HISTORY_COLLECTION))
         {
-            std::string line;
-            while (std::getline(file, line))
+            size_t pos = line.find('|');
+            if (pos != std::string::npos && pos > 0)
             {
-                size_t pos = line.find('|');
-                if (pos != std::string::npos && pos > 0)
+                std::string timestampStr = line.substr(0, pos);
+                std::string content = line.substr(pos + 1);
+                
+                try
                 {
-                    std::string timestampStr = line.substr(0, pos);
-                    std::string content = line.substr(pos + 1);
+                    if (content.compare(0, BLOB_RECORD_TAG.size(), BLOB_RECORD_TAG) == 0)
+                    {
+                        loadBlobRecord(content.substr(BLOB_RECORD_TAG.size()), std::stoll(timestampStr));
+                        continue;
+                    }
+
+                    std::string key = ContentStore::referenceKey(line);
+                    if (!key.empty())
+                    {
+                        std::string text;
+                        if (contentStore.lookup(key, text) && !spillLoadedText(text, std::stoll(timestampStr)))
+                        {
+                            ClipboardItem item(text);
+                            item.timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(std::stoll(timestampStr)));
+                            insertItem(items.size(), std::move(item));
+                        }
+                        continue;
+                    }
+
+                    std::string decryptedContent;
                     
+                    // Try to decrypt first
                     try
                     {
-                        std::string decryptedContent;
-                        
-                        // Try to decrypt first
-                        try
+                        decryptedContent = decrypt(content, config);
+                        // Check if decryption produced reasonable results (no control characters)
+                        bool hasControlChars = false;
+                        for (char c : decryptedContent)
                         {
-                            decryptedContent = decrypt(content, config);
-                            // Check if decryption produced reasonable results (no control characters)
-                            bool hasControlChars = false;
-                            for (char c : decryptedContent)
+                            if (c < 32 && c != '\n' && c != '\r' && c != '\t')
                             {
-                                if (c < 32 && c != '\n' && c != '\r' && c != '\t')
-                                {
-                                    hasControlChars = true;
-                                    break;
-                                }
-                            }
-                            
-                            // If decryption produced garbage, assume the content was never encrypted
-                            if (hasControlChars || decryptedContent.empty())
-                            {
-                                decryptedContent = content;
+                                hasControlChars = true;
+                                break;
                             }
                         }
-                        catch (...)
+                        
+                        // If decryption produced garbage, assume the content was never encrypted
+                        if (hasControlChars || decryptedContent.empty())
                         {
-                            // If decryption fails, assume content was never encrypted
                             decryptedContent = content;
                         }
-                        
-                        ClipboardItem item(decryptedContent);
-                        auto timestamp = std::chrono::seconds(std::stoll(timestampStr));
-                        item.timestamp = std::chrono::system_clock::time_point(timestamp);
-                        
-                        items.push_back(item);
                     }
-                    catch (const std::exception& e)
+                    catch (...)
                     {
-                        // Skip invalid entries
-                        continue;
+                        // If decryption fails, assume content was never encrypted
+                        decryptedContent = content;
                     }
+                    
+                    ClipboardItem item(decryptedContent);
+                    auto timestamp = std::chrono::seconds(std::stoll(timestampStr));
+                    item.timestamp = std::chrono::system_clock::time_point(timestamp);
+                    
+                    insertItem(items.size(), std::move(item));
+                }
+                catch (const std::exception& e)
+                {
+                    // Skip invalid entries
+                    continue;
                 }
-            }
-            file.close();
-        }
-        else
-        {
-            // Create empty clips.txt file if it doesn't exist
-            std::ofstream outFile(config.dataFile);
-            if (outFile.is_open())
-            {
-                outFile.close();
-                std::cout << "Created empty clips file: " << config.dataFile << "\n";
-            }
-            else
-            {
-                std::cerr << "Failed to create clips file: " << config.dataFile << "\n";
             }
         }
     }
@@ -5009,71 +6435,21 @@ void ClipboardManager::moveCursorWordRight()
 
 void ClipboardManager::updateFilteredBookmarkClips()
 {
-    filteredBookmarkClips.clear();
-    std::string selectedGroup = bookmarkGroups[selectedViewBookmarkGroup];
-    std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-    std::ifstream file(bookmarkFile);
-
-    if (file.is_open())
-    {
-        std::string line;
-
-        while (std::getline(file, line))
-        {
-            size_t pos = line.find('|');
-
-            if (pos != std::string::npos && pos > 0)
-            {
-                std::string content = line.substr(pos + 1);
-
-                try
-                {
-                    std::string decryptedContent = decrypt(content, config);
-                    // Perform case-insensitive search
-                    std::string lower_decrypted_content = decryptedContent;
-                    std::transform(lower_decrypted_content.begin(), lower_decrypted_content.end(), lower_decrypted_content.begin(),
-                                   [](unsigned char c){ return std::tolower(c); });
-
-                    std::string lower_filter_text = filterBookmarkClipsText;
-                    std::transform(lower_filter_text.begin(), lower_filter_text.end(), lower_filter_text.begin(),
-                                   [](unsigned char c){ return std::tolower(c); });
-
-                    if (lower_decrypted_content.find(lower_filter_text) != std::string::npos)
-                    {
-                        filteredBookmarkClips.push_back(decryptedContent);
-                    }
-                }
-                catch (...)
-                {
-                    // Fallback to non-decrypted content if decryption fails
-                    std::string lower_content = content;
-                    std::transform(lower_content.begin(), lower_content.end(), lower_content.begin(),
-                                   [](unsigned char c){ return std::tolower(c); });
-
-                    std::string lower_filter_text = filterBookmarkClipsText;
-                    std::transform(lower_filter_text.begin(), lower_filter_text.end(), lower_filter_text.begin(),
-                                   [](unsigned char c){ return std::tolower(c); });
-
-                    if (lower_content.find(lower_filter_text) != std::string::npos)
-                    {
-                        filteredBookmarkClips.push_back(content);
-                    }
-                }
-            }
-        }
-
-        file.close();
-    }
+    // Perform case-insensitive search over the group held in memory
+    std::string lower_filter_text = filterBookmarkClipsText;
+    std::transform(lower_filter_text.begin(), lower_filter_text.end(), lower_filter_text.begin(),
+                   [](unsigned char c){ return std::tolower(c); });
+    bookmarkStore.filter(bookmarkGroups[selectedViewBookmarkGroup], lower_filter_text, filteredBookmarkIndices);
 
     // Reset selection if no items match
 
-    if (filteredBookmarkClips.empty())
+    if (filteredBookmarkIndices.empty())
     {
         selectedViewBookmarkItem = 0;
     }
-    else if (selectedViewBookmarkItem >= filteredBookmarkClips.size())
+    else if (selectedViewBookmarkItem >= filteredBookmarkIndices.size())
     {
-        selectedViewBookmarkItem = filteredBookmarkClips.size() - 1;
+        selectedViewBookmarkItem = filteredBookmarkIndices.size() - 1;
     }
 }
 
@@ -5083,31 +6459,7 @@ size_t ClipboardManager::getBookmarkItemCount()
     {
         return 0;
     }
-
-    std::string selectedGroup = bookmarkGroups[selectedViewBookmarkGroup];
-    std::string bookmarkFile = config.bookmarksDir + "/bookmarks_" + selectedGroup + ".txt";
-    std::ifstream file(bookmarkFile);
-        
-    size_t itemCount = 0;
-
-    if (file.is_open())
-    {
-        std::string line;
-
-        while (std::getline(file, line))
-        {
-            size_t pos = line.find('|');
-
-            if (pos != std::string::npos && pos > 0)
-            {
-                itemCount++;
-            }
-        }
-
-        file.close();
-    }
-
-    return itemCount;
+    return bookmarkStore.count(bookmarkGroups[selectedViewBookmarkGroup]);
 }
 
 std::string stringToLower(const std::string& str)
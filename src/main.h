@@ -15,6 +15,9 @@
 #include <regex>
 #include <algorithm>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <chrono>
 #include <fstream>
 #include <sstream>
@@ -30,6 +33,15 @@
 #include <regex>
 
 
+#include "bookmark_store.h"
+#include "content_store.h"
+#include "eviction_policy.h"
+#include "history_archive.h"
+#include "ingest_pipeline.h"
+#include "pinned_store.h"
+#include "record_store.h"
+#include "utils.h"
+
 #ifdef __linux__
 #include <X11/Xlib.h>
 #include <X11/keysym.h>
@@ -55,14 +67,39 @@ struct ClipboardItem
     std::string content;
     std::string lowercase_content;
     std::chrono::system_clock::time_point timestamp;
+    uint64_t hash;
+    uint64_t fingerprint;
+    bool isPath;
+    // Binary clips keep only a reference to the blob store
+    std::string blobKey;
+    std::string mimeType;
+    size_t blobSize { 0 };
+    // Set as the clip enters the history: its place in the list, and its
+    // uses so far for the frecent eviction policy
+    long long order { 0 };
+    double frecency { EvictionPolicy::NO_USES };
     
     ClipboardItem(const std::string& content) 
-        : content(content), timestamp(std::chrono::system_clock::now())
+        : content(content), timestamp(std::chrono::system_clock::now()),
+          hash(fnv1a64(content.data(), content.size())), fingerprint(normalizedFingerprint(content)),
+          isPath(::isPath(content))
     {
         lowercase_content.reserve(content.length());
         std::transform(content.begin(), content.end(), std::back_inserter(lowercase_content),
                        [](unsigned char c){ return std::tolower(c); });
     }
+
+    // Takes over a clip the ingest pipeline has already prepared
+    explicit ClipboardItem(PreparedClip&& clip)
+        : content(std::move(clip.content)), lowercase_content(std::move(clip.lowercase)),
+          timestamp(clip.timestamp), hash(clip.hash), fingerprint(clip.fingerprint), isPath(clip.isPath),
+          blobKey(std::move(clip.blobKey)), mimeType(std::move(clip.mimeType)), blobSize(clip.blobSize)
+    {
+    }
+
+    bool isBlob() const { return !blobKey.empty(); }
+    // A long text kept in the blob store, content holding its preview
+    bool isSpilled() const { return mimeType == SPILLED_TEXT_TYPE; }
 };
 
 
@@ -179,8 +216,14 @@ int ignore_x11_errors(Display* d, XErrorEvent* e)
     int clipListWidth { 780 }; // Default width (windowWidth - 20 for margins)
     
     // Clipboard data
-    std::vector<ClipboardItem> items;
+    // Written only through insertItem, eraseItem and moveItemToTop, which
+    // hold itemsMutex so the ingest worker can save while the UI thread
+    // keeps running
+    std::deque<ClipboardItem> items;
+    std::mutex itemsMutex;
     std::string lastClipboardContent;
+    // Spilled clips share only a preview, so the hash is compared as well
+    uint64_t lastClipboardHash { 0 };
     
     // Navigation
     size_t selectedItem { 0 };
@@ -211,14 +254,38 @@ int ignore_x11_errors(Display* d, XErrorEvent* e)
     bool bookmarkDialogVisible { false };
     std::string bookmarkDialogInput;
     std::vector<std::string> bookmarkGroups;
+    // History, pins and bookmarks, in one file
+    RecordStore database;
+    // Every clip text the database holds, once, referred to by key
+    ContentStore contentStore;
+    // Each group's clips, loaded once and kept decrypted
+    BookmarkStore bookmarkStore;
     size_t selectedBookmarkGroup { 0 };
     size_t bookmarkMgmtScrollOffset { 0 }; // For scrolling long lists
 
     // Pinned dialog
     bool pinnedDialogVisible { false };
+    // Pinned clips, loaded once and kept sorted newest first
+    PinnedStore pinnedStore;
     size_t selectedViewPinnedItem { 0 };
     size_t viewPinnedScrollOffset { 0 }; // For scrolling long lists
     int m_maxVisiblePinnedItems { 1 }; // Stores the number of currently visible pinned items
+
+    // Primary selections dialog
+    bool primaryDialogVisible { false };
+    size_t selectedPrimaryItem { 0 };
+    size_t primaryScrollOffset { 0 };
+
+    // Archive dialog: clips max_clips moved out of the history
+    HistoryArchive historyArchive;
+    bool archiveDialogVisible { false };
+    bool archiveFilterMode { false };
+    std::string archiveFilterText;
+    // Archive rows matching archiveFilterText, once a search has run
+    std::vector<size_t> archiveMatches;
+    bool archiveSearched { false };
+    size_t selectedArchiveItem { 0 };
+    size_t archiveScrollOffset { 0 };
     
     // Add to bookmark dialog state
     bool addToBookmarkDialogVisible { false };
@@ -255,6 +322,7 @@ int ignore_x11_errors(Display* d, XErrorEvent* e)
     // Bookmark clips filtering
     bool filterBookmarkClipsMode { false };
     std::string filterBookmarkClipsText;
-    std::vector<std::string> filteredBookmarkClips;
+    // Positions in the group of the clips matching the filter
+    std::vector<size_t> filteredBookmarkIndices;
 
 #endif // End main_h
@@ -0,0 +1,169 @@
+#include "pinned_store.h"
+#include "config.h"
+#include "content_store.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+namespace
+{
+    long long now()
+    {
+        return std::chrono::system_clock::now().time_since_epoch().count();
+    }
+}
+
+const char* const PinnedStore::COLLECTION = "pinned";
+
+void PinnedStore::open(const RecordStore& records, ContentStore& contents, const ConfigManager& config)
+{
+    m_contents = &contents;
+    m_entries.clear();
+
+    // pinned.txt from before the record store could repeat a clip that
+    // was copied again; the newest line wins
+    std::unordered_map<std::string, size_t> byKey;
+    bool imported = false;
+    for (const std::string& line : records.read(COLLECTION))
+    {
+        size_t pos = line.find('|');
+        if (pos == std::string::npos || pos == 0)
+        {
+            continue;
+        }
+
+        Entry entry;
+        try
+        {
+            entry.timestamp = std::stoll(line.substr(0, pos));
+        }
+        catch (...)
+        {
+            entry.timestamp = now();
+        }
+
+        entry.key = ContentStore::referenceKey(line);
+        if (entry.key.empty())
+        {
+            // Imported with the text inline; stored by reference from now on
+            try
+            {
+                entry.content = decrypt(line.substr(pos + 1), config);
+            }
+            catch (...)
+            {
+                entry.content = line.substr(pos + 1);
+            }
+            entry.hash = fnv1a64(entry.content.data(), entry.content.size());
+            entry.key = contents.intern(entry.hash, entry.content);
+            imported = true;
+        }
+
+        auto seen = byKey.find(entry.key);
+        if (seen != byKey.end())
+        {
+            Entry& earlier = m_entries[seen->second];
+            earlier.timestamp = std::max(earlier.timestamp, entry.timestamp);
+            continue;
+        }
+
+        if (entry.content.empty())
+        {
+            if (!contents.lookup(entry.key, entry.content))
+            {
+                continue;
+            }
+            entry.hash = fnv1a64(entry.content.data(), entry.content.size());
+        }
+        byKey.emplace(entry.key, m_entries.size());
+        m_entries.push_back(std::move(entry));
+    }
+
+    std::stable_sort(m_entries.begin(), m_entries.end(),
+                     [](const Entry& a, const Entry& b) { return a.timestamp > b.timestamp; });
+    reindex();
+    if (imported)
+    {
+        save();
+    }
+}
+
+bool PinnedStore::contains(const std::string& content) const
+{
+    // The hash only rules clips out; a match is confirmed on the text
+    auto range = m_byHash.equal_range(fnv1a64(content.data(), content.size()));
+    return std::any_of(range.first, range.second,
+                       [&](const auto& match) { return m_entries[match.second].content == content; });
+}
+
+bool PinnedStore::add(const std::string& content)
+{
+    Entry entry;
+    entry.timestamp = now();
+    entry.content = content;
+    entry.hash = fnv1a64(content.data(), content.size());
+    entry.key = m_contents->intern(entry.hash, content);
+
+    m_entries.insert(m_entries.begin(), std::move(entry));
+    if (!save())
+    {
+        m_entries.erase(m_entries.begin());
+        return false;
+    }
+    reindex();
+    return true;
+}
+
+void PinnedStore::touch(size_t index)
+{
+    if (index >= m_entries.size())
+    {
+        return;
+    }
+    Entry entry = std::move(m_entries[index]);
+    m_entries.erase(m_entries.begin() + index);
+    entry.timestamp = now();
+    m_entries.insert(m_entries.begin(), std::move(entry));
+    reindex();
+    save();
+}
+
+bool PinnedStore::erase(size_t index)
+{
+    if (index >= m_entries.size())
+    {
+        return false;
+    }
+    Entry entry = std::move(m_entries[index]);
+    m_entries.erase(m_entries.begin() + index);
+    if (!save())
+    {
+        m_entries.insert(m_entries.begin() + index, std::move(entry));
+        return false;
+    }
+    reindex();
+    return true;
+}
+
+void PinnedStore::reindex()
+{
+    m_byHash.clear();
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        m_byHash.emplace(m_entries[i].hash, i);
+    }
+}
+
+bool PinnedStore::save()
+{
+    RecordStore::Records records;
+    records.reserve(m_entries.size());
+    // Oldest first, the order the old file kept
+    for (auto it = m_entries.rbegin(); it != m_entries.rend(); ++it)
+    {
+        records.push_back(std::to_string(it->timestamp) + "|" + ContentStore::REFERENCE_TAG + it->key);
+    }
+    return m_contents->put(COLLECTION, std::move(records));
+}
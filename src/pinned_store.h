@@ -0,0 +1,59 @@
+#ifndef PINNED_STORE_H
+#define PINNED_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ConfigManager;
+class ContentStore;
+class RecordStore;
+
+// Pinned clips, read from the record store and decrypted once at startup
+// and kept newest first, so the pinned dialog does no I/O at all. The
+// "pinned" collection holds only references into the content store, so a
+// change commits a few short records whatever the size of the clips.
+class PinnedStore
+{
+public:
+    struct Entry
+    {
+        long long timestamp { 0 };
+        std::string content;
+        uint64_t hash { 0 };
+        // The content store key
+        std::string key;
+    };
+
+    static const char* const COLLECTION;
+
+    void open(const RecordStore& records, ContentStore& contents, const ConfigManager& config);
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    // 0 is the most recently pinned or used
+    const Entry& at(size_t index) const { return m_entries[index]; }
+
+    // By the 64-bit content hash, then the text of only the clips it matches
+    bool contains(const std::string& content) const;
+
+    // False, and nothing pinned, if the change could not be saved
+    bool add(const std::string& content);
+    // Moves the clip to the front under a new timestamp
+    void touch(size_t index);
+    bool erase(size_t index);
+
+private:
+    bool save();
+    // Every change already moves entries and rewrites the collection, so
+    // the index is simply rebuilt after it
+    void reindex();
+
+    ContentStore* m_contents { nullptr };
+    std::vector<Entry> m_entries;
+    // Content hash to the index of each entry with that hash
+    std::unordered_multimap<uint64_t, size_t> m_byHash;
+};
+
+#endif
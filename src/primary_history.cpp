@@ -0,0 +1,71 @@
+#include "primary_history.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace
+{
+    bool isPrefix(const std::string& prefix, const std::string& text)
+    {
+        return prefix.size() <= text.size() && std::equal(prefix.begin(), prefix.end(), text.begin());
+    }
+}
+
+PrimaryHistory::PrimaryHistory(size_t capacity)
+    : m_slots(std::max<size_t>(capacity, 1))
+{
+}
+
+bool PrimaryHistory::add(std::string text)
+{
+    if (text.empty())
+    {
+        return false;
+    }
+    uint64_t hash = fnv1a64(text.data(), text.size());
+
+    if (m_count > 0)
+    {
+        Entry& newest = slot(0);
+        if (newest.hash == hash && newest.text == text)
+        {
+            return false;
+        }
+        // The same drag, grown or shrunk
+        if (isPrefix(newest.text, text) || isPrefix(text, newest.text))
+        {
+            newest.text = std::move(text);
+            newest.hash = hash;
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < m_count; ++i)
+    {
+        if (slot(i).hash == hash && slot(i).text == text)
+        {
+            erase(i);
+            break;
+        }
+    }
+
+    m_newest = (m_newest + 1) % m_slots.size();
+    m_slots[m_newest] = Entry { std::move(text), hash };
+    m_count = std::min(m_count + 1, m_slots.size());
+    return true;
+}
+
+void PrimaryHistory::erase(size_t index)
+{
+    if (index >= m_count)
+    {
+        return;
+    }
+    // Entries older than index each move one step newer
+    for (size_t i = index; i + 1 < m_count; ++i)
+    {
+        slot(i) = std::move(slot(i + 1));
+    }
+    slot(m_count - 1) = Entry {};
+    m_count--;
+}
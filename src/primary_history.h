@@ -0,0 +1,43 @@
+#ifndef PRIMARY_HISTORY_H
+#define PRIMARY_HISTORY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Fixed-capacity ring of recent PRIMARY selections, kept apart from the
+// clipboard history. Dragging a selection grows or shrinks it from the
+// same start, so a selection that extends the newest entry, or is cut
+// from it, replaces that entry instead of adding another. Exact repeats
+// move to the front. Adding never costs more than one pass over the ring.
+class PrimaryHistory
+{
+public:
+    explicit PrimaryHistory(size_t capacity = 50);
+
+    // False if the ring did not change
+    bool add(std::string text);
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+
+    // 0 is the newest entry
+    const std::string& at(size_t index) const { return slot(index).text; }
+    void erase(size_t index);
+
+private:
+    struct Entry
+    {
+        std::string text;
+        uint64_t hash { 0 };
+    };
+
+    Entry& slot(size_t index) { return m_slots[(m_newest + m_slots.size() - index) % m_slots.size()]; }
+    const Entry& slot(size_t index) const { return m_slots[(m_newest + m_slots.size() - index) % m_slots.size()]; }
+
+    std::vector<Entry> m_slots;
+    size_t m_newest { 0 };
+    size_t m_count { 0 };
+};
+
+#endif
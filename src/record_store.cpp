@@ -0,0 +1,534 @@
+#include "record_store.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t PAGE_SIZE = 4096;
+    const char MAGIC[8] = { 'M', 'M', 'R', 'Y', 'D', 'B', '0', '1' };
+    // Two slots at the start of page 0, written alternately
+    const size_t SLOT_SIZE = 64;
+    const size_t SLOT_BYTES = 48;
+
+    void putU32(std::string& out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    void putU64(std::string& out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    // Bounds-checked little-endian reads; ok turns false on a short buffer
+    struct Reader
+    {
+        const std::string& data;
+        size_t pos { 0 };
+        bool ok { true };
+
+        explicit Reader(const std::string& data) : data(data) {}
+
+        uint64_t number(int bytes)
+        {
+            if (!ok || data.size() - pos < static_cast<size_t>(bytes))
+            {
+                ok = false;
+                return 0;
+            }
+            uint64_t value = 0;
+            for (int i = 0; i < bytes; ++i)
+            {
+                value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+            }
+            pos += bytes;
+            return value;
+        }
+
+        uint32_t u32() { return static_cast<uint32_t>(number(4)); }
+        uint64_t u64() { return number(8); }
+
+        std::string bytes(size_t length)
+        {
+            if (!ok || data.size() - pos < length)
+            {
+                ok = false;
+                return std::string();
+            }
+            std::string value = data.substr(pos, length);
+            pos += length;
+            return value;
+        }
+    };
+
+    std::string serializeRecords(const RecordStore::Records& records)
+    {
+        size_t total = 4;
+        for (const std::string& record : records)
+        {
+            total += 4 + record.size();
+        }
+        std::string out;
+        out.reserve(total);
+        putU32(out, static_cast<uint32_t>(records.size()));
+        for (const std::string& record : records)
+        {
+            putU32(out, static_cast<uint32_t>(record.size()));
+            out += record;
+        }
+        return out;
+    }
+
+    bool parseRecords(const std::string& data, RecordStore::Records& records)
+    {
+        Reader reader(data);
+        uint32_t count = reader.u32();
+        records.clear();
+        records.reserve(reader.ok ? std::min<size_t>(count, data.size() / 4) : 0);
+        for (uint32_t i = 0; i < count && reader.ok; ++i)
+        {
+            uint32_t length = reader.u32();
+            records.push_back(reader.bytes(length));
+        }
+        return reader.ok;
+    }
+}
+
+void RecordStore::Transaction::put(const std::string& collection, Records records)
+{
+    m_changes[collection] = std::make_pair(true, std::move(records));
+}
+
+void RecordStore::Transaction::remove(const std::string& collection)
+{
+    m_changes[collection] = std::make_pair(false, Records());
+}
+
+RecordStore::~RecordStore()
+{
+    close();
+}
+
+bool RecordStore::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_collections.clear();
+    m_freePages.clear();
+    m_generation = 0;
+    m_activeSlot = -1;
+    m_catalog = Extent();
+    m_pageCount = 1;
+
+    m_file = std::fopen(path.c_str(), "r+b");
+    if (!m_file)
+    {
+        // A new store is one page with two empty header slots
+        m_file = std::fopen(path.c_str(), "w+b");
+        if (!m_file)
+        {
+            return false;
+        }
+        std::string page(PAGE_SIZE, '\0');
+        if (std::fwrite(page.data(), 1, page.size(), m_file) != page.size() || !sync())
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+            return false;
+        }
+        return true;
+    }
+    if (!load())
+    {
+        // Never keep, or later overwrite, a store we could not read
+        std::fclose(m_file);
+        m_file = nullptr;
+        m_collections.clear();
+        m_freePages.clear();
+        return false;
+    }
+    return true;
+}
+
+void RecordStore::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_collections.clear();
+    m_freePages.clear();
+}
+
+bool RecordStore::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file != nullptr;
+}
+
+bool RecordStore::isNew() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_activeSlot < 0;
+}
+
+bool RecordStore::contains(const std::string& collection) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_collections.count(collection) > 0;
+}
+
+RecordStore::Records RecordStore::read(const std::string& collection) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_collections.find(collection);
+    return found != m_collections.end() ? found->second.records : Records();
+}
+
+std::vector<std::string> RecordStore::collections() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> names;
+    names.reserve(m_collections.size());
+    for (const auto& entry : m_collections)
+    {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+bool RecordStore::load()
+{
+    std::fseek(m_file, 0, SEEK_END);
+    long size = std::ftell(m_file);
+    m_pageCount = std::max<uint32_t>(1, static_cast<uint32_t>((size + PAGE_SIZE - 1) / PAGE_SIZE));
+
+    std::string header(2 * SLOT_SIZE, '\0');
+    std::fseek(m_file, 0, SEEK_SET);
+    if (std::fread(&header[0], 1, header.size(), m_file) != header.size())
+    {
+        return false;
+    }
+
+    struct Slot
+    {
+        int index;
+        uint64_t generation;
+        Extent catalog;
+    };
+    std::vector<Slot> slots;
+    for (int i = 0; i < 2; ++i)
+    {
+        std::string bytes = header.substr(i * SLOT_SIZE, SLOT_BYTES);
+        if (std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0)
+        {
+            continue;
+        }
+        Reader reader(bytes);
+        reader.bytes(sizeof(MAGIC));
+        Slot slot { i, reader.u64(), Extent() };
+        slot.catalog.first = reader.u32();
+        slot.catalog.count = reader.u32();
+        slot.catalog.length = reader.u64();
+        slot.catalog.checksum = reader.u64();
+        uint64_t checksum = reader.u64();
+        if (reader.ok && checksum == fnv1a64(bytes.data(), SLOT_BYTES - 8))
+        {
+            slots.push_back(slot);
+        }
+    }
+    std::sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) { return a.generation > b.generation; });
+
+    // The newest slot whose catalog and collections all check out wins
+    for (const Slot& slot : slots)
+    {
+        std::string catalog;
+        if (!readExtent(slot.catalog, catalog))
+        {
+            continue;
+        }
+        Reader reader(catalog);
+        uint32_t count = reader.u32();
+        std::map<std::string, Collection> collections;
+        bool ok = reader.ok;
+        for (uint32_t i = 0; i < count && ok; ++i)
+        {
+            std::string name = reader.bytes(reader.u32());
+            Collection collection;
+            collection.extent.first = reader.u32();
+            collection.extent.count = reader.u32();
+            collection.extent.length = reader.u64();
+            collection.extent.checksum = reader.u64();
+            std::string data;
+            ok = reader.ok && readExtent(collection.extent, data) && parseRecords(data, collection.records);
+            collections[name] = std::move(collection);
+        }
+        if (!ok)
+        {
+            continue;
+        }
+
+        m_collections = std::move(collections);
+        m_generation = slot.generation;
+        m_activeSlot = slot.index;
+        m_catalog = slot.catalog;
+        break;
+    }
+
+    if (m_activeSlot < 0 && !slots.empty())
+    {
+        return false;
+    }
+
+    std::vector<bool> used(m_pageCount, false);
+    used[0] = true;
+    auto mark = [&used](const Extent& extent)
+    {
+        for (uint32_t page = extent.first; page < extent.first + extent.count && page < used.size(); ++page)
+        {
+            used[page] = true;
+        }
+    };
+    mark(m_catalog);
+    for (const auto& entry : m_collections)
+    {
+        mark(entry.second.extent);
+    }
+    for (uint32_t page = 1; page < m_pageCount; ++page)
+    {
+        if (!used[page])
+        {
+            m_freePages.insert(page);
+        }
+    }
+    return true;
+}
+
+bool RecordStore::readExtent(const Extent& extent, std::string& data)
+{
+    if (extent.count == 0 || extent.first == 0 || extent.first + extent.count > m_pageCount ||
+        extent.length > static_cast<uint64_t>(extent.count) * PAGE_SIZE)
+    {
+        return false;
+    }
+    data.resize(extent.length);
+    if (std::fseek(m_file, static_cast<long>(extent.first) * PAGE_SIZE, SEEK_SET) != 0 ||
+        std::fread(&data[0], 1, data.size(), m_file) != data.size())
+    {
+        return false;
+    }
+    return fnv1a64(data.data(), data.size()) == extent.checksum;
+}
+
+bool RecordStore::writeExtent(const std::string& data, Extent& extent)
+{
+    extent.count = static_cast<uint32_t>((data.size() + PAGE_SIZE - 1) / PAGE_SIZE);
+    extent.first = allocate(extent.count);
+    extent.length = data.size();
+    extent.checksum = fnv1a64(data.data(), data.size());
+
+    // Padded to whole pages, so the file always ends on a page boundary
+    size_t padding = static_cast<size_t>(extent.count) * PAGE_SIZE - data.size();
+    static const char zeros[PAGE_SIZE] = {};
+    return std::fseek(m_file, static_cast<long>(extent.first) * PAGE_SIZE, SEEK_SET) == 0 &&
+           std::fwrite(data.data(), 1, data.size(), m_file) == data.size() &&
+           std::fwrite(zeros, 1, padding, m_file) == padding;
+}
+
+bool RecordStore::writeHeader(uint64_t generation, const Extent& catalog)
+{
+    std::string slot(MAGIC, sizeof(MAGIC));
+    putU64(slot, generation);
+    putU32(slot, catalog.first);
+    putU32(slot, catalog.count);
+    putU64(slot, catalog.length);
+    putU64(slot, catalog.checksum);
+    putU64(slot, fnv1a64(slot.data(), slot.size()));
+
+    int index = m_activeSlot == 0 ? 1 : 0;
+    if (std::fseek(m_file, static_cast<long>(index * SLOT_SIZE), SEEK_SET) != 0 ||
+        std::fwrite(slot.data(), 1, slot.size(), m_file) != slot.size() || !sync())
+    {
+        return false;
+    }
+    m_activeSlot = index;
+    return true;
+}
+
+bool RecordStore::sync()
+{
+    if (std::fflush(m_file) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(m_file)) == 0;
+#else
+    return fsync(fileno(m_file)) == 0;
+#endif
+}
+
+uint32_t RecordStore::allocate(uint32_t count)
+{
+    // First run of free pages long enough, else the end of the file; a
+    // free run reaching the end is extended rather than left behind
+    uint32_t runStart = 0;
+    uint32_t runLength = 0;
+    for (uint32_t page : m_freePages)
+    {
+        if (runLength > 0 && page == runStart + runLength)
+        {
+            runLength++;
+        }
+        else
+        {
+            runStart = page;
+            runLength = 1;
+        }
+        if (runLength == count)
+        {
+            break;
+        }
+    }
+
+    uint32_t first;
+    if (runLength >= count && count > 0)
+    {
+        first = runStart;
+    }
+    else if (runLength > 0 && runStart + runLength == m_pageCount)
+    {
+        first = runStart;
+    }
+    else
+    {
+        first = m_pageCount;
+    }
+
+    for (uint32_t page = first; page < first + count; ++page)
+    {
+        m_freePages.erase(page);
+    }
+    m_pageCount = std::max(m_pageCount, first + count);
+    return first;
+}
+
+void RecordStore::release(const Extent& extent)
+{
+    for (uint32_t page = extent.first; page < extent.first + extent.count; ++page)
+    {
+        if (page > 0)
+        {
+            m_freePages.insert(page);
+        }
+    }
+}
+
+bool RecordStore::put(const std::string& collection, Records records)
+{
+    Transaction transaction;
+    transaction.put(collection, std::move(records));
+    return commit(std::move(transaction));
+}
+
+bool RecordStore::commit(Transaction transaction)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file)
+    {
+        return false;
+    }
+
+    // New pages only: nothing the current catalog points at is touched
+    std::vector<Extent> written;
+    std::map<std::string, Extent> next;
+    for (const auto& entry : m_collections)
+    {
+        next[entry.first] = entry.second.extent;
+    }
+    auto rollback = [this, &written]()
+    {
+        for (const Extent& extent : written)
+        {
+            release(extent);
+        }
+        return false;
+    };
+
+    for (const auto& change : transaction.m_changes)
+    {
+        if (!change.second.first)
+        {
+            next.erase(change.first);
+            continue;
+        }
+        Extent extent;
+        bool ok = writeExtent(serializeRecords(change.second.second), extent);
+        written.push_back(extent);
+        if (!ok)
+        {
+            return rollback();
+        }
+        next[change.first] = extent;
+    }
+
+    std::string catalog;
+    putU32(catalog, static_cast<uint32_t>(next.size()));
+    for (const auto& entry : next)
+    {
+        putU32(catalog, static_cast<uint32_t>(entry.first.size()));
+        catalog += entry.first;
+        putU32(catalog, entry.second.first);
+        putU32(catalog, entry.second.count);
+        putU64(catalog, entry.second.length);
+        putU64(catalog, entry.second.checksum);
+    }
+    Extent catalogExtent;
+    bool ok = writeExtent(catalog, catalogExtent);
+    written.push_back(catalogExtent);
+    if (!ok || !sync() || !writeHeader(m_generation + 1, catalogExtent))
+    {
+        return rollback();
+    }
+
+    // Committed: the pages of what was replaced are free from now on
+    m_generation++;
+    release(m_catalog);
+    m_catalog = catalogExtent;
+    for (auto& change : transaction.m_changes)
+    {
+        auto existing = m_collections.find(change.first);
+        if (existing != m_collections.end())
+        {
+            release(existing->second.extent);
+            m_collections.erase(existing);
+        }
+        if (change.second.first)
+        {
+            Collection& collection = m_collections[change.first];
+            collection.extent = next[change.first];
+            collection.records = std::move(change.second.second);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,125 @@
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// One database file holding every persistent list, as named collections of
+// string records (history, pins, bookmark groups and their clips).
+//
+// The file is made of 4 KiB pages. Page 0 holds two header slots; each
+// collection and the catalog naming them live in runs of pages. A commit
+// writes the changed collections and a new catalog to free pages only,
+// syncs, then writes the header slot not in use with a higher generation.
+// A crash before that last write leaves the previous catalog in place, so
+// a transaction over several collections lands entirely or not at all.
+//
+// The whole store is read into memory by open(); reading never touches the
+// file again.
+class RecordStore
+{
+public:
+    typedef std::vector<std::string> Records;
+
+    // Collections to replace or remove together
+    class Transaction
+    {
+    public:
+        void put(const std::string& collection, Records records);
+        void remove(const std::string& collection);
+        bool empty() const { return m_changes.empty(); }
+
+        // fn(name, &records) for every put, fn(name, nullptr) for every removal
+        template <typename F>
+        void forEach(F fn) const
+        {
+            for (const auto& change : m_changes)
+            {
+                fn(change.first, change.second.first ? &change.second.second : nullptr);
+            }
+        }
+
+    private:
+        friend class RecordStore;
+        // A missing value removes the collection
+        std::map<std::string, std::pair<bool, Records>> m_changes;
+    };
+
+    RecordStore() = default;
+    ~RecordStore();
+    RecordStore(const RecordStore&) = delete;
+    RecordStore& operator=(const RecordStore&) = delete;
+
+    // Creates the file when missing; false if it cannot be used
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    // True while no collection was ever committed
+    bool isNew() const;
+
+    bool contains(const std::string& collection) const;
+    Records read(const std::string& collection) const;
+    std::vector<std::string> collections() const;
+
+    // Hands each record to fn in place, without copying the collection
+    template <typename F>
+    void forEach(const std::string& collection, F fn) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_collections.find(collection);
+        if (found != m_collections.end())
+        {
+            for (const std::string& record : found->second.records)
+            {
+                fn(record);
+            }
+        }
+    }
+
+    bool commit(Transaction transaction);
+    bool put(const std::string& collection, Records records);
+
+private:
+    struct Extent
+    {
+        uint32_t first { 0 };
+        uint32_t count { 0 };
+        uint64_t length { 0 };
+        uint64_t checksum { 0 };
+    };
+
+    struct Collection
+    {
+        Extent extent;
+        Records records;
+    };
+
+    // False if the file is short or no header slot reads back whole
+    bool load();
+    bool readExtent(const Extent& extent, std::string& data);
+    bool writeExtent(const std::string& data, Extent& extent);
+    bool writeHeader(uint64_t generation, const Extent& catalog);
+    bool sync();
+
+    uint32_t allocate(uint32_t count);
+    void release(const Extent& extent);
+
+    mutable std::mutex m_mutex;
+    std::FILE* m_file { nullptr };
+    uint64_t m_generation { 0 };
+    int m_activeSlot { -1 };
+    Extent m_catalog;
+    std::map<std::string, Collection> m_collections;
+
+    // Pages past page 0 that no committed extent uses
+    std::set<uint32_t> m_freePages;
+    uint32_t m_pageCount { 1 };
+};
+
+#endif
@@ -0,0 +1,332 @@
+#include "selection_owner.h"
+
+#ifdef __linux__
+
+#include <X11/Xatom.h>
+#include <algorithm>
+#include <cstdint>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+SelectionOwner::~SelectionOwner()
+{
+    shutdown();
+}
+
+bool SelectionOwner::init(Display* display, Window window, Atom selection, std::chrono::milliseconds timeout)
+{
+    m_display = display;
+    m_window = window;
+    m_selection = selection;
+    m_timeout = timeout;
+    m_targetsAtom = XInternAtom(display, "TARGETS", False);
+    m_timestampAtom = XInternAtom(display, "TIMESTAMP", False);
+    m_utf8Atom = XInternAtom(display, "UTF8_STRING", False);
+    m_incrAtom = XInternAtom(display, "INCR", False);
+
+    // Room for the property data after the ChangeProperty request header
+    long maxRequest = XExtendedMaxRequestSize(display);
+    if (maxRequest == 0)
+    {
+        maxRequest = XMaxRequestSize(display);
+    }
+    m_maxChunk = static_cast<size_t>(maxRequest) * 4 - 100;
+
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    return m_timerFd >= 0;
+}
+
+void SelectionOwner::shutdown()
+{
+    if (m_timerFd >= 0)
+    {
+        close(m_timerFd);
+        m_timerFd = -1;
+    }
+    if (m_display)
+    {
+        endAllTransfers();
+    }
+}
+
+bool SelectionOwner::own(const std::string& content, Time time)
+{
+    if (!m_display)
+    {
+        return false;
+    }
+
+    m_content = content;
+    m_blob = BlobMapping();
+    m_blobTarget = None;
+    return takeOwnership(time);
+}
+
+bool SelectionOwner::ownBlob(Atom target, BlobMapping&& blob, Time time)
+{
+    if (!m_display || !blob.valid())
+    {
+        return false;
+    }
+
+    m_content.clear();
+    m_blob = std::move(blob);
+    m_blobTarget = target;
+    return takeOwnership(time);
+}
+
+bool SelectionOwner::ownText(BlobMapping&& text, Time time)
+{
+    if (!m_display || !text.valid())
+    {
+        return false;
+    }
+
+    m_content.clear();
+    m_blob = std::move(text);
+    m_blobTarget = None;
+    return takeOwnership(time);
+}
+
+bool SelectionOwner::takeOwnership(Time time)
+{
+    endAllTransfers();
+
+    XSetSelectionOwner(m_display, m_selection, m_window, time);
+    m_owned = XGetSelectionOwner(m_display, m_selection) == m_window;
+    m_ownedSince = time;
+    return m_owned;
+}
+
+bool SelectionOwner::handleEvent(const XEvent& event)
+{
+    switch (event.type)
+    {
+        case SelectionRequest:
+            if (event.xselectionrequest.owner != m_window || event.xselectionrequest.selection != m_selection)
+            {
+                return false;
+            }
+            answerRequest(event.xselectionrequest);
+            return true;
+
+        case SelectionClear:
+            if (event.xselectionclear.window != m_window || event.xselectionclear.selection != m_selection)
+            {
+                return false;
+            }
+            // Someone else copied; running transfers keep their data
+            m_owned = false;
+            return true;
+
+        case PropertyNotify:
+            if (event.xproperty.state != PropertyDelete)
+            {
+                return false;
+            }
+            for (const IncrTransfer& transfer : m_transfers)
+            {
+                if (transfer.requestor == event.xproperty.window && transfer.property == event.xproperty.atom)
+                {
+                    continueTransfer(event.xproperty);
+                    return true;
+                }
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+void SelectionOwner::answerRequest(const XSelectionRequestEvent& request)
+{
+    // Obsolete clients leave the property unset and expect the target name
+    Atom property = request.property != None ? request.property : request.target;
+    bool ok = m_owned;
+
+    if (ok && (request.time != CurrentTime && request.time < m_ownedSince))
+    {
+        ok = false;
+    }
+
+    if (ok)
+    {
+        if (request.target == m_targetsAtom && m_blobTarget != None)
+        {
+            Atom targets[] = { m_targetsAtom, m_timestampAtom, m_blobTarget };
+            XChangeProperty(m_display, request.requestor, property, XA_ATOM, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char*>(targets), sizeof(targets) / sizeof(targets[0]));
+        }
+        else if (request.target == m_targetsAtom)
+        {
+            Atom targets[] = { m_targetsAtom, m_timestampAtom, m_utf8Atom, XA_STRING };
+            XChangeProperty(m_display, request.requestor, property, XA_ATOM, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char*>(targets), sizeof(targets) / sizeof(targets[0]));
+        }
+        else if (request.target == m_timestampAtom)
+        {
+            long timestamp = static_cast<long>(m_ownedSince);
+            XChangeProperty(m_display, request.requestor, property, XA_INTEGER, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char*>(&timestamp), 1);
+        }
+        else if (m_blobTarget != None ? request.target == m_blobTarget
+                                      : (request.target == m_utf8Atom || request.target == XA_STRING))
+        {
+            ok = sendData(request.requestor, property, request.target);
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    XEvent reply {};
+    reply.xselection.type = SelectionNotify;
+    reply.xselection.display = m_display;
+    reply.xselection.requestor = request.requestor;
+    reply.xselection.selection = request.selection;
+    reply.xselection.target = request.target;
+    reply.xselection.property = ok ? property : None;
+    reply.xselection.time = request.time;
+    XSendEvent(m_display, request.requestor, False, NoEventMask, &reply);
+    XFlush(m_display);
+}
+
+bool SelectionOwner::sendData(Window requestor, Atom property, Atom target)
+{
+    if (size() <= m_maxChunk)
+    {
+        XChangeProperty(m_display, requestor, property, target, 8, PropModeReplace,
+                        reinterpret_cast<const unsigned char*>(data()), size());
+        return true;
+    }
+
+    // Too large for one request: announce INCR with a size hint and send a
+    // piece each time the requestor deletes the property
+    // Our own window already selects PropertyChangeMask among others
+    if (m_watched[requestor]++ == 0 && requestor != m_window)
+    {
+        XSelectInput(m_display, requestor, PropertyChangeMask);
+    }
+    long sizeHint = static_cast<long>(size());
+    XChangeProperty(m_display, requestor, property, m_incrAtom, 32, PropModeReplace,
+                    reinterpret_cast<unsigned char*>(&sizeHint), 1);
+    m_transfers.push_back({ requestor, property, target, 0, std::chrono::steady_clock::now() + m_timeout });
+    armTimer();
+    return true;
+}
+
+void SelectionOwner::continueTransfer(const XPropertyEvent& event)
+{
+    auto it = std::find_if(m_transfers.begin(), m_transfers.end(), [&](const IncrTransfer& transfer) {
+        return transfer.requestor == event.window && transfer.property == event.atom;
+    });
+    if (it == m_transfers.end())
+    {
+        return;
+    }
+
+    size_t length = std::min(m_maxChunk, size() - it->offset);
+    XChangeProperty(m_display, it->requestor, it->property, it->target, 8, PropModeReplace,
+                    reinterpret_cast<const unsigned char*>(data() + it->offset), length);
+    it->offset += length;
+
+    // The zero-length piece just written ends the transfer
+    if (length == 0)
+    {
+        endTransfer(it);
+    }
+    else
+    {
+        // Only ever later, so the armed timer at worst fires early and
+        // expire() arms it again
+        it->deadline = std::chrono::steady_clock::now() + m_timeout;
+    }
+    XFlush(m_display);
+}
+
+size_t SelectionOwner::expire()
+{
+    clearTimer();
+    auto now = std::chrono::steady_clock::now();
+    size_t expired = 0;
+    for (auto it = m_transfers.begin(); it != m_transfers.end();)
+    {
+        if (it->deadline <= now)
+        {
+            it = endTransfer(it);
+            ++expired;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (expired)
+    {
+        XFlush(m_display);
+    }
+    armTimer();
+    return expired;
+}
+
+std::vector<SelectionOwner::IncrTransfer>::iterator SelectionOwner::endTransfer(
+    std::vector<IncrTransfer>::iterator transfer)
+{
+    auto watched = m_watched.find(transfer->requestor);
+    if (watched != m_watched.end() && --watched->second == 0)
+    {
+        m_watched.erase(watched);
+        if (transfer->requestor != m_window)
+        {
+            XSelectInput(m_display, transfer->requestor, NoEventMask);
+        }
+    }
+    return m_transfers.erase(transfer);
+}
+
+void SelectionOwner::endAllTransfers()
+{
+    if (m_transfers.empty())
+    {
+        return;
+    }
+    for (auto it = m_transfers.begin(); it != m_transfers.end();)
+    {
+        it = endTransfer(it);
+    }
+    armTimer();
+}
+
+void SelectionOwner::armTimer()
+{
+    if (m_timerFd < 0)
+    {
+        return;
+    }
+
+    itimerspec spec {};
+    if (!m_transfers.empty())
+    {
+        auto earliest = std::min_element(m_transfers.begin(), m_transfers.end(),
+                                         [](const IncrTransfer& a, const IncrTransfer& b) { return a.deadline < b.deadline; })
+                            ->deadline;
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(earliest - std::chrono::steady_clock::now());
+        // A zero value would disarm the timer; an overdue deadline fires at once
+        long long ns = remaining.count() > 0 ? remaining.count() : 1;
+        spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000LL);
+        spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000LL);
+    }
+    timerfd_settime(m_timerFd, 0, &spec, nullptr);
+}
+
+void SelectionOwner::clearTimer()
+{
+    uint64_t expirations;
+    while (m_timerFd >= 0 && read(m_timerFd, &expirations, sizeof(expirations)) == sizeof(expirations))
+    {
+    }
+}
+
+#endif
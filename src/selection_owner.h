@@ -0,0 +1,100 @@
+#ifndef SELECTION_OWNER_H
+#define SELECTION_OWNER_H
+
+#ifdef __linux__
+
+#include "blob_store.h"
+#include <X11/Xlib.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Holds a selection (CLIPBOARD) on behalf of one of our windows and serves
+// it to other clients, as xclip would: TARGETS, TIMESTAMP, UTF8_STRING and
+// STRING are answered from the stored text, and payloads larger than the
+// server's request limit go out in pieces using the INCR protocol. A blob
+// is offered under its one MIME target and served from its mapping; so is
+// a spilled text, but under the text targets.
+//
+// An INCR transfer waits on the requestor to delete the property before
+// each piece. Each carries a deadline, pushed back as pieces go out, so a
+// requestor that stops reading or goes away is dropped when the timerfd
+// fires instead of being served forever. A requestor's window is watched
+// for PropertyNotify while any transfer to it runs, and its event mask is
+// cleared again when the last one ends.
+class SelectionOwner
+{
+public:
+    ~SelectionOwner();
+
+    // False if the transfer timer could not be created; transfers then
+    // only end when the requestor finishes them
+    bool init(Display* display, Window window, Atom selection, std::chrono::milliseconds timeout);
+    void shutdown();
+
+    // Takes ownership at the given server time (the event that caused the
+    // copy, per ICCCM). False if another client kept the selection.
+    bool own(const std::string& content, Time time);
+    bool ownBlob(Atom target, BlobMapping&& blob, Time time);
+    // Text kept in the blob store, offered as the text targets above
+    bool ownText(BlobMapping&& text, Time time);
+    bool owns() const { return m_owned; }
+
+    // Handles SelectionRequest/SelectionClear for our window and the
+    // PropertyNotify events of running INCR transfers. True if consumed.
+    bool handleEvent(const XEvent& event);
+
+    // Readable when the earliest transfer deadline has passed
+    int timerFd() const { return m_timerFd; }
+    // Clears the timer and drops the stalled transfers; how many there were
+    size_t expire();
+
+private:
+    struct IncrTransfer
+    {
+        Window requestor;
+        Atom property;
+        Atom target;
+        size_t offset;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void answerRequest(const XSelectionRequestEvent& request);
+    bool sendData(Window requestor, Atom property, Atom target);
+    void continueTransfer(const XPropertyEvent& event);
+    bool takeOwnership(Time time);
+    // Stops watching the requestor if no other transfer goes to it; the
+    // transfer after it
+    std::vector<IncrTransfer>::iterator endTransfer(std::vector<IncrTransfer>::iterator transfer);
+    void endAllTransfers();
+    void armTimer();
+    void clearTimer();
+
+    const char* data() const { return m_blob.valid() ? m_blob.data() : m_content.data(); }
+    size_t size() const { return m_blob.valid() ? m_blob.size() : m_content.size(); }
+
+    Display* m_display { nullptr };
+    Window m_window { 0 };
+    Atom m_selection { None };
+    Atom m_targetsAtom { None };
+    Atom m_timestampAtom { None };
+    Atom m_utf8Atom { None };
+    Atom m_incrAtom { None };
+    size_t m_maxChunk { 0 };
+    std::chrono::milliseconds m_timeout { 0 };
+    int m_timerFd { -1 };
+
+    bool m_owned { false };
+    Time m_ownedSince { CurrentTime };
+    std::string m_content;
+    BlobMapping m_blob;
+    Atom m_blobTarget { None };
+    std::vector<IncrTransfer> m_transfers;
+    // Running transfers per requestor window
+    std::unordered_map<Window, size_t> m_watched;
+};
+
+#endif
+
+#endif
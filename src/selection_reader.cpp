@@ -0,0 +1,343 @@
+#include "selection_reader.h"
+#include "utils.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef MMRY_XCB
+#include <cstdlib>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#endif
+
+namespace
+{
+    // Property data is fetched in pieces of this many 32-bit units (256 KiB)
+    const long READ_CHUNK_UNITS = 64 * 1024;
+
+    // A buffer that grew past this for one large clip is given back afterwards
+    const size_t KEEP_CAPACITY = 1 << 20;
+
+    // The most reserved up front for a size an owner announced; anything
+    // beyond grows with the data that actually arrives
+    const size_t RESERVE_CEILING = READ_CHUNK_UNITS * 4;
+}
+
+void SelectionReader::init(Display* display, Window window, Atom selection, Atom property)
+{
+    m_display = display;
+    m_window = window;
+    m_selection = selection;
+    m_property = property;
+    m_incrAtom = XInternAtom(display, "INCR", False);
+#ifdef MMRY_XCB
+    // Replies still owed to a slot's previous, timed-out request
+    if (m_xcb)
+    {
+        discardReplies();
+    }
+#endif
+}
+
+SelectionReader::Result SelectionReader::handleEvent(const XEvent& event)
+{
+    if (event.type == SelectionNotify && event.xselection.requestor == m_window &&
+        event.xselection.selection == m_selection)
+    {
+        reset();
+        m_target = event.xselection.target;
+        if (event.xselection.property == None)
+        {
+            return Result::Failed;
+        }
+#ifdef MMRY_XCB
+        if (m_xcb)
+        {
+            return requestProperty(false);
+        }
+#endif
+        return readProperty(false);
+    }
+
+    if (event.type == PropertyNotify && m_incrActive &&
+        event.xproperty.window == m_window && event.xproperty.atom == m_property &&
+        event.xproperty.state == PropertyNewValue)
+    {
+#ifdef MMRY_XCB
+        if (m_xcb)
+        {
+            return requestProperty(true);
+        }
+#endif
+        return readProperty(true);
+    }
+
+    return Result::Ignored;
+}
+
+SelectionReader::Result SelectionReader::readProperty(bool incrChunk)
+{
+    size_t chunkBytes = 0;
+    long offset = 0;
+
+    for (;;)
+    {
+        Atom type = None;
+        int format = 0;
+        unsigned long nitems = 0;
+        unsigned long bytesAfter = 0;
+        unsigned char* data = nullptr;
+
+        if (XGetWindowProperty(m_display, m_window, m_property, offset, READ_CHUNK_UNITS, False, AnyPropertyType,
+                               &type, &format, &nitems, &bytesAfter, &data) != Success)
+        {
+            m_incrActive = false;
+            return Result::Failed;
+        }
+
+        // The owner switched to INCR: the property holds a size hint, and
+        // deleting it asks for the first piece
+        if (!incrChunk && offset == 0 && type == m_incrAtom)
+        {
+            if (data && nitems > 0)
+            {
+                size_t hint = static_cast<size_t>(*reinterpret_cast<long*>(data));
+                reserveFor(hint);
+            }
+            if (data)
+            {
+                XFree(data);
+            }
+            m_incrActive = true;
+            XDeleteProperty(m_display, m_window, m_property);
+            XFlush(m_display);
+            return Result::Pending;
+        }
+
+        if (offset == 0 && !incrChunk)
+        {
+            size_t expected = nitems + bytesAfter;
+            reserveFor(expected);
+        }
+
+        if (data)
+        {
+            // Xlib hands format 32 items (atom lists) over as longs
+            size_t itemSize = format == 32 ? sizeof(long) : format == 16 ? sizeof(short) : 1;
+            append(reinterpret_cast<const char*>(data), nitems * itemSize);
+            chunkBytes += nitems * itemSize;
+            XFree(data);
+        }
+
+        if (bytesAfter == 0)
+        {
+            break;
+        }
+        offset += READ_CHUNK_UNITS;
+    }
+
+    // For INCR this also tells the owner to send the next piece
+    XDeleteProperty(m_display, m_window, m_property);
+    XFlush(m_display);
+
+    if (incrChunk && chunkBytes > 0)
+    {
+        return Result::Pending;
+    }
+    m_incrActive = false;
+    return Result::Complete;
+}
+
+#ifdef MMRY_XCB
+
+SelectionReader::Result SelectionReader::requestProperty(bool incrChunk)
+{
+    discardReplies();
+    m_piecesIncr = incrChunk;
+    m_firstPiece = true;
+    m_chunkBytes = 0;
+    // Only the first piece is asked for blind; its bytes_after tells how
+    // many more to send in one go
+    requestPiece(0);
+    xcb_flush(m_xcb);
+    return Result::Pending;
+}
+
+void SelectionReader::requestPiece(long offset)
+{
+    xcb_get_property_cookie_t cookie = xcb_get_property(m_xcb, 0, static_cast<xcb_window_t>(m_window),
+                                                        static_cast<xcb_atom_t>(m_property), XCB_GET_PROPERTY_TYPE_ANY,
+                                                        static_cast<uint32_t>(offset), READ_CHUNK_UNITS);
+    m_pieces.push_back(cookie.sequence);
+}
+
+SelectionReader::Result SelectionReader::pollReplies()
+{
+    while (!m_pieces.empty())
+    {
+        void* raw = nullptr;
+        xcb_generic_error_t* error = nullptr;
+        if (!xcb_poll_for_reply(m_xcb, m_pieces.front(), &raw, &error))
+        {
+            return Result::Pending;
+        }
+        m_pieces.pop_front();
+
+        xcb_get_property_reply_t* reply = static_cast<xcb_get_property_reply_t*>(raw);
+        if (error || !reply)
+        {
+            std::free(error);
+            std::free(reply);
+            discardReplies();
+            m_incrActive = false;
+            return Result::Failed;
+        }
+
+        const char* data = static_cast<const char*>(xcb_get_property_value(reply));
+        size_t nitems = reply->value_len;
+
+        if (m_firstPiece)
+        {
+            m_firstPiece = false;
+
+            if (!m_piecesIncr && reply->type == m_incrAtom)
+            {
+                if (nitems > 0)
+                {
+                    size_t hint = *reinterpret_cast<const uint32_t*>(data);
+                    reserveFor(hint);
+                }
+                std::free(reply);
+                m_incrActive = true;
+                xcb_delete_property(m_xcb, static_cast<xcb_window_t>(m_window), static_cast<xcb_atom_t>(m_property));
+                xcb_flush(m_xcb);
+                return Result::Pending;
+            }
+
+            if (!m_piecesIncr)
+            {
+                size_t expected = nitems * (reply->format / 8) + reply->bytes_after;
+                reserveFor(expected);
+            }
+
+            // Everything past the first piece is requested at once and
+            // streams back while the loop does other work
+            long units = static_cast<long>((reply->bytes_after + 3) / 4);
+            for (long offset = READ_CHUNK_UNITS; offset < READ_CHUNK_UNITS + units; offset += READ_CHUNK_UNITS)
+            {
+                requestPiece(offset);
+            }
+            if (!m_pieces.empty())
+            {
+                xcb_flush(m_xcb);
+            }
+        }
+
+        if (reply->format == 32)
+        {
+            // XCB delivers 32-bit items; widen them to the longs Xlib would
+            // have returned so content() reads the same either way
+            const uint32_t* items = reinterpret_cast<const uint32_t*>(data);
+            for (size_t i = 0; i < nitems; ++i)
+            {
+                long item = static_cast<long>(items[i]);
+                append(reinterpret_cast<const char*>(&item), sizeof(item));
+            }
+            m_chunkBytes += nitems * sizeof(long);
+        }
+        else
+        {
+            size_t itemSize = reply->format == 16 ? sizeof(short) : 1;
+            append(data, nitems * itemSize);
+            m_chunkBytes += nitems * itemSize;
+        }
+        std::free(reply);
+    }
+
+    return finishProperty();
+}
+
+SelectionReader::Result SelectionReader::finishProperty()
+{
+    // For INCR this also tells the owner to send the next piece
+    xcb_delete_property(m_xcb, static_cast<xcb_window_t>(m_window), static_cast<xcb_atom_t>(m_property));
+    xcb_flush(m_xcb);
+
+    if (m_piecesIncr && m_chunkBytes > 0)
+    {
+        return Result::Pending;
+    }
+    m_incrActive = false;
+    return Result::Complete;
+}
+
+void SelectionReader::discardReplies()
+{
+    for (unsigned int sequence : m_pieces)
+    {
+        xcb_discard_reply(m_xcb, sequence);
+    }
+    m_pieces.clear();
+}
+
+#endif
+
+void SelectionReader::reserveFor(size_t announced)
+{
+    size_t limit = m_maxSize > 0 ? std::min(m_maxSize, RESERVE_CEILING) : RESERVE_CEILING;
+    m_buffer.reserve(std::min(announced, limit));
+}
+
+void SelectionReader::append(const char* data, size_t length)
+{
+    m_hash = fnv1a64(data, length, m_hash);
+    m_totalSize += length;
+
+    size_t room = length;
+    if (m_maxSize > 0)
+    {
+        room = m_buffer.size() < m_maxSize ? std::min(length, m_maxSize - m_buffer.size()) : 0;
+    }
+    m_buffer.append(data, room);
+}
+
+void SelectionReader::reset()
+{
+    if (m_buffer.capacity() > KEEP_CAPACITY)
+    {
+        std::string().swap(m_buffer);
+    }
+    m_buffer.clear();
+    m_totalSize = 0;
+    m_hash = FNV1A64_OFFSET;
+    m_incrActive = false;
+}
+
+std::string SelectionReader::truncationMarker() const
+{
+    char marker[96];
+    int length = std::snprintf(marker, sizeof(marker), "\n[truncated: %zu bytes, fnv1a %016llx]",
+                               m_totalSize, static_cast<unsigned long long>(m_hash));
+    return std::string(marker, length);
+}
+
+std::string SelectionReader::truncatedRecord() const
+{
+    return m_buffer + truncationMarker();
+}
+
+std::string SelectionReader::takeContent()
+{
+    if (truncated())
+    {
+        m_buffer += truncationMarker();
+    }
+    std::string content = std::move(m_buffer);
+    m_buffer.clear();
+    m_totalSize = 0;
+    return content;
+}
+
+#endif
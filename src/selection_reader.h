@@ -0,0 +1,98 @@
+#ifndef SELECTION_READER_H
+#define SELECTION_READER_H
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+#include <cstdint>
+#include <string>
+
+#ifdef MMRY_XCB
+#include <deque>
+struct xcb_connection_t;
+#endif
+
+// Receives a converted selection from the property it was delivered to.
+// Plain replies are read in bounded chunks; INCR replies are followed
+// through PropertyNotify until the owner sends the zero-length piece.
+//
+// At most maxSize bytes are kept. Anything past that is still drained (so
+// the owner can finish) and folded into a running hash of the whole
+// payload, which truncatedRecord() turns into a stable history entry.
+class SelectionReader
+{
+public:
+    enum class Result
+    {
+        Ignored,    // not an event of ours
+        Pending,    // transfer still running
+        Complete,   // content() holds the data (format 32 items as longs)
+        Failed      // the owner refused the target
+    };
+
+    void init(Display* display, Window window, Atom selection, Atom property);
+    void setMaxSize(size_t maxSize) { m_maxSize = maxSize; }
+
+    Result handleEvent(const XEvent& event);
+
+#ifdef MMRY_XCB
+    // With a connection set, properties are read through GetProperty
+    // cookies: handleEvent() only sends the requests and returns Pending,
+    // and pollReplies() finishes the read once the replies are in
+    void setConnection(xcb_connection_t* connection) { m_xcb = connection; }
+    bool awaitingReplies() const { return !m_pieces.empty(); }
+    Result pollReplies();
+#endif
+
+    Atom target() const { return m_target; }
+    const std::string& content() const { return m_buffer; }
+    bool truncated() const { return m_totalSize > m_buffer.size(); }
+    size_t totalSize() const { return m_totalSize; }
+
+    // The kept prefix followed by a marker line with the full size and hash
+    std::string truncatedRecord() const;
+
+    // Moves the received data out, as truncatedRecord() when truncated.
+    // The reader starts from an empty buffer on the next transfer.
+    std::string takeContent();
+
+private:
+    Result readProperty(bool incrChunk);
+#ifdef MMRY_XCB
+    Result requestProperty(bool incrChunk);
+    void requestPiece(long offset);
+    Result finishProperty();
+    void discardReplies();
+#endif
+    // Room for a size the owner announced, which is not trusted
+    void reserveFor(size_t announced);
+    void append(const char* data, size_t length);
+    void reset();
+    std::string truncationMarker() const;
+
+    Display* m_display { nullptr };
+    Window m_window { 0 };
+    Atom m_selection { None };
+    Atom m_property { None };
+    Atom m_incrAtom { None };
+    size_t m_maxSize { 0 };
+
+    bool m_incrActive { false };
+    Atom m_target { None };
+    std::string m_buffer;
+    size_t m_totalSize { 0 };
+    uint64_t m_hash { 0 };
+
+#ifdef MMRY_XCB
+    xcb_connection_t* m_xcb { nullptr };
+    // Sequence numbers of the outstanding GetProperty requests, by offset
+    std::deque<unsigned int> m_pieces;
+    bool m_piecesIncr { false };
+    bool m_firstPiece { false };
+    size_t m_chunkBytes { 0 };
+#endif
+};
+
+#endif
+
+#endif
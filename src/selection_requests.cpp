@@ -0,0 +1,186 @@
+#include "selection_requests.h"
+
+#ifdef __linux__
+
+#include <cstdio>
+#include <cstdint>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+SelectionRequests::~SelectionRequests()
+{
+    shutdown();
+}
+
+bool SelectionRequests::init(Display* display, Window window, std::chrono::milliseconds timeout)
+{
+    m_display = display;
+    m_window = window;
+    m_timeout = timeout;
+
+    // All sixteen names go out in a single round trip
+    char names[PROPERTIES][32];
+    char* namePointers[PROPERTIES];
+    for (size_t i = 0; i < PROPERTIES; ++i)
+    {
+        std::snprintf(names[i], sizeof(names[i]), "MMRY_SELECTION_%zu", i);
+        namePointers[i] = names[i];
+    }
+    XInternAtoms(display, namePointers, static_cast<int>(PROPERTIES), False, m_properties.data());
+
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    return m_timerFd >= 0;
+}
+
+void SelectionRequests::shutdown()
+{
+    if (m_timerFd >= 0)
+    {
+        close(m_timerFd);
+        m_timerFd = -1;
+    }
+    for (Request& request : m_requests)
+    {
+        request.active = false;
+    }
+}
+
+bool SelectionRequests::full() const
+{
+    for (const Request& request : m_requests)
+    {
+        if (!request.active)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+SelectionRequests::Request* SelectionRequests::start(Atom selection, Time ownerTime, unsigned long generation,
+                                                     Atom target, size_t maxSize)
+{
+    for (Request& request : m_requests)
+    {
+        if (request.active)
+        {
+            continue;
+        }
+
+        request.active = true;
+        request.selection = selection;
+        request.ownerTime = ownerTime;
+        request.generation = generation;
+        request.property = m_properties[m_nextProperty];
+        m_nextProperty = (m_nextProperty + 1) % PROPERTIES;
+#ifdef MMRY_XCB
+        request.reader.setConnection(m_xcb);
+#endif
+        request.reader.init(m_display, m_window, selection, request.property);
+
+        // Whatever a timed-out owner left behind must not look like a reply
+        XDeleteProperty(m_display, m_window, request.property);
+        send(request, target, maxSize);
+        return &request;
+    }
+    return nullptr;
+}
+
+void SelectionRequests::retarget(Request& request, Atom target, size_t maxSize)
+{
+    send(request, target, maxSize);
+}
+
+void SelectionRequests::send(Request& request, Atom target, size_t maxSize)
+{
+    request.reader.setMaxSize(maxSize);
+    request.deadline = std::chrono::steady_clock::now() + m_timeout;
+    XConvertSelection(m_display, request.selection, target, request.property, m_window, request.ownerTime);
+    XFlush(m_display);
+    armTimer();
+}
+
+void SelectionRequests::extend(Request& request)
+{
+    // Only ever later, so the armed timer at worst fires early and
+    // expire() arms it again
+    request.deadline = std::chrono::steady_clock::now() + m_timeout;
+}
+
+void SelectionRequests::finish(Request& request)
+{
+    request.active = false;
+}
+
+SelectionRequests::Request* SelectionRequests::match(const XEvent& event)
+{
+    for (Request& request : m_requests)
+    {
+        if (!request.active)
+        {
+            continue;
+        }
+        if (event.type == SelectionNotify)
+        {
+            const XSelectionEvent& reply = event.xselection;
+            if (reply.requestor != m_window || reply.selection != request.selection)
+            {
+                continue;
+            }
+            // A refusal carries no property, only the request's timestamp
+            if (reply.property == request.property ||
+                (reply.property == None && reply.time == request.ownerTime))
+            {
+                return &request;
+            }
+        }
+        else if (event.type == PropertyNotify)
+        {
+            if (event.xproperty.window == m_window && event.xproperty.atom == request.property)
+            {
+                return &request;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void SelectionRequests::armTimer()
+{
+    if (m_timerFd < 0)
+    {
+        return;
+    }
+
+    bool any = false;
+    std::chrono::steady_clock::time_point earliest;
+    for (const Request& request : m_requests)
+    {
+        if (request.active && (!any || request.deadline < earliest))
+        {
+            earliest = request.deadline;
+            any = true;
+        }
+    }
+
+    itimerspec spec {};
+    if (any)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(earliest - std::chrono::steady_clock::now());
+        // A zero value would disarm the timer; an overdue deadline fires at once
+        long long ns = remaining.count() > 0 ? remaining.count() : 1;
+        spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000LL);
+        spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000LL);
+    }
+    timerfd_settime(m_timerFd, 0, &spec, nullptr);
+}
+
+void SelectionRequests::clearTimer()
+{
+    uint64_t expirations;
+    while (read(m_timerFd, &expirations, sizeof(expirations)) == sizeof(expirations))
+    {
+    }
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SELECTION_REQUESTS_H
+#define SELECTION_REQUESTS_H
+
+#ifdef __linux__
+
+#include "selection_reader.h"
+#include <X11/Xlib.h>
+#include <array>
+#include <chrono>
+#include <vector>
+
+// Outstanding selection conversions. Every request is keyed by its
+// selection and the owner's timestamp, gets a property atom of its own,
+// and carries a deadline. Replies therefore cannot be mixed up even with
+// several transfers in flight, and an owner that never answers only costs
+// its slot until the timerfd fires.
+class SelectionRequests
+{
+public:
+    struct Request
+    {
+        Atom selection { None };
+        Atom property { None };
+        Time ownerTime { CurrentTime };
+        unsigned long generation { 0 };
+        std::chrono::steady_clock::time_point deadline;
+        SelectionReader reader;
+        bool active { false };
+    };
+
+    ~SelectionRequests();
+
+    bool init(Display* display, Window window, std::chrono::milliseconds timeout);
+    void shutdown();
+#ifdef MMRY_XCB
+    // Readers of later requests read their properties over this connection
+    void setConnection(xcb_connection_t* connection) { m_xcb = connection; }
+#endif
+
+    // Sends the conversion; nullptr when every slot is taken
+    Request* start(Atom selection, Time ownerTime, unsigned long generation, Atom target, size_t maxSize);
+    // Asks the same owner for another target (TARGETS, then the data)
+    void retarget(Request& request, Atom target, size_t maxSize);
+    // Restarts the request's timeout, as each INCR piece arrives, so that
+    // it measures a stalled transfer rather than a long one
+    void extend(Request& request);
+    void finish(Request& request);
+
+    bool full() const;
+
+    // The request an event belongs to, or nullptr
+    Request* match(const XEvent& event);
+
+    template <typename F>
+    void forEachActive(F fn)
+    {
+        for (Request& request : m_requests)
+        {
+            if (request.active)
+            {
+                fn(request);
+            }
+        }
+    }
+
+    // Readable when the earliest deadline has passed
+    int timerFd() const { return m_timerFd; }
+    // Clears the timer, frees every expired request and hands it to onExpired first
+    template <typename F>
+    void expire(F onExpired)
+    {
+        clearTimer();
+        auto now = std::chrono::steady_clock::now();
+        for (Request& request : m_requests)
+        {
+            if (request.active && request.deadline <= now)
+            {
+                onExpired(request);
+                finish(request);
+            }
+        }
+        armTimer();
+    }
+
+private:
+    static const size_t SLOTS = 4;
+    // More atoms than slots, so an owner still writing to a timed-out
+    // property does not feed the next request
+    static const size_t PROPERTIES = 16;
+
+    void send(Request& request, Atom target, size_t maxSize);
+    void armTimer();
+    void clearTimer();
+
+    Display* m_display { nullptr };
+    Window m_window { 0 };
+    std::chrono::milliseconds m_timeout { 0 };
+    int m_timerFd { -1 };
+#ifdef MMRY_XCB
+    xcb_connection_t* m_xcb { nullptr };
+#endif
+
+    std::array<Atom, PROPERTIES> m_properties {};
+    size_t m_nextProperty { 0 };
+    std::array<Request, SLOTS> m_requests;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,321 @@
+#include "shm_renderer.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <string>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace
+{
+    bool shmAttachFailed = false;
+
+    int catchShmAttachError(Display* /*d*/, XErrorEvent* /*e*/)
+    {
+        shmAttachFailed = true;
+        return 0;
+    }
+
+    // Shared memory only works when the server runs on this machine
+    bool isLocalDisplay(Display* display)
+    {
+        std::string name = DisplayString(display);
+        return !name.empty() && (name[0] == ':' || name.compare(0, 5, "unix:") == 0);
+    }
+}
+
+ShmRenderer::~ShmRenderer()
+{
+    shutdown();
+}
+
+bool ShmRenderer::init(Display* display, int screen, XFontStruct* font)
+{
+    shutdown();
+
+    if (!display || !font)
+    {
+        return false;
+    }
+    if (!XShmQueryExtension(display) || !isLocalDisplay(display))
+    {
+        return false;
+    }
+
+    Visual* visual = DefaultVisual(display, screen);
+    if (visual->c_class != TrueColor || DefaultDepth(display, screen) < 24)
+    {
+        return false;
+    }
+
+    m_display = display;
+    m_screen = screen;
+    m_font = font;
+    m_atlas = &atlasFor(font);
+
+    // Probe with a small image; the attach is what fails on remote servers
+    if (!createImage(1, 1))
+    {
+        m_atlases.clear();
+        m_atlas = nullptr;
+        m_display = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void ShmRenderer::shutdown()
+{
+    if (!m_display)
+    {
+        return;
+    }
+    destroyImage();
+    m_atlases.clear();
+    m_atlas = nullptr;
+    m_display = nullptr;
+}
+
+bool ShmRenderer::resize(int width, int height)
+{
+    if (!m_display)
+    {
+        return false;
+    }
+    if (m_image && m_image->width == width && m_image->height == height)
+    {
+        return true;
+    }
+    destroyImage();
+    return createImage(width, height);
+}
+
+bool ShmRenderer::createImage(int width, int height)
+{
+    m_image = XShmCreateImage(m_display, DefaultVisual(m_display, m_screen), DefaultDepth(m_display, m_screen),
+                              ZPixmap, nullptr, &m_shmInfo, width, height);
+    if (!m_image)
+    {
+        return false;
+    }
+    if (m_image->bits_per_pixel != 32)
+    {
+        XDestroyImage(m_image);
+        m_image = nullptr;
+        return false;
+    }
+
+    m_shmInfo.shmid = shmget(IPC_PRIVATE, m_image->bytes_per_line * m_image->height, IPC_CREAT | 0600);
+    if (m_shmInfo.shmid < 0)
+    {
+        XDestroyImage(m_image);
+        m_image = nullptr;
+        return false;
+    }
+    void* address = shmat(m_shmInfo.shmid, nullptr, 0);
+    if (address == reinterpret_cast<void*>(-1))
+    {
+        // Out of address space or segments; the core-protocol painter takes over
+        shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+        XDestroyImage(m_image);
+        m_image = nullptr;
+        return false;
+    }
+    m_shmInfo.shmaddr = m_image->data = static_cast<char*>(address);
+    m_shmInfo.readOnly = False;
+
+    shmAttachFailed = false;
+    XErrorHandler oldHandler = XSetErrorHandler(catchShmAttachError);
+    XShmAttach(m_display, &m_shmInfo);
+    XSync(m_display, False);
+    XSetErrorHandler(oldHandler);
+
+    // The segment goes away with its last user, even if we crash
+    shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+
+    if (shmAttachFailed)
+    {
+        shmdt(m_shmInfo.shmaddr);
+        m_image->data = nullptr;
+        XDestroyImage(m_image);
+        m_image = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void ShmRenderer::destroyImage()
+{
+    if (!m_image)
+    {
+        return;
+    }
+    waitForPendingPut();
+    XShmDetach(m_display, &m_shmInfo);
+    XSync(m_display, False);
+    shmdt(m_shmInfo.shmaddr);
+    m_image->data = nullptr;
+    XDestroyImage(m_image);
+    m_image = nullptr;
+}
+
+// The server reads the segment asynchronously, so it must be done with the
+// previous frame before we draw over it. Frames are far apart, so this is
+// almost always free.
+void ShmRenderer::waitForPendingPut()
+{
+    if (m_putPending)
+    {
+        XSync(m_display, False);
+        m_putPending = false;
+    }
+}
+
+const ShmRenderer::GlyphAtlas& ShmRenderer::atlasFor(XFontStruct* font)
+{
+    auto found = m_atlases.find(font->fid);
+    if (found != m_atlases.end())
+    {
+        return found->second;
+    }
+
+    GlyphAtlas& atlas = m_atlases[font->fid];
+    atlas.ascent = font->ascent;
+    atlas.height = font->ascent + font->descent;
+    atlas.originX = std::max(0, -static_cast<int>(font->min_bounds.lbearing));
+    atlas.cellWidth = atlas.originX + std::max<int>(font->max_bounds.rbearing, font->max_bounds.width);
+
+    for (int c = 0; c < 256; ++c)
+    {
+        unsigned int byte2 = static_cast<unsigned int>(c);
+        bool inRange = byte2 >= font->min_char_or_byte2 && byte2 <= font->max_char_or_byte2;
+        atlas.present[c] = inRange && c >= 32 && c != 127;
+    }
+    loadFontMetrics(font, atlas.metrics);
+
+    // Let the server rasterize every glyph once into a 1-bit pixmap, then
+    // keep the pixels client-side
+    int atlasWidth = atlas.cellWidth * 256;
+    Window rootWindow = RootWindow(m_display, m_screen);
+    Pixmap pixmap = XCreatePixmap(m_display, rootWindow, atlasWidth, atlas.height, 1);
+    GC gc = XCreateGC(m_display, pixmap, 0, nullptr);
+    XSetFont(m_display, gc, font->fid);
+    XSetForeground(m_display, gc, 0);
+    XFillRectangle(m_display, pixmap, gc, 0, 0, atlasWidth, atlas.height);
+    XSetForeground(m_display, gc, 1);
+    for (int c = 0; c < 256; ++c)
+    {
+        if (atlas.present[c])
+        {
+            char ch = static_cast<char>(c);
+            XDrawString(m_display, pixmap, gc, c * atlas.cellWidth + atlas.originX, atlas.ascent, &ch, 1);
+        }
+    }
+
+    XImage* image = XGetImage(m_display, pixmap, 0, 0, atlasWidth, atlas.height, 1, ZPixmap);
+    atlas.coverage.assign(static_cast<size_t>(atlasWidth) * atlas.height, 0);
+    if (image)
+    {
+        for (int y = 0; y < atlas.height; ++y)
+        {
+            for (int x = 0; x < atlasWidth; ++x)
+            {
+                atlas.coverage[static_cast<size_t>(y) * atlasWidth + x] = XGetPixel(image, x, y) ? 1 : 0;
+            }
+        }
+        XDestroyImage(image);
+    }
+
+    XFreeGC(m_display, gc);
+    XFreePixmap(m_display, pixmap);
+
+    return atlas;
+}
+
+void ShmRenderer::clear(unsigned long pixel)
+{
+    if (!m_image)
+    {
+        return;
+    }
+    waitForPendingPut();
+    fillRect(0, 0, m_image->width, m_image->height, pixel);
+}
+
+void ShmRenderer::fillRect(int x, int y, int width, int height, unsigned long pixel)
+{
+    if (!m_image)
+    {
+        return;
+    }
+    waitForPendingPut();
+
+    int x0 = std::max(0, x);
+    int y0 = std::max(0, y);
+    int x1 = std::min(m_image->width, x + width);
+    int y1 = std::min(m_image->height, y + height);
+    uint32_t value = static_cast<uint32_t>(pixel);
+
+    for (int row = y0; row < y1; ++row)
+    {
+        uint32_t* line = reinterpret_cast<uint32_t*>(m_image->data + row * m_image->bytes_per_line);
+        std::fill(line + x0, line + std::max(x0, x1), value);
+    }
+}
+
+int ShmRenderer::drawText(int x, int y, const char* text, size_t length, unsigned long pixel)
+{
+    if (!m_image || !m_atlas)
+    {
+        return x;
+    }
+    waitForPendingPut();
+
+    const GlyphAtlas& atlas = *m_atlas;
+    const int atlasWidth = atlas.cellWidth * 256;
+    const int top = y - atlas.ascent;
+    const uint32_t value = static_cast<uint32_t>(pixel);
+
+    int penX = x;
+    for (size_t i = 0; i < length; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (atlas.present[c] && penX < m_image->width)
+        {
+            int cellX = penX - atlas.originX;
+            for (int row = 0; row < atlas.height; ++row)
+            {
+                int destY = top + row;
+                if (destY < 0 || destY >= m_image->height)
+                {
+                    continue;
+                }
+                const uint8_t* src = &atlas.coverage[static_cast<size_t>(row) * atlasWidth + c * atlas.cellWidth];
+                uint32_t* dest = reinterpret_cast<uint32_t*>(m_image->data + destY * m_image->bytes_per_line);
+                for (int col = 0; col < atlas.cellWidth; ++col)
+                {
+                    int destX = cellX + col;
+                    if (src[col] && destX >= 0 && destX < m_image->width)
+                    {
+                        dest[destX] = value;
+                    }
+                }
+            }
+        }
+        penX += atlas.metrics.advance[c];
+    }
+    return penX;
+}
+
+void ShmRenderer::present(Drawable target, GC gc)
+{
+    if (!m_image)
+    {
+        return;
+    }
+    XShmPutImage(m_display, target, gc, m_image, 0, 0, 0, 0, m_image->width, m_image->height, False);
+    m_putPending = true;
+}
+
+#endif
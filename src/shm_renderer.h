@@ -0,0 +1,72 @@
+#ifndef SHM_RENDERER_H
+#define SHM_RENDERER_H
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "ui.h"
+
+// Client-side renderer for the clip list. Text is composited from a glyph
+// atlas into a shared-memory XImage and handed to the server with a single
+// XShmPutImage, instead of one core-font request per string.
+//
+// init() fails (and the caller keeps the core X path) when MIT-SHM is not
+// usable: no extension, a remote display (e.g. over ssh), or a visual that
+// is not 32 bits per pixel.
+class ShmRenderer
+{
+public:
+    ~ShmRenderer();
+
+    bool init(Display* display, int screen, XFontStruct* font);
+    void shutdown();
+    bool isActive() const { return m_display != nullptr; }
+
+    // Makes sure the image matches the frame size; false if it could not
+    bool resize(int width, int height);
+
+    void clear(unsigned long pixel);
+    void fillRect(int x, int y, int width, int height, unsigned long pixel);
+    // Returns the pen position after the last glyph
+    int drawText(int x, int y, const char* text, size_t length, unsigned long pixel);
+
+    // Sends the frame to the drawable in one transfer
+    void present(Drawable target, GC gc);
+
+private:
+    // Coverage bitmap of every glyph of one font, one byte per pixel
+    struct GlyphAtlas
+    {
+        int cellWidth { 0 };
+        int height { 0 };
+        int ascent { 0 };
+        int originX { 0 };
+        FontMetrics metrics;
+        bool present[256] {};
+        std::vector<uint8_t> coverage;
+    };
+
+    const GlyphAtlas& atlasFor(XFontStruct* font);
+    bool createImage(int width, int height);
+    void destroyImage();
+    void waitForPendingPut();
+
+    Display* m_display { nullptr };
+    int m_screen { 0 };
+    XFontStruct* m_font { nullptr };
+    const GlyphAtlas* m_atlas { nullptr };
+    std::map<Font, GlyphAtlas> m_atlases;
+
+    XImage* m_image { nullptr };
+    XShmSegmentInfo m_shmInfo {};
+    bool m_putPending { false };
+};
+
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Fixed-size lock-free queue for exactly one producer thread and one
+// consumer thread. Elements are moved in and out, so a large buffer passes
+// through without being copied.
+//
+// One slot is kept free to tell "full" from "empty", so it holds
+// Capacity - 1 elements.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2, "SpscQueue needs room for at least one element");
+
+public:
+    // Producer side; false (and value untouched) when full
+    bool tryPush(T&& value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % Capacity;
+        if (next == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        m_slots[tail] = std::move(value);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when empty
+    bool tryPop(T& value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = std::move(m_slots[head]);
+        m_head.store((head + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> m_slots;
+
+    // Kept on separate cache lines so the two threads do not false-share
+    alignas(64) std::atomic<size_t> m_head { 0 };
+    alignas(64) std::atomic<size_t> m_tail { 0 };
+};
+
+#endif
@@ -2,28 +2,65 @@
 #define UI_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <utility>
 
+// Read-only view of consecutive elements owned by the caller. The draw calls
+// take these so a frame hands down only the rows on screen, without copying.
+template <typename T>
+class ItemView
+{
+public:
+    ItemView() = default;
+    ItemView(const T* data, size_t count) : m_data(data), m_count(count) {}
+    ItemView(const std::vector<T>& items) : m_data(items.data()), m_count(items.size()) {}
+
+    // Elements [first, first + count), clamped to this view
+    ItemView window(size_t first, size_t count) const
+    {
+        first = std::min(first, m_count);
+        return ItemView(m_data + first, std::min(count, m_count - first));
+    }
+
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_count; }
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    const T& operator[](size_t i) const { return m_data[i]; }
+
+private:
+    const T* m_data { nullptr };
+    size_t m_count { 0 };
+};
+
+// Rows the theme and config pickers show at once
+const size_t CONSOLE_SELECT_ROWS = 10;
+
+// Everything here is a view into state owned by the caller, which must stay
+// alive until drawConsole() returns. Lists hold only their visible window;
+// the *ScrollOffset fields give the index of its first row.
 struct ConsoleDrawData
 {
     bool filterMode;
     bool commandMode;
     bool themeSelectMode;
     bool configSelectMode;
-    std::string filterText;
-    std::string commandText;
+    std::string_view filterText;
+    std::string_view commandText;
 
-    std::vector<std::string> themeItems;
+    ItemView<std::string> themeItems;
+    size_t themeCount;
     size_t selectedTheme;
     size_t themeScrollOffset;
 
-    std::vector<std::string> configItems;
+    ItemView<std::string> configItems;
+    size_t configCount;
     size_t selectedConfig;
     size_t configScrollOffset;
 
-    std::vector<std::string> clipLines;
+    ItemView<std::string> clipLines;
     size_t selectedItem;
     size_t clipScrollOffset;
     size_t totalClipCount;
@@ -49,66 +86,107 @@ struct DialogDimensions
     int contentHeight;
 };
 
+// Advance width of every glyph of the UI font, measured once when the font
+// is loaded. Measuring a string is a sum over this table, with no round trip
+// to the display server.
+struct FontMetrics
+{
+    int advance[256] {};
+
+    int textWidth(const char* text, size_t length) const
+    {
+        int width = 0;
+        for (size_t i = 0; i < length; ++i) {
+            width += advance[static_cast<unsigned char>(text[i])];
+        }
+        return width;
+    }
+
+    int textWidth(const std::string& text) const
+    {
+        return textWidth(text.data(), text.length());
+    }
+};
+
 #ifdef __linux__
 #include <X11/Xlib.h>
+
+// One pre-created GC per theme colour, so drawing never has to switch
+// foregrounds. The colours are re-applied whenever the theme changes.
+struct ThemeGCs
+{
+    GC background { nullptr };
+    GC text { nullptr };
+    GC selection { nullptr };
+    GC border { nullptr };
+};
+
+void createThemeGCs(Display* display, Drawable drawable, XFontStruct* font, ThemeGCs& gcs);
+void setThemeGCColors(
+    Display* display, ThemeGCs& gcs,
+    unsigned long bgColor, unsigned long textColor,
+    unsigned long selColor, unsigned long borderColor);
+void freeThemeGCs(Display* display, ThemeGCs& gcs);
+void loadFontMetrics(XFontStruct* font, FontMetrics& metrics);
+
+// Rows the list dialogs show at once
+const size_t BOOKMARK_DIALOG_ROWS = 8;
+const size_t ADD_TO_BOOKMARK_DIALOG_ROWS = 10;
+const size_t VIEW_BOOKMARKS_DIALOG_ROWS = 15;
+
+// The list dialogs take only their visible rows; firstIndex is the index of
+// the first of them, so the selection can be matched up.
 void drawPinnedDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
-    const std::vector<std::pair<long long, std::string>>& displayItems,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    size_t& selectedItem, size_t scrollOffset, int& maxVisibleItems,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor,
+    ItemView<std::pair<long long, std::string>> visibleItems,
+    size_t firstIndex, size_t selectedItem,
     int lineHeight);
 
 void drawBookmarkDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    const std::string& inputText,
-    const std::vector<std::string>& filteredGroups,
-    size_t selectedGroup, size_t scrollOffset,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor);
+    std::string_view inputText,
+    ItemView<std::string_view> visibleGroups,
+    size_t firstIndex, size_t selectedGroup);
 
 void drawAddToBookmarkDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    const std::vector<std::string>& displayedGroups,
-    size_t selectedGroup, size_t scrollOffset,
-    bool filterMode, const std::string& filterText,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor);
+    ItemView<std::string_view> visibleGroups,
+    size_t firstIndex, size_t selectedGroup,
+    bool filterMode, std::string_view filterText);
 
 void drawViewBookmarksDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    const std::string& title,
-    const std::vector<std::string>& items,
-    size_t selectedItem, size_t scrollOffset,
-    bool filterActive, const std::string& filterText,
+    std::string_view title,
+    ItemView<std::string_view> visibleItems,
+    size_t firstIndex, size_t selectedItem,
+    bool filterActive, std::string_view filterText,
     int itemLineHeight,
-    const std::string& emptyMessage,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor);
+    std::string_view emptyMessage);
 
 void drawEditDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
     const std::string& inputText,
     size_t cursorLine, size_t cursorPos,
-    int scrollOffset,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long borderColor);
+    int scrollOffset);
 
 void drawHelpDialog(
-    Display* display, Window window, GC gc,
+    Display* display, Drawable drawable, const ThemeGCs& gcs,
     const DialogDimensions& dims,
     bool filterMode, const std::string& filterText,
-    int scrollOffset,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long borderColor);
+    int scrollOffset);
+
+void drawConsole(
+    Display* display, Drawable drawable, const ThemeGCs& gcs,
+    const ConsoleDrawData& data);
 
+class ShmRenderer;
 void drawConsole(
-    Display* display, Window window, GC gc,
+    Drawable drawable, const ThemeGCs& gcs, ShmRenderer& renderer,
     const ConsoleDrawData& data);
 #endif
 
@@ -1,231 +1,374 @@
 #include "ui.h"
 #include "help.h"
+#include "shm_renderer.h"
+#include <cstdio>
 #include <sstream>
 
 #ifdef __linux__
 
-void drawPinnedDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
-    const std::vector<std::pair<long long, std::string>>& displayItems,
-    const DialogDimensions& dims,
-    size_t& selectedItem,
-    size_t scrollOffset,
-    int& maxVisibleItems,
-    unsigned long bgColor,
-    unsigned long textColor,
-    unsigned long selColor,
-    unsigned long borderColor,
-    int lineHeight)
+namespace
 {
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-    XSetForeground(display, gc, borderColor);
-    XDrawRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
+    // ============================================================
+    // DrawBatch
+    // ============================================================
+
+    // Collects the primitives of one layer (the console or a dialog) and
+    // submits them grouped by GC: one XFillRectangles and one XDrawRectangles
+    // per colour, and one XDrawText per text line. Fills go out first, then
+    // outlines, then text, which matches how every layer is composed.
+    class DrawBatch
+    {
+    public:
+        void begin(Display* display, Drawable target)
+        {
+            m_display = display;
+            m_target = target;
+        }
 
-    std::string title = "Pinned Clips";
-    int titleWidth = XTextWidth(font, title.c_str(), title.length());
-    XDrawString(display, window, gc, dims.x + (dims.width - titleWidth) / 2, dims.y + 25, title.c_str(), title.length());
+        void fill(GC gc, int x, int y, int width, int height)
+        {
+            layerFor(gc).fills.push_back(makeRect(x, y, width, height));
+        }
 
-    int itemY = dims.y + 60;
-    int visibleCount = dims.contentHeight / lineHeight;
-    if (visibleCount < 1) visibleCount = 1;
-    maxVisibleItems = visibleCount;
+        void outline(GC gc, int x, int y, int width, int height)
+        {
+            layerFor(gc).outlines.push_back(makeRect(x, y, width, height));
+        }
+
+        void text(GC gc, int x, int y, std::string_view body)
+        {
+            text(gc, x, y, {}, body);
+        }
+
+        // The prefix ("> ", "  ", "/", ...) and suffix ("_") go out as their
+        // own text items, so callers never have to build a concatenated copy
+        // of the line.
+        void text(GC gc, int x, int y, std::string_view prefix, std::string_view body, std::string_view suffix = {})
+        {
+            TextRun run { gc, x, y, m_pieces.size(), 0 };
+
+            for (std::string_view part : { prefix, body, suffix }) {
+                if (!part.empty()) {
+                    m_pieces.push_back({ m_arena.size(), part.length() });
+                    m_arena.append(part);
+                    run.count++;
+                }
+            }
+
+            if (run.count > 0) {
+                m_runs.push_back(run);
+            }
+        }
+
+        void flush()
+        {
+            for (size_t i = 0; i < m_layerCount; ++i) {
+                Layer& layer = m_layers[i];
+                if (!layer.fills.empty()) {
+                    XFillRectangles(m_display, m_target, layer.gc, layer.fills.data(), layer.fills.size());
+                }
+            }
+            for (size_t i = 0; i < m_layerCount; ++i) {
+                Layer& layer = m_layers[i];
+                if (!layer.outlines.empty()) {
+                    XDrawRectangles(m_display, m_target, layer.gc, layer.outlines.data(), layer.outlines.size());
+                }
+            }
 
-    size_t startIdx = scrollOffset;
-    size_t endIdx = std::min(startIdx + visibleCount, displayItems.size());
+            // The arena may have grown while collecting, so the item pointers
+            // are only resolved now that it is stable.
+            m_items.clear();
+            for (const Piece& piece : m_pieces) {
+                XTextItem item;
+                item.chars = &m_arena[piece.offset];
+                item.nchars = piece.length;
+                item.delta = 0;
+                item.font = None;
+                m_items.push_back(item);
+            }
+            for (const TextRun& run : m_runs) {
+                XDrawText(m_display, m_target, run.gc, run.x, run.y, &m_items[run.first], run.count);
+            }
 
-    for (size_t i = startIdx; i < endIdx; ++i) {
-        std::string displayText = displayItems[i].second;
+            for (size_t i = 0; i < m_layerCount; ++i) {
+                m_layers[i].fills.clear();
+                m_layers[i].outlines.clear();
+            }
+            m_layerCount = 0;
+            m_runs.clear();
+            m_pieces.clear();
+            m_arena.clear();
+        }
+
+    private:
+        struct Layer
+        {
+            GC gc;
+            std::vector<XRectangle> fills;
+            std::vector<XRectangle> outlines;
+        };
+
+        struct Piece
+        {
+            size_t offset;
+            size_t length;
+        };
+
+        struct TextRun
+        {
+            GC gc;
+            int x;
+            int y;
+            size_t first;
+            int count;
+        };
+
+        static XRectangle makeRect(int x, int y, int width, int height)
+        {
+            XRectangle rect;
+            rect.x = static_cast<short>(x);
+            rect.y = static_cast<short>(y);
+            rect.width = static_cast<unsigned short>(std::max(0, width));
+            rect.height = static_cast<unsigned short>(std::max(0, height));
+            return rect;
+        }
 
-        if (i == selectedItem) {
-            displayText = "> " + displayText;
-            XSetForeground(display, gc, selColor);
-            XFillRectangle(display, window, gc, dims.x + 15, itemY - 12, dims.width - 30, 15);
-            XSetForeground(display, gc, textColor);
+        // Layers keep their vectors between frames so steady-state drawing
+        // reuses the same storage.
+        Layer& layerFor(GC gc)
+        {
+            for (size_t i = 0; i < m_layerCount; ++i) {
+                if (m_layers[i].gc == gc) {
+                    return m_layers[i];
+                }
+            }
+            if (m_layerCount == m_layers.size()) {
+                m_layers.emplace_back();
+            }
+            Layer& layer = m_layers[m_layerCount++];
+            layer.gc = gc;
+            return layer;
+        }
+
+        Display* m_display { nullptr };
+        Drawable m_target { 0 };
+        std::vector<Layer> m_layers;
+        size_t m_layerCount { 0 };
+        std::vector<TextRun> m_runs;
+        std::vector<Piece> m_pieces;
+        std::vector<XTextItem> m_items;
+        std::string m_arena;
+    };
+
+    DrawBatch batch;
+
+    void drawDialogFrame(const ThemeGCs& gcs, const DialogDimensions& dims)
+    {
+        batch.fill(gcs.background, dims.x, dims.y, dims.width, dims.height);
+        batch.outline(gcs.border, dims.x, dims.y, dims.width, dims.height);
+    }
+
+    void drawDialogTitle(const ThemeGCs& gcs, const FontMetrics& metrics, const DialogDimensions& dims, std::string_view title)
+    {
+        int titleWidth = metrics.textWidth(title.data(), title.length());
+        batch.text(gcs.border, dims.x + (dims.width - titleWidth) / 2, dims.y + 25, title);
+    }
+}
+
+void createThemeGCs(Display* display, Drawable drawable, XFontStruct* font, ThemeGCs& gcs)
+{
+    GC* slots[] = { &gcs.background, &gcs.text, &gcs.selection, &gcs.border };
+    for (GC* slot : slots) {
+        *slot = XCreateGC(display, drawable, 0, nullptr);
+        if (font) {
+            XSetFont(display, *slot, font->fid);
+        }
+    }
+}
+
+void loadFontMetrics(XFontStruct* font, FontMetrics& metrics)
+{
+    for (int c = 0; c < 256; ++c) {
+        if (!font) {
+            metrics.advance[c] = 8;
+            continue;
+        }
+        unsigned int byte2 = static_cast<unsigned int>(c);
+        if (font->per_char && byte2 >= font->min_char_or_byte2 && byte2 <= font->max_char_or_byte2) {
+            metrics.advance[c] = font->per_char[byte2 - font->min_char_or_byte2].width;
         } else {
-            XSetForeground(display, gc, selColor);
-            displayText = "  " + displayText;
+            metrics.advance[c] = font->max_bounds.width;
         }
+    }
+}
+
+void setThemeGCColors(
+    Display* display, ThemeGCs& gcs,
+    unsigned long bgColor, unsigned long textColor,
+    unsigned long selColor, unsigned long borderColor)
+{
+    if (!gcs.text) return;
+
+    XSetForeground(display, gcs.background, bgColor);
+    XSetForeground(display, gcs.text, textColor);
+    XSetForeground(display, gcs.selection, selColor);
+    XSetForeground(display, gcs.border, borderColor);
+}
 
-        XDrawString(display, window, gc, dims.x + 20, itemY, displayText.c_str(), displayText.length());
+void freeThemeGCs(Display* display, ThemeGCs& gcs)
+{
+    GC* slots[] = { &gcs.background, &gcs.text, &gcs.selection, &gcs.border };
+    for (GC* slot : slots) {
+        if (*slot) {
+            XFreeGC(display, *slot);
+            *slot = nullptr;
+        }
+    }
+}
+
+void drawPinnedDialog(
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
+    const DialogDimensions& dims,
+    ItemView<std::pair<long long, std::string>> visibleItems,
+    size_t firstIndex, size_t selectedItem,
+    int lineHeight)
+{
+    batch.begin(display, drawable);
+    drawDialogFrame(gcs, dims);
+    drawDialogTitle(gcs, metrics, dims, "Pinned Clips");
+
+    int itemY = dims.y + 60;
+
+    for (size_t i = 0; i < visibleItems.size(); ++i) {
+        if (firstIndex + i == selectedItem) {
+            batch.fill(gcs.selection, dims.x + 15, itemY - 12, dims.width - 30, 15);
+            batch.text(gcs.text, dims.x + 20, itemY, "> ", visibleItems[i].second);
+        } else {
+            batch.text(gcs.selection, dims.x + 20, itemY, "  ", visibleItems[i].second);
+        }
         itemY += lineHeight;
     }
 
-    if (displayItems.empty()) {
-        XDrawString(display, window, gc, dims.x + 20, itemY, "No pinned clips", 16);
+    if (visibleItems.empty()) {
+        batch.text(gcs.border, dims.x + 20, itemY, "No pinned clips");
     }
+
+    batch.flush();
 }
 
 void drawBookmarkDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    const std::string& inputText,
-    const std::vector<std::string>& filteredGroups,
-    size_t selectedGroup, size_t scrollOffset,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor)
+    std::string_view inputText,
+    ItemView<std::string_view> visibleGroups,
+    size_t firstIndex, size_t selectedGroup)
 {
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-    XSetForeground(display, gc, borderColor);
-    XDrawRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-
-    std::string title = "Bookmark Groups";
-    int titleWidth = XTextWidth(font, title.c_str(), title.length());
-    XDrawString(display, window, gc, dims.x + (dims.width - titleWidth) / 2, dims.y + 25, title.c_str(), title.length());
+    batch.begin(display, drawable);
+    drawDialogFrame(gcs, dims);
+    drawDialogTitle(gcs, metrics, dims, "Bookmark Groups");
 
-    XSetForeground(display, gc, textColor);
-    XDrawString(display, window, gc, dims.x + 20, dims.y + 60, "New group name:", 16);
+    batch.text(gcs.text, dims.x + 20, dims.y + 60, "New group name:");
 
-    XSetForeground(display, gc, selColor);
-    XFillRectangle(display, window, gc, dims.x + 20, dims.y + 70, dims.width - 40, 25);
-    XSetForeground(display, gc, textColor);
-    XDrawRectangle(display, window, gc, dims.x + 20, dims.y + 70, dims.width - 40, 25);
+    batch.fill(gcs.selection, dims.x + 20, dims.y + 70, dims.width - 40, 25);
+    batch.outline(gcs.text, dims.x + 20, dims.y + 70, dims.width - 40, 25);
 
-    std::string displayInput = inputText + "_";
-    XDrawString(display, window, gc, dims.x + 25, dims.y + 87, displayInput.c_str(), displayInput.length());
+    batch.text(gcs.text, dims.x + 25, dims.y + 87, {}, inputText, "_");
 
-    XSetForeground(display, gc, textColor);
-    XDrawString(display, window, gc, dims.x + 20, dims.y + 120, "Existing groups:", 15);
+    batch.text(gcs.text, dims.x + 20, dims.y + 120, "Existing groups:");
 
     int y = dims.y + 140;
-    const int VISIBLE_ITEMS = 8;
-
-    size_t startIdx = scrollOffset;
-    size_t endIdx = std::min(startIdx + VISIBLE_ITEMS, filteredGroups.size());
-
-    for (size_t i = startIdx; i < endIdx; ++i) {
-        std::string displayText = "  " + filteredGroups[i];
-        if (i == selectedGroup) {
-            displayText = "  " + filteredGroups[i];
-            XSetForeground(display, gc, selColor);
-            XFillRectangle(display, window, gc, dims.x + 15, y - 12, dims.width - 30, 15);
-            XSetForeground(display, gc, textColor);
+
+    for (size_t i = 0; i < visibleGroups.size(); ++i) {
+        if (firstIndex + i == selectedGroup) {
+            batch.fill(gcs.selection, dims.x + 15, y - 12, dims.width - 30, 15);
         }
-        XDrawString(display, window, gc, dims.x + 20, y, displayText.c_str(), displayText.length());
+        batch.text(gcs.text, dims.x + 20, y, "  ", visibleGroups[i]);
         y += 18;
     }
+
+    batch.flush();
 }
 
 void drawAddToBookmarkDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    const std::vector<std::string>& displayedGroups,
-    size_t selectedGroup, size_t scrollOffset,
-    bool filterMode, const std::string& filterText,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor)
+    ItemView<std::string_view> visibleGroups,
+    size_t firstIndex, size_t selectedGroup,
+    bool filterMode, std::string_view filterText)
 {
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-    XSetForeground(display, gc, borderColor);
-    XDrawRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-
-    std::string title = "Add to Bookmark Group";
-    int titleWidth = XTextWidth(font, title.c_str(), title.length());
-    XDrawString(display, window, gc, dims.x + (dims.width - titleWidth) / 2, dims.y + 25, title.c_str(), title.length());
-
-    XSetForeground(display, gc, textColor);
+    batch.begin(display, drawable);
+    drawDialogFrame(gcs, dims);
+    drawDialogTitle(gcs, metrics, dims, "Add to Bookmark Group");
 
     int y = dims.y + 50;
-    const int VISIBLE_ITEMS = 10;
-
-    size_t startIdx = scrollOffset;
-    size_t endIdx = std::min(startIdx + VISIBLE_ITEMS, displayedGroups.size());
-
-    for (size_t i = startIdx; i < endIdx; ++i) {
-        std::string displayText = "  " + displayedGroups[i];
-        if (i == selectedGroup) {
-            displayText = "> " + displayedGroups[i];
-            XSetForeground(display, gc, selColor);
-            XFillRectangle(display, window, gc, dims.x + 15, y - 12, dims.width - 30, 15);
-            XSetForeground(display, gc, textColor);
+
+    for (size_t i = 0; i < visibleGroups.size(); ++i) {
+        if (firstIndex + i == selectedGroup) {
+            batch.fill(gcs.selection, dims.x + 15, y - 12, dims.width - 30, 15);
+            batch.text(gcs.text, dims.x + 20, y, "> ", visibleGroups[i]);
+        } else {
+            batch.text(gcs.text, dims.x + 20, y, "  ", visibleGroups[i]);
         }
-        XDrawString(display, window, gc, dims.x + 20, y, displayText.c_str(), displayText.length());
         y += 18;
     }
 
     if (filterMode) {
-        std::string filterDisplay = "Filter: /" + filterText + "_";
-        XDrawString(display, window, gc, dims.x + 20, dims.y + dims.height - 20, filterDisplay.c_str(), filterDisplay.length());
+        batch.text(gcs.text, dims.x + 20, dims.y + dims.height - 20, "Filter: /", filterText, "_");
     }
+
+    batch.flush();
 }
 
 void drawViewBookmarksDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
-    const std::string& title,
-    const std::vector<std::string>& items,
-    size_t selectedItem, size_t scrollOffset,
-    bool filterActive, const std::string& filterText,
+    std::string_view title,
+    ItemView<std::string_view> visibleItems,
+    size_t firstIndex, size_t selectedItem,
+    bool filterActive, std::string_view filterText,
     int itemLineHeight,
-    const std::string& emptyMessage,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long selColor, unsigned long borderColor)
+    std::string_view emptyMessage)
 {
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-    XSetForeground(display, gc, borderColor);
-    XDrawRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
+    batch.begin(display, drawable);
+    drawDialogFrame(gcs, dims);
+    drawDialogTitle(gcs, metrics, dims, title);
 
-    int titleWidth = XTextWidth(font, title.c_str(), title.length());
-    XDrawString(display, window, gc, dims.x + (dims.width - titleWidth) / 2, dims.y + 25, title.c_str(), title.length());
-
-    XSetForeground(display, gc, textColor);
     int y = dims.y + 60;
 
-    if (items.empty() && !emptyMessage.empty()) {
-        XDrawString(display, window, gc, dims.x + 20, y, emptyMessage.c_str(), emptyMessage.length());
+    if (visibleItems.empty() && !emptyMessage.empty()) {
+        batch.text(gcs.text, dims.x + 20, y, emptyMessage);
     } else {
-        const int VISIBLE_ITEMS = 15;
-        size_t startIdx = scrollOffset;
-        size_t endIdx = std::min(startIdx + VISIBLE_ITEMS, items.size());
-
-        for (size_t i = startIdx; i < endIdx; ++i) {
-            std::string displayText = items[i];
-
-            if (i == selectedItem) {
-                displayText = "> " + displayText;
-                XSetForeground(display, gc, selColor);
-                XFillRectangle(display, window, gc, dims.x + 15, y - 12, dims.width - 30, 15);
-                XSetForeground(display, gc, textColor);
+        for (size_t i = 0; i < visibleItems.size(); ++i) {
+            if (firstIndex + i == selectedItem) {
+                batch.fill(gcs.selection, dims.x + 15, y - 12, dims.width - 30, 15);
+                batch.text(gcs.text, dims.x + 20, y, "> ", visibleItems[i]);
             } else {
-                displayText = "  " + displayText;
+                batch.text(gcs.text, dims.x + 20, y, "  ", visibleItems[i]);
             }
-
-            XDrawString(display, window, gc, dims.x + 20, y, displayText.c_str(), displayText.length());
             y += itemLineHeight;
         }
     }
 
     if (filterActive) {
-        std::string filterDisplay = "Filter: /" + filterText + "_";
-        XDrawString(display, window, gc, dims.x + 20, dims.y + dims.height - 20, filterDisplay.c_str(), filterDisplay.length());
+        batch.text(gcs.text, dims.x + 20, dims.y + dims.height - 20, "Filter: /", filterText, "_");
     }
+
+    batch.flush();
 }
 
 void drawEditDialog(
-    Display* display, Window window, GC gc, XFontStruct* font,
+    Display* display, Drawable drawable, const ThemeGCs& gcs, const FontMetrics& metrics,
     const DialogDimensions& dims,
     const std::string& inputText,
     size_t cursorLine, size_t cursorPos,
-    int scrollOffset,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long borderColor)
+    int scrollOffset)
 {
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-    XSetForeground(display, gc, borderColor);
-    XDrawRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
+    batch.begin(display, drawable);
+    drawDialogFrame(gcs, dims);
+    drawDialogTitle(gcs, metrics, dims, "Edit Clip (CTRL+ENTER to save, ESC to cancel)");
 
-    std::string title = "Edit Clip (CTRL+ENTER to save, ESC to cancel)";
-    int titleWidth = XTextWidth(font, title.c_str(), title.length());
-    XDrawString(display, window, gc, dims.x + (dims.width - titleWidth) / 2, dims.y + 25, title.c_str(), title.length());
-
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x + 20, dims.y + 50, dims.width - 40, dims.height - 70);
-    XSetForeground(display, gc, textColor);
-    XDrawRectangle(display, window, gc, dims.x + 20, dims.y + 50, dims.width - 40, dims.height - 70);
+    batch.fill(gcs.background, dims.x + 20, dims.y + 50, dims.width - 40, dims.height - 70);
+    batch.outline(gcs.text, dims.x + 20, dims.y + 50, dims.width - 40, dims.height - 70);
 
     const int lineHeight = 15;
     const int charWidth = 8;
@@ -284,26 +427,23 @@ void drawEditDialog(
                         }
                     }
                 }
-                XDrawString(display, window, gc, dims.x + 25, adjustedY, displayText.c_str(), displayText.length());
+                batch.text(gcs.text, dims.x + 25, adjustedY, displayText);
             }
         }
     }
+
+    batch.flush();
 }
 
 void drawHelpDialog(
-    Display* display, Window window, GC gc,
+    Display* display, Drawable drawable, const ThemeGCs& gcs,
     const DialogDimensions& dims,
     bool filterMode, const std::string& filterText,
-    int scrollOffset,
-    unsigned long bgColor, unsigned long textColor,
-    unsigned long borderColor)
+    int scrollOffset)
 {
-    XSetForeground(display, gc, bgColor);
-    XFillRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
-    XSetForeground(display, gc, borderColor);
-    XDrawRectangle(display, window, gc, dims.x, dims.y, dims.width, dims.height);
+    batch.begin(display, drawable);
+    drawDialogFrame(gcs, dims);
 
-    XSetForeground(display, gc, textColor);
     const int titleLeft = dims.x + 20;
     const int topicLeft = dims.x + 30;
     const int lineHeight = 15;
@@ -311,12 +451,12 @@ void drawHelpDialog(
 
     int inputY = dims.y + 20;
 
-    XSetForeground(display, gc, filterMode ? textColor : borderColor);
-    XDrawRectangle(display, window, gc, dims.x + 20, inputY, dims.width - 40, 20);
+    batch.outline(filterMode ? gcs.text : gcs.border, dims.x + 20, inputY, dims.width - 40, 20);
+    batch.text(gcs.text, dims.x + 25, inputY + 14, "/", filterText);
 
-    std::string filterDisplay = "/" + filterText;
-    XSetForeground(display, gc, textColor);
-    XDrawString(display, window, gc, dims.x + 25, inputY + 14, filterDisplay.c_str(), filterDisplay.length());
+    // The topics are drawn straight onto the back buffer, so the frame has
+    // to be on the server before them.
+    batch.flush();
 
     int y = dims.y + 20 + 25 + gap;
     const int contentTop = y;
@@ -327,101 +467,141 @@ void drawHelpDialog(
     drawAllHelpTopics(nullptr, titleLeft, topicLeft, lineHeight, gap, y, contentTop, contentBottom);
 }
 
-void drawConsole(
-    Display* display, Window window, GC gc,
-    const ConsoleDrawData& data)
+namespace
 {
-    int y = data.startY;
-
-    if (data.filterMode) {
-        std::string filterDisplay = "/" + data.filterText;
-        XDrawString(display, window, gc, 10, y, filterDisplay.c_str(), filterDisplay.length());
-        y += data.lineHeight;
-    } else if (data.commandMode) {
-        std::string commandDisplay = ":" + data.commandText;
-        XDrawString(display, window, gc, 10, y, commandDisplay.c_str(), commandDisplay.length());
-        y += data.lineHeight;
-    }
+    // Paints console primitives into the MIT-SHM image instead of queueing
+    // X requests; GCs are mapped back to the pixel values they were set to.
+    class ShmPainter
+    {
+    public:
+        ShmPainter(ShmRenderer& renderer, const ThemeGCs& gcs, const ConsoleDrawData& data)
+            : m_renderer(renderer), m_gcs(gcs), m_data(data)
+        {
+        }
 
-    if (data.themeSelectMode) {
-        std::string header = "Select theme (" + std::to_string(data.themeItems.size()) + " total):";
-        XDrawString(display, window, gc, 10, y, header.c_str(), header.length());
-        y += data.lineHeight;
+        void fill(GC gc, int x, int y, int width, int height)
+        {
+            m_renderer.fillRect(x, y, width, height, pixelFor(gc));
+        }
 
-        const int VISIBLE_THEMES = 10;
-        size_t startIdx = data.themeScrollOffset;
-        size_t endIdx = std::min(startIdx + VISIBLE_THEMES, data.themeItems.size());
+        void text(GC gc, int x, int y, std::string_view body)
+        {
+            m_renderer.drawText(x, y, body.data(), body.length(), pixelFor(gc));
+        }
 
-        for (size_t i = startIdx; i < endIdx; ++i) {
-            std::string themeDisplay = (i == data.selectedTheme ? "> " : "  ") + data.themeItems[i];
-            XDrawString(display, window, gc, 10, y, themeDisplay.c_str(), themeDisplay.length());
-            y += data.lineHeight;
+        void text(GC gc, int x, int y, std::string_view prefix, std::string_view body)
+        {
+            unsigned long pixel = pixelFor(gc);
+            x = m_renderer.drawText(x, y, prefix.data(), prefix.length(), pixel);
+            m_renderer.drawText(x, y, body.data(), body.length(), pixel);
         }
 
-        if (data.themeItems.size() > VISIBLE_THEMES) {
-            std::string scrollInfo = "Showing " + std::to_string(startIdx + 1) + "-" + std::to_string(endIdx) + " of " + std::to_string(data.themeItems.size());
-            XDrawString(display, window, gc, 10, y, scrollInfo.c_str(), scrollInfo.length());
+        void flush() {}
+
+    private:
+        unsigned long pixelFor(GC gc) const
+        {
+            if (gc == m_gcs.selection) return m_data.selColor;
+            if (gc == m_gcs.background) return m_data.bgColor;
+            return m_data.textColor;
         }
-        return;
-    }
 
-    if (data.configSelectMode) {
-        std::string header = "Select config option (" + std::to_string(data.configItems.size()) + " total):";
-        XDrawString(display, window, gc, 10, y, header.c_str(), header.length());
-        y += data.lineHeight;
+        ShmRenderer& m_renderer;
+        const ThemeGCs& m_gcs;
+        const ConsoleDrawData& m_data;
+    };
+
+    // Shared by the core X path (DrawBatch) and the MIT-SHM path (ShmPainter)
+    template <typename Painter>
+    void layoutConsole(Painter& painter, const ThemeGCs& gcs, const ConsoleDrawData& data)
+    {
+        int y = data.startY;
+
+        if (data.filterMode) {
+            painter.text(gcs.text, 10, y, "/", data.filterText);
+            y += data.lineHeight;
+        } else if (data.commandMode) {
+            painter.text(gcs.text, 10, y, ":", data.commandText);
+            y += data.lineHeight;
+        }
 
-        const int VISIBLE_CONFIGS = 10;
-        size_t startIdx = data.configScrollOffset;
-        size_t endIdx = std::min(startIdx + VISIBLE_CONFIGS, data.configItems.size());
+        // Counters are formatted on the stack so a frame allocates nothing
+        char buffer[96];
 
-        for (size_t i = startIdx; i < endIdx; ++i) {
-            std::string configDisplay = (i == data.selectedConfig ? "> " : "  ") + data.configItems[i];
-            XDrawString(display, window, gc, 10, y, configDisplay.c_str(), configDisplay.length());
+        if (data.themeSelectMode || data.configSelectMode) {
+            bool themes = data.themeSelectMode;
+            const ItemView<std::string>& rows = themes ? data.themeItems : data.configItems;
+            size_t total = themes ? data.themeCount : data.configCount;
+            size_t first = themes ? data.themeScrollOffset : data.configScrollOffset;
+            size_t selected = themes ? data.selectedTheme : data.selectedConfig;
+
+            int length = std::snprintf(buffer, sizeof(buffer), themes ? "Select theme (%zu total):" : "Select config option (%zu total):", total);
+            painter.text(gcs.text, 10, y, std::string_view(buffer, length));
             y += data.lineHeight;
+
+            for (size_t i = 0; i < rows.size(); ++i) {
+                painter.text(gcs.text, 10, y, first + i == selected ? "> " : "  ", rows[i]);
+                y += data.lineHeight;
+            }
+
+            if (total > CONSOLE_SELECT_ROWS) {
+                length = std::snprintf(buffer, sizeof(buffer), "Showing %zu-%zu of %zu", first + 1, first + rows.size(), total);
+                painter.text(gcs.text, 10, y, std::string_view(buffer, length));
+            }
+            painter.flush();
+            return;
         }
 
-        if (data.configItems.size() > VISIBLE_CONFIGS) {
-            std::string scrollInfo = "Showing " + std::to_string(startIdx + 1) + "-" + std::to_string(endIdx) + " of " + std::to_string(data.configItems.size());
-            XDrawString(display, window, gc, 10, y, scrollInfo.c_str(), scrollInfo.length());
+        const int SCROLL_INDICATOR_HEIGHT = 15;
+
+        bool needScrollIndicator = data.totalClipCount > data.clipLines.size();
+        if (needScrollIndicator) {
+            int length = std::snprintf(buffer, sizeof(buffer), "[%zu/%zu]", data.selectedItem + 1, data.totalClipCount);
+            painter.text(gcs.text, data.windowWidth - 80, 15, std::string_view(buffer, length));
+            y += SCROLL_INDICATOR_HEIGHT;
         }
-        return;
-    }
 
-    const int SCROLL_INDICATOR_HEIGHT = 15;
+        for (size_t i = 0; i < data.clipLines.size(); ++i) {
+            bool isSelected = (i + data.clipScrollOffset == data.selectedItem);
 
-    bool needScrollIndicator = data.totalClipCount > data.clipLines.size();
-    if (needScrollIndicator) {
-        std::string scrollText = "[" + std::to_string(data.selectedItem + 1) + "/" + std::to_string(data.totalClipCount) + "]";
-        XDrawString(display, window, gc, data.windowWidth - 80, 15, scrollText.c_str(), scrollText.length());
-        y += SCROLL_INDICATOR_HEIGHT;
-    }
+            if (isSelected) {
+                painter.fill(gcs.selection, 5, y - 12, data.clipListWidth, 15);
+            }
 
-    for (size_t i = 0; i < data.clipLines.size(); ++i) {
-        bool isSelected = (i + data.clipScrollOffset == data.selectedItem);
+            painter.text(gcs.text, 10, y, data.clipLines[i]);
+            y += data.lineHeight;
+        }
 
-        if (isSelected) {
-            XSetForeground(display, gc, data.selColor);
-            XFillRectangle(display, window, gc, 5, y - 12, data.clipListWidth, 15);
-            XSetForeground(display, gc, data.textColor);
-        } else {
-            XSetForeground(display, gc, data.textColor);
+        if (data.clipLines.empty()) {
+            if (data.filterMode) {
+                painter.text(gcs.text, 10, y, "No matching items...");
+            } else if (data.commandMode) {
+                painter.text(gcs.text, 10, y, "Enter command...");
+            } else {
+                painter.text(gcs.text, 10, y, "No clipboard items yet...");
+            }
         }
 
-        XDrawString(display, window, gc, 10, y, data.clipLines[i].c_str(), data.clipLines[i].length());
-        y += data.lineHeight;
+        painter.flush();
     }
+}
 
-    if (data.clipLines.empty()) {
-        std::string empty;
-        if (data.filterMode) {
-            empty = "No matching items...";
-        } else if (data.commandMode) {
-            empty = "Enter command...";
-        } else {
-            empty = "No clipboard items yet...";
-        }
-        XDrawString(display, window, gc, 10, y, empty.c_str(), empty.length());
-    }
+void drawConsole(
+    Display* display, Drawable drawable, const ThemeGCs& gcs,
+    const ConsoleDrawData& data)
+{
+    batch.begin(display, drawable);
+    layoutConsole(batch, gcs, data);
+}
+
+void drawConsole(
+    Drawable drawable, const ThemeGCs& gcs, ShmRenderer& renderer,
+    const ConsoleDrawData& data)
+{
+    ShmPainter painter(renderer, gcs, data);
+    renderer.clear(data.bgColor);
+    layoutConsole(painter, gcs, data);
+    renderer.present(drawable, gcs.background);
 }
 
 #endif
@@ -510,26 +510,25 @@ void drawConsole(
     SetBkMode(hdc, TRANSPARENT);
 
     if (data.filterMode) {
-        std::string filterDisplay = "/" + data.filterText;
+        std::string filterDisplay = "/" + std::string(data.filterText);
         TextOut(hdc, 10, y, filterDisplay.c_str(), filterDisplay.length());
         y += data.lineHeight;
     } else if (data.commandMode) {
-        std::string commandDisplay = ":" + data.commandText;
+        std::string commandDisplay = ":" + std::string(data.commandText);
         TextOut(hdc, 10, y, commandDisplay.c_str(), commandDisplay.length());
         y += data.lineHeight;
     }
 
     if (data.themeSelectMode) {
-        std::string header = "Select theme (" + std::to_string(data.themeItems.size()) + " total):";
+        std::string header = "Select theme (" + std::to_string(data.themeCount) + " total):";
         TextOut(hdc, 10, y, header.c_str(), header.length());
         y += data.lineHeight;
 
-        const int VISIBLE_THEMES = 10;
         size_t startIdx = data.themeScrollOffset;
-        size_t endIdx = std::min(startIdx + VISIBLE_THEMES, data.themeItems.size());
+        size_t endIdx = startIdx + data.themeItems.size();
 
         for (size_t i = startIdx; i < endIdx; ++i) {
-            std::string themeDisplay = (i == data.selectedTheme ? "> " : "  ") + data.themeItems[i];
+            std::string themeDisplay = (i == data.selectedTheme ? "> " : "  ") + data.themeItems[i - startIdx];
 
             if (i == data.selectedTheme) {
                 RECT highlightRect = {5, y - winSelRectOffsetY, data.clipListWidth, y - winSelRectOffsetY + winSelRectHeight};
@@ -543,24 +542,23 @@ void drawConsole(
             y += data.lineHeight;
         }
 
-        if (data.themeItems.size() > VISIBLE_THEMES) {
-            std::string scrollInfo = "Showing " + std::to_string(startIdx + 1) + "-" + std::to_string(endIdx) + " of " + std::to_string(data.themeItems.size());
+        if (data.themeCount > CONSOLE_SELECT_ROWS) {
+            std::string scrollInfo = "Showing " + std::to_string(startIdx + 1) + "-" + std::to_string(endIdx) + " of " + std::to_string(data.themeCount);
             TextOut(hdc, 10, y, scrollInfo.c_str(), scrollInfo.length());
         }
         return;
     }
 
     if (data.configSelectMode) {
-        std::string header = "Select config option (" + std::to_string(data.configItems.size()) + " total):";
+        std::string header = "Select config option (" + std::to_string(data.configCount) + " total):";
         TextOut(hdc, 10, y, header.c_str(), header.length());
         y += data.lineHeight;
 
-        const int VISIBLE_CONFIGS = 10;
         size_t startIdx = data.configScrollOffset;
-        size_t endIdx = std::min(startIdx + VISIBLE_CONFIGS, data.configItems.size());
+        size_t endIdx = startIdx + data.configItems.size();
 
         for (size_t i = startIdx; i < endIdx; ++i) {
-            std::string configDisplay = (i == data.selectedConfig ? "> " : "  ") + data.configItems[i];
+            std::string configDisplay = (i == data.selectedConfig ? "> " : "  ") + data.configItems[i - startIdx];
 
             if (i == data.selectedConfig) {
                 RECT highlightRect = {5, y - winSelRectOffsetY, data.clipListWidth, y - winSelRectOffsetY + winSelRectHeight};
@@ -574,8 +572,8 @@ void drawConsole(
             y += data.lineHeight;
         }
 
-        if (data.configItems.size() > VISIBLE_CONFIGS) {
-            std::string scrollInfo = "Showing " + std::to_string(startIdx + 1) + "-" + std::to_string(endIdx) + " of " + std::to_string(data.configItems.size());
+        if (data.configCount > CONSOLE_SELECT_ROWS) {
+            std::string scrollInfo = "Showing " + std::to_string(startIdx + 1) + "-" + std::to_string(endIdx) + " of " + std::to_string(data.configCount);
             TextOut(hdc, 10, y, scrollInfo.c_str(), scrollInfo.length());
         }
         return;
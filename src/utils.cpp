@@ -450,7 +450,13 @@ bool isPath(const std::string& text)
 
 std::string smartTrim(const std::string& text, size_t maxLength)
 {
-    if (isPath(text))
+    return smartTrim(text, maxLength, isPath(text));
+}
+
+// For callers that already classified the text, e.g. history items
+std::string smartTrim(const std::string& text, size_t maxLength, bool isPathText)
+{
+    if (isPathText)
     {
         return trimMiddle(text, maxLength);
     }
@@ -462,6 +468,43 @@ std::string trimMiddle(const std::string& text, size_t maxLength)
     return StringTrimmer::trimMiddle(text, maxLength);
 }
 
+// Pixel-exact variant of smartTrim: the result is the longest trim that
+// still fits in maxWidth when drawn with the measured font
+std::string smartTrimToWidth(const std::string& text, int maxWidth, const FontMetrics& metrics)
+{
+    return smartTrimToWidth(text, maxWidth, metrics, isPath(text));
+}
+
+std::string smartTrimToWidth(const std::string& text, int maxWidth, const FontMetrics& metrics, bool isPathText)
+{
+    if (metrics.textWidth(text) <= maxWidth)
+    {
+        return text;
+    }
+
+    // The longest prefix that fits bounds the trimmed length from above
+    size_t length = 0;
+    int width = 0;
+    while (length < text.length())
+    {
+        width += metrics.advance[static_cast<unsigned char>(text[length])];
+        if (width > maxWidth) break;
+        ++length;
+    }
+
+    // The ellipsis and a middle cut swap glyphs, so shrink until it fits
+    const size_t minLength = 4;
+    for (; length > minLength; --length)
+    {
+        std::string trimmed = smartTrim(text, length, isPathText);
+        if (metrics.textWidth(trimmed) <= maxWidth)
+        {
+            return trimmed;
+        }
+    }
+    return smartTrim(text, minLength, isPathText);
+}
+
 std::string wildcardToRegex(const std::string& pattern)
 {
     std::string regex_pattern;
@@ -485,6 +528,15 @@ std::string wildcardToRegex(const std::string& pattern)
     return regex_pattern;
 }
 
+// Case-insensitive substring test that, unlike comparing stringToLower()
+// copies, does not allocate
+bool containsIgnoreCase(std::string_view text, std::string_view needle)
+{
+    auto it = std::search(text.begin(), text.end(), needle.begin(), needle.end(),
+                          [](unsigned char a, unsigned char b) { return std::tolower(a) == std::tolower(b); });
+    return it != text.end() || needle.empty();
+}
+
 int countLines(const std::string& content)
 {
     if (content.empty()) return 0;
@@ -496,6 +548,118 @@ int countLines(const std::string& content)
     return lines;
 }
 
+uint64_t fnv1a64(const char* data, size_t length, uint64_t hash)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t normalizedFingerprint(const std::string& text)
+{
+    uint64_t hash = FNV1A64_OFFSET;
+    auto feed = [&hash](char c)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    };
+
+    bool started = false;
+    bool lineStart = true;
+    bool pendingSpace = false;
+    size_t pendingBreaks = 0;
+    for (char c : text)
+    {
+        if (c == '\r')
+        {
+            continue;
+        }
+        if (c == '\n')
+        {
+            // Trailing blanks on the line are dropped with the pending space
+            pendingSpace = false;
+            pendingBreaks++;
+            lineStart = true;
+            continue;
+        }
+        if (c == ' ' || c == '\t')
+        {
+            pendingSpace = !lineStart;
+            continue;
+        }
+        // Line breaks only count between content, not at either end
+        for (; started && pendingBreaks > 0; --pendingBreaks)
+        {
+            feed('\n');
+        }
+        pendingBreaks = 0;
+        if (pendingSpace)
+        {
+            feed(' ');
+            pendingSpace = false;
+        }
+        feed(c);
+        started = true;
+        lineStart = false;
+    }
+    return hash;
+}
+
+bool parseRetentionRules(const std::string& text, std::vector<RetentionRule>& rules)
+{
+    rules.clear();
+    if (text == "forever")
+    {
+        return true;
+    }
+
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ','))
+    {
+        item.erase(std::remove_if(item.begin(), item.end(), [](unsigned char c) { return std::isspace(c); }), item.end());
+        size_t unit = item.find_first_not_of("0123456789");
+        if (unit == 0 || unit == std::string::npos)
+        {
+            return false;
+        }
+
+        RetentionRule rule;
+        long long days = 0;
+        try
+        {
+            days = std::stoll(item.substr(0, unit));
+        }
+        catch (...)
+        {
+            return false;
+        }
+        switch (item[unit])
+        {
+            case 'd': break;
+            case 'w': days *= 7; break;
+            case 'y': days *= 365; break;
+            default: return false;
+        }
+        rule.maxAge = days * 24 * 60 * 60;
+
+        if (unit + 1 < item.size())
+        {
+            if (item[unit + 1] != '>' || unit + 2 == item.size() ||
+                item.find_first_not_of("0123456789", unit + 2) != std::string::npos)
+            {
+                return false;
+            }
+            rule.minLength = std::stoull(item.substr(unit + 2));
+        }
+        rules.push_back(rule);
+    }
+    return !rules.empty();
+}
+
 int calculateDialogContentLength(const DialogDimensions& dims)
 {
     int availableWidth = dims.contentWidth;
@@ -551,13 +715,26 @@ std::string encrypt(const std::string& data, const ConfigManager& config)
     {
         return data;
     }
+    return encryptWithKey(data, config.encryptionKey);
+}
 
+std::string decrypt(const std::string& data, const ConfigManager& config)
+{
+    if (!config.encrypted || config.encryptionKey.empty())
+    {
+        return data;
+    }
+    return decryptWithKey(data, config.encryptionKey);
+}
+
+std::string encryptWithKey(const std::string& data, const std::string& key)
+{
     std::string encrypted;
     encrypted.resize(data.length());
 
     for (size_t i = 0; i < data.length(); ++i)
     {
-        encrypted[i] = data[i] ^ config.encryptionKey[i % config.encryptionKey.length()];
+        encrypted[i] = data[i] ^ key[i % key.length()];
     }
 
     const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -588,13 +765,8 @@ std::string encrypt(const std::string& data, const ConfigManager& config)
     return result;
 }
 
-std::string decrypt(const std::string& data, const ConfigManager& config)
+std::string decryptWithKey(const std::string& data, const std::string& key)
 {
-    if (!config.encrypted || config.encryptionKey.empty())
-    {
-        return data;
-    }
-
     const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     std::string decoded;
     int val = 0, valb = -8;
@@ -621,45 +793,8 @@ std::string decrypt(const std::string& data, const ConfigManager& config)
 
     for (size_t i = 0; i < decoded.length(); ++i)
     {
-        decrypted[i] = decoded[i] ^ config.encryptionKey[i % config.encryptionKey.length()];
+        decrypted[i] = decoded[i] ^ key[i % key.length()];
     }
 
     return decrypted;
 }
-
-std::vector<std::string> getSortedPinnedItems(const std::string& pinnedFile)
-{
-    std::vector<std::pair<long long, std::string>> pinnedItems;
-    std::string line;
-    std::ifstream inFile(pinnedFile);
-
-    while (std::getline(inFile, line))
-    {
-        size_t pos = line.find('|');
-        if (pos != std::string::npos && pos > 0)
-        {
-            try
-            {
-                long long timestamp = std::stoll(line.substr(0, pos));
-                pinnedItems.push_back({timestamp, line});
-            }
-            catch (...)
-            {
-                long long timestamp = std::chrono::system_clock::now().time_since_epoch().count();
-                pinnedItems.push_back({timestamp, line});
-            }
-        }
-    }
-    inFile.close();
-
-    std::sort(pinnedItems.begin(), pinnedItems.end(),
-              [](const auto& a, const auto& b) { return a.first > b.first; });
-
-    std::vector<std::string> sortedLines;
-    for (const auto& item : pinnedItems)
-    {
-        sortedLines.push_back(item.second);
-    }
-
-    return sortedLines;
-}
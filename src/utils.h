@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "ui.h"
@@ -12,19 +13,45 @@ bool isFilePath(const std::string& text);
 bool isPath(const std::string& text);
 
 std::string smartTrim(const std::string& text, size_t maxLength);
+std::string smartTrim(const std::string& text, size_t maxLength, bool isPathText);
 std::string trimMiddle(const std::string& text, size_t maxLength);
+std::string smartTrimToWidth(const std::string& text, int maxWidth, const FontMetrics& metrics);
+std::string smartTrimToWidth(const std::string& text, int maxWidth, const FontMetrics& metrics, bool isPathText);
 
 std::string wildcardToRegex(const std::string& pattern);
+bool containsIgnoreCase(std::string_view text, std::string_view needle);
 
 int countLines(const std::string& content);
 
+// 64-bit FNV-1a; pass the previous result back in to hash data in pieces
+const uint64_t FNV1A64_OFFSET = 14695981039346656037ULL;
+uint64_t fnv1a64(const char* data, size_t length, uint64_t hash = FNV1A64_OFFSET);
+// FNV-1a of the text with CRLF as LF, indentation and trailing blanks
+// dropped and inner runs of blanks as one space, so copies that differ
+// only in whitespace share it
+uint64_t normalizedFingerprint(const std::string& text);
+
+// One archive_retention rule: clips longer than minLength are kept for
+// maxAge seconds
+struct RetentionRule
+{
+    long long maxAge { 0 };
+    size_t minLength { 0 };
+};
+// Comma-separated "<count><d|w|y>[>length]", e.g. "7d,1y>20"; "forever"
+// is no rule at all. False if the list does not parse.
+bool parseRetentionRules(const std::string& text, std::vector<RetentionRule>& rules);
+
 int calculateDialogContentLength(const DialogDimensions& dims);
 int calculateMaxContentLength(int clipListWidth, bool verboseMode);
 DialogDimensions calculateDialogDimensions(int windowWidth, int windowHeight, int preferredWidth, int preferredHeight);
 
+// Leave the data as it is unless encryption is on and has a key
 std::string encrypt(const std::string& data, const ConfigManager& config);
 std::string decrypt(const std::string& data, const ConfigManager& config);
-
-std::vector<std::string> getSortedPinnedItems(const std::string& pinnedFile);
+// With the given key whatever the configuration, for data stored flagged
+// as encrypted; the key must not be empty
+std::string encryptWithKey(const std::string& data, const std::string& key);
+std::string decryptWithKey(const std::string& data, const std::string& key);
 
 #endif
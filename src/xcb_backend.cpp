@@ -0,0 +1,65 @@
+#include "xcb_backend.h"
+
+#if defined(__linux__) && defined(MMRY_XCB)
+
+#include <cstdlib>
+#include <xcb/xcb.h>
+
+XcbConnection::~XcbConnection()
+{
+    disconnect();
+}
+
+bool XcbConnection::connect(const char* displayName)
+{
+    disconnect();
+    m_connection = xcb_connect(displayName, nullptr);
+    // xcb_connect never returns null; a failed connection reports an error instead
+    if (xcb_connection_has_error(m_connection))
+    {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void XcbConnection::disconnect()
+{
+    if (m_connection)
+    {
+        xcb_disconnect(m_connection);
+        m_connection = nullptr;
+    }
+}
+
+bool XcbConnection::isConnected() const
+{
+    return m_connection && !xcb_connection_has_error(m_connection);
+}
+
+int XcbConnection::fd() const
+{
+    return m_connection ? xcb_get_file_descriptor(m_connection) : -1;
+}
+
+void XcbConnection::flush()
+{
+    if (m_connection)
+    {
+        xcb_flush(m_connection);
+    }
+}
+
+void XcbConnection::drain()
+{
+    if (!m_connection)
+    {
+        return;
+    }
+    while (xcb_generic_event_t* event = xcb_poll_for_event(m_connection))
+    {
+        std::free(event);
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef XCB_BACKEND_H
+#define XCB_BACKEND_H
+
+#if defined(__linux__) && defined(MMRY_XCB)
+
+struct xcb_connection_t;
+
+// A second connection to the same display for the capture path. Xlib waits
+// for every GetProperty reply before the next request can go out; XCB hands
+// back a cookie instead, so all the pieces of a large property are asked
+// for at once and their replies are picked up from the event loop as the
+// fd turns readable. Windows and atoms are server-wide, so ids from the
+// Xlib connection are used here as they are.
+class XcbConnection
+{
+public:
+    XcbConnection() = default;
+    ~XcbConnection();
+    XcbConnection(const XcbConnection&) = delete;
+    XcbConnection& operator=(const XcbConnection&) = delete;
+
+    // nullptr connects to $DISPLAY, like XOpenDisplay
+    bool connect(const char* displayName);
+    void disconnect();
+
+    // False once the server dropped the connection as well
+    bool isConnected() const;
+    xcb_connection_t* handle() const { return m_connection; }
+    int fd() const;
+
+    void flush();
+    // Reads whatever arrived. Replies still owed to a cookie stay queued
+    // for it; discarded replies and stray events are dropped, so a
+    // readable fd does not stay readable
+    void drain();
+
+private:
+    xcb_connection_t* m_connection { nullptr };
+};
+
+#endif
+
+#endif
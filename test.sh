@@ -0,0 +1,13 @@
+#!/bin/bash
+
+# Test Script
+# Builds the app along with the tests and runs them. Heap allocations are
+# counted, so the tests can check what drawing a frame allocates.
+
+set -e  # Exit on any error
+source ./config.sh
+
+MMRY_BUILD_TESTS=ON MMRY_COUNT_ALLOCATIONS=ON ./build.sh "$@"
+
+cd build
+ctest --output-on-failure
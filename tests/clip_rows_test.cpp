@@ -0,0 +1,131 @@
+#include "../src/allocation_counter.h"
+#include "../src/clip_rows.h"
+#include "../src/utils.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Redrawing the clip list makes no heap allocation once its rows have been
+// formatted, however long the clips are. The allocation checks need a build
+// with MMRY_COUNT_ALLOCATIONS, which test.sh turns on; without it only the
+// row text is checked.
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string& what)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << what << "\n";
+            failures++;
+        }
+    }
+
+    struct Clip
+    {
+        std::string content;
+        uint64_t hash;
+        bool isPath;
+    };
+
+    std::vector<Clip> sampleClips()
+    {
+        std::vector<std::string> texts = { "short", "line one\nline two", "/home/user/projects/mmry/src/clip_rows.cpp" };
+        std::string wide;
+        for (int i = 0; i < 10000; ++i)
+        {
+            wide += "a long line of text\n";
+        }
+        texts.push_back(wide);
+
+        std::vector<Clip> clips;
+        for (const std::string& text : texts)
+        {
+            clips.push_back({ text, fnv1a64(text.data(), text.size()), isPath(text) });
+        }
+        return clips;
+    }
+
+    FontMetrics fixedMetrics()
+    {
+        FontMetrics metrics;
+        for (int& advance : metrics.advance)
+        {
+            advance = 7;
+        }
+        return metrics;
+    }
+
+    void drawFrame(ClipRows& rows, const std::vector<Clip>& clips, size_t selected, int width, const FontMetrics& metrics)
+    {
+        rows.reserve(clips.size());
+        for (size_t row = 0; row < clips.size(); ++row)
+        {
+            const Clip& clip = clips[row];
+            rows.format(row, clip.content, clip.hash, clip.isPath, row == selected, nullptr, width, metrics);
+        }
+    }
+
+    void testRowText()
+    {
+        ClipRows rows;
+        std::vector<Clip> clips = sampleClips();
+        FontMetrics metrics = fixedMetrics();
+        const int width = 7 * 40;
+        drawFrame(rows, clips, 0, width, metrics);
+
+        ItemView<std::string> lines = rows.rows(clips.size());
+        check(lines[0] == "> short", "selected short clip");
+        check(lines[1] == "  line one line two (2 lines)", "multi-line clip is flattened");
+        for (const std::string& line : lines)
+        {
+            check(metrics.textWidth(line) <= width, "row fits: " + line);
+        }
+        check(lines[3].find("(10001 lines)") != std::string::npos, "wide clip keeps its line count");
+
+        // A narrower window trims the rows again
+        drawFrame(rows, clips, 0, 7 * 20, metrics);
+        for (const std::string& line : rows.rows(clips.size()))
+        {
+            check(metrics.textWidth(line) <= 7 * 20, "row fits after a resize: " + line);
+        }
+    }
+
+    void testSteadyStateAllocations()
+    {
+        ClipRows rows;
+        std::vector<Clip> clips = sampleClips();
+        FontMetrics metrics = fixedMetrics();
+
+        drawFrame(rows, clips, 0, 7 * 40, metrics);
+        unsigned long long first = threadAllocations();
+        for (size_t frame = 0; frame < 100; ++frame)
+        {
+            // Moving the selection reformats every row without trimming again
+            drawFrame(rows, clips, frame % clips.size(), 7 * 40, metrics);
+        }
+        // Read before check() builds its message, which allocates
+        unsigned long long allocations = threadAllocations() - first;
+        check(allocations == 0, "redrawn frames allocate nothing, made " + std::to_string(allocations));
+    }
+}
+
+int main()
+{
+    testRowText();
+    testSteadyStateAllocations();
+
+    if (failures)
+    {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+#ifndef MMRY_COUNT_ALLOCATIONS
+    std::cout << "clip_rows_test: allocations not counted in this build\n";
+#endif
+    std::cout << "clip_rows_test: all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "../src/config.h"
+#include "../src/content_store.h"
+#include "../src/history_archive.h"
+#include "../src/record_store.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Stored texts and archive segments stay readable when encryption is
+// turned on or off, and when the key changes, between runs.
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string& what)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << what << "\n";
+            failures++;
+        }
+    }
+
+    std::vector<std::string> sampleTexts()
+    {
+        std::vector<std::string> texts = { "short", "https://example.com/a/path", "line one\nline two" };
+        // Long enough to be stored compressed
+        std::string repeated;
+        for (int i = 0; i < 200; ++i)
+        {
+            repeated += "the same words again ";
+        }
+        texts.push_back(repeated);
+        return texts;
+    }
+
+    ConfigManager configWith(bool encrypted, const std::string& key)
+    {
+        ConfigManager config;
+        config.encrypted = encrypted;
+        config.encryptionKey = key;
+        return config;
+    }
+
+    // Stores the texts in a new database under the given settings
+    std::vector<std::string> store(const std::string& path, const ConfigManager& config)
+    {
+        RecordStore records;
+        ContentStore contents;
+        check(records.open(path), "open " + path);
+        contents.open(records, config);
+        std::vector<std::string> keys;
+        RecordStore::Records history;
+        for (const std::string& text : sampleTexts())
+        {
+            keys.push_back(contents.intern(text));
+            history.push_back("1|" + ContentStore::REFERENCE_TAG + keys.back());
+        }
+        check(contents.put("history", history), "commit the history");
+        return keys;
+    }
+
+    void expectTexts(const std::string& path, const ConfigManager& config, const std::vector<std::string>& keys,
+                     const std::string& what)
+    {
+        RecordStore records;
+        ContentStore contents;
+        check(records.open(path), what + ": reopen");
+        contents.open(records, config);
+        std::vector<std::string> texts = sampleTexts();
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            std::string content;
+            check(contents.lookup(keys[i], content) && content == texts[i], what + ": text " + std::to_string(i));
+        }
+    }
+
+    void testToggle(const std::string& directory, bool savedEncrypted)
+    {
+        std::string path = directory + (savedEncrypted ? "/on_off.db" : "/off_on.db");
+        std::string what = savedEncrypted ? "saved encrypted, read plain" : "saved plain, read encrypted";
+        std::vector<std::string> keys = store(path, configWith(savedEncrypted, "secret"));
+        expectTexts(path, configWith(!savedEncrypted, "secret"), keys, what);
+    }
+
+    void testNewKey(const std::string& directory)
+    {
+        std::string path = directory + "/new_key.db";
+        std::vector<std::string> keys = store(path, configWith(true, "old key"));
+        {
+            RecordStore records;
+            ContentStore contents;
+            check(records.open(path), "new key: reopen");
+            contents.open(records, configWith(true, "old key"));
+            check(contents.setEncryption(true, "new key"), "new key: re-encrypt");
+        }
+        expectTexts(path, configWith(true, "new key"), keys, "new key");
+    }
+
+    void testArchive(const std::string& directory, bool savedEncrypted)
+    {
+        std::string base = directory + (savedEncrypted ? "/archive_on_off" : "/archive_off_on");
+        ConfigManager saved = configWith(savedEncrypted, "secret");
+        {
+            RecordStore records;
+            ContentStore contents;
+            HistoryArchive archive;
+            check(records.open(base + ".db"), "archive: open");
+            contents.open(records, saved);
+            archive.open(base, records, contents, saved);
+            for (const std::string& text : sampleTexts())
+            {
+                archive.add(86400, text);
+            }
+            // Seals the tail into a segment file
+            archive.sealPastPeriods(10 * 86400);
+            check(archive.segmentCount() == 1, "archive: sealed");
+        }
+
+        ConfigManager read = configWith(!savedEncrypted, "secret");
+        RecordStore records;
+        ContentStore contents;
+        HistoryArchive archive;
+        check(records.open(base + ".db"), "archive: reopen");
+        contents.open(records, read);
+        archive.open(base, records, contents, read);
+        std::vector<std::string> texts = sampleTexts();
+        check(archive.size() == texts.size(), "archive: size");
+        for (size_t i = 0; i < texts.size(); ++i)
+        {
+            HistoryArchive::Clip clip;
+            check(archive.at(i, clip) && clip.content == texts[texts.size() - 1 - i],
+                  std::string("archive ") + (savedEncrypted ? "on/off" : "off/on") + ": clip " + std::to_string(i));
+        }
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/mmry_content_store_test_XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        std::cerr << "Cannot create a temporary directory\n";
+        return 1;
+    }
+
+    testToggle(directory, false);
+    testToggle(directory, true);
+    testNewKey(directory);
+    testArchive(directory, false);
+    testArchive(directory, true);
+
+    std::system((std::string("rm -rf ") + directory).c_str());
+    if (failures)
+    {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "content_store_test: all checks passed\n";
+    return 0;
+}